@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+// SRAM accounting for the Mega's 8 KB.
+// Before main() runs, everything between the end of .bss and the stack
+// pointer is painted with a sentinel byte. The stack grows down over the
+// paint and the heap (if anything ever calls malloc) grows up into it, so
+// the untouched sentinels left between them are the headroom that has
+// never been used since boot.
+//   static  .data + .bss, fixed at link time (PlatformIO prints it too)
+//   free    gap between the heap top and the stack pointer right now
+//   unused  sentinels never overwritten: the stack high-water mark
+
+extern char __data_start;
+extern char __bss_end;
+extern char __heap_start;
+extern char *__brkval;
+
+static const uint8_t RAM_PAINT = 0xC5;
+
+// Runs from .init3, before constructors and main(); SP is still at RAMEND
+__attribute__((naked, used, section(".init3"))) static void paintStack() {
+  uint8_t *p = (uint8_t *)&__heap_start;
+  while (p <= (uint8_t *)SP) *p++ = RAM_PAINT;
+}
+
+struct RamUsage {
+  uint16_t staticBytes;
+  uint16_t heapBytes;
+  uint16_t freeBytes;
+  uint16_t unusedBytes;   // never touched by heap or stack since boot
+};
+
+inline RamUsage ramUsage() {
+  RamUsage u;
+  uint8_t *heapTop = __brkval ? (uint8_t *)__brkval : (uint8_t *)&__heap_start;
+  uint8_t *sp = (uint8_t *)SP;
+  u.staticBytes = &__bss_end - &__data_start;
+  u.heapBytes = heapTop - (uint8_t *)&__heap_start;
+  u.freeBytes = sp > heapTop ? sp - heapTop : 0;
+
+  uint8_t *p = heapTop;
+  while (p < sp && *p == RAM_PAINT) p++;
+  u.unusedBytes = p - heapTop;
+  return u;
+}
+
+inline void printRamUsage(Print &out) {
+  RamUsage u = ramUsage();
+  out.print(F("[RAM] static="));
+  out.print(u.staticBytes);
+  out.print(F(" heap="));
+  out.print(u.heapBytes);
+  out.print(F(" free="));
+  out.print(u.freeBytes);
+  out.print(F(" unused="));
+  out.print(u.unusedBytes);
+  out.print(F(" of "));
+  out.println(RAMEND - RAMSTART + 1);
+}
@@ -1,9 +1,14 @@
 #include <LiquidCrystal.h>
 #include <Keypad.h>
-#include <ArduinoJson.h>
+#include <MegaLink.h>
+#include <LcdShadow.h>
+#include "RamReport.h"
 
 // LCD pin setup: RS=2, E=3, D4=13, D5=12, D6=11, D7=10
 LiquidCrystal lcd(2, 3, 13, 12, 11, 10);
+// Everything draws into the shadow; loop() sends the changed cells
+LcdShadow screen(lcd);
+const uint16_t lcdRenderBudget = 8; // bus writes per loop() pass
 
 // Keypad setup
 const byte ROWS = 4;
@@ -25,137 +30,257 @@ const int keyPressDuration = 50; // ms for key press beep
 const int grantedBeepDuration = 300; // ms for access granted
 const int deniedBeepDuration = 1000; // ms for access denied
 
-String enteredPassword = "";
-String lastTemp = "";
-String lastHum = "";
-bool isEnteringPassword = false;
-bool waitingForAccessResponse = false;
+// UI timing
+const unsigned long resultShowTime = 2000;  // ms an access result stays up
+const unsigned long clearedShowTime = 1000; // ms "Cleared" stays up
+const unsigned long authTimeout = 8000;     // ESP32 gives up on the server after 4 s (AUTH_TIMEOUT); margin for the link
+const unsigned long pinIdleTimeout = 15000; // abandon a half-typed PIN
+
+// The UI is a state machine driven from loop(); nothing in it waits, so
+// the keypad is scanned and link frames are read on every pass.
+enum UiState {
+  UI_IDLE,           // temperature and humidity
+  UI_ENTERING_PIN,
+  UI_WAITING_AUTH,   // PIN sent, no answer yet
+  UI_SHOWING_RESULT  // result or "Cleared" message, back to idle when it expires
+};
+UiState uiState = UI_IDLE;
+unsigned long uiStateSince = 0;
+unsigned long uiStateTimeout = 0;  // 0 = stay until an event
+
+// Fixed buffers only: no String, nothing on the heap
+char enteredPassword[MegaLink::MAX_PAYLOAD + 1];
+uint8_t passwordLength = 0;
+int16_t lastTemp = 0;  // tenths of a degree / percent, as sent by the ESP32
+int16_t lastHum = 0;
+bool haveReading = false;
+
+// Service console: a line typed on the USB serial port runs through the
+// ESP32's command table (STATUS, METRICS, lights; the door and power
+// commands are refused from here) and the reply is printed back
+char consoleLine[MegaLink::MAX_PAYLOAD + 1];
+uint8_t consoleLength = 0;
+
+const unsigned long ramReportInterval = 60000;
+unsigned long lastRamReport = 0;
+
+// Framed link to the ESP32 on Serial1; the ESP32 negotiates the baud rate
+void setEspBaud(uint32_t baud) { Serial1.begin(baud); }
+MegaLink espLink(Serial1, setEspBaud);
 
   void handleSerialFromESP32();
+  void onEspMessage(uint8_t type, const uint8_t *payload, uint8_t len);
   void handleKeypadInput();
+  void handleConsoleInput();
+  void handleUiTimeouts();
+  void enterUiState(UiState state, unsigned long timeout);
+  void showResult(const char *message, unsigned long timeout);
   void displayTempAndHum();
+  void printTenths(int16_t value);
 
 void setup() {
   Serial.begin(9600);    // Debug
-  Serial1.begin(9600);
+  Serial1.begin(MegaLink::BASE_BAUD);
+  espLink.begin(onEspMessage);
   Serial2.begin(9600);   // For ESP32
   lcd.begin(16, 2);
-  lcd.print("Waiting for ESP");
+  screen.begin();
+  screen.print("Waiting for ESP");
   
   // Initialize buzzer pin
   pinMode(buzzerPin, OUTPUT);
   digitalWrite(buzzerPin, LOW);
+
+  printRamUsage(Serial);
 }
 
 void loop() {
   handleSerialFromESP32();
   handleKeypadInput();
+  handleConsoleInput();
+  handleUiTimeouts();
+  screen.render(lcdRenderBudget);
+
+  if (millis() - lastRamReport >= ramReportInterval) {
+    lastRamReport = millis();
+    printRamUsage(Serial);
+  }
+}
+
+void enterUiState(UiState state, unsigned long timeout) {
+  uiState = state;
+  uiStateSince = millis();
+  uiStateTimeout = timeout;
+}
+
+// Show a one-line message, then go back to idle after timeout
+void showResult(const char *message, unsigned long timeout) {
+  screen.clear();
+  screen.print(message);
+  passwordLength = 0;
+  enterUiState(UI_SHOWING_RESULT, timeout);
+}
+
+void handleUiTimeouts() {
+  if (!uiStateTimeout || millis() - uiStateSince < uiStateTimeout) return;
+
+  switch (uiState) {
+    case UI_WAITING_AUTH:
+      Serial.println("No access result from ESP32");
+      showResult("No Response", resultShowTime);
+      tone(buzzerPin, 800, deniedBeepDuration);
+      break;
+    case UI_ENTERING_PIN:
+      Serial.println("PIN entry timed out");
+      // fall through
+    default:
+      passwordLength = 0;
+      enterUiState(UI_IDLE, 0);
+      displayTempAndHum();
+      break;
+  }
 }
 
 // Display temperature and humidity
 void displayTempAndHum() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Temp: " + lastTemp + "C");
-  lcd.setCursor(0, 1);
-  lcd.print("Hum: " + lastHum + "%");
+  screen.clear();
+  screen.print("Temp: ");
+  printTenths(lastTemp);
+  screen.print("C");
+  screen.setCursor(0, 1);
+  screen.print("Hum: ");
+  printTenths(lastHum);
+  screen.print("%");
+}
+
+// 234 -> "23.4", or "--" before the first reading
+void printTenths(int16_t value) {
+  if (!haveReading) {
+    screen.print("--");
+    return;
+  }
+  if (value < 0) {
+    screen.print('-');
+    value = -value;
+  }
+  screen.print(value / 10);
+  screen.print('.');
+  screen.print(value % 10);
 }
 
 // Handle serial input from ESP32
 void handleSerialFromESP32() {
-  if (Serial1.available()) {
-    String input = Serial1.readStringUntil('\n');
-    input.trim();
-    Serial.println("Received from ESP32: " + input);  
-
-    // Handle access response
-    if (waitingForAccessResponse && input.startsWith("{")) {
-      StaticJsonDocument<200> doc;
-      DeserializationError error = deserializeJson(doc, input);
-
-      if (!error) {
-        String statusValue = doc["status"].as<String>();
-
-        lcd.clear();
-        if (statusValue == "GRANTED") {
-          lcd.print("Access Granted");
-          // Access granted beep (short high tone)
-          tone(buzzerPin, 1500, grantedBeepDuration);
-        } else if (statusValue == "DENIED") {
-          lcd.print("Access Denied");
-          // Access denied beep (long low tone)
-          tone(buzzerPin, 800, deniedBeepDuration);
-        } else {
-          lcd.print("Unknown Status");
-        }
-
-        enteredPassword = "";
-        waitingForAccessResponse = false;
-        delay(2000);
-        displayTempAndHum();
-        return;
-      } else {
-        Serial.println("❌ JSON parse error: " + String(error.c_str()));
-      }
-    }
+  espLink.poll();
+}
 
-    // Handle TEMP and HUM update if not entering password
-    if (!isEnteringPassword && input.startsWith("TEMP:")) {
-      int commaIndex = input.indexOf(',');
-      if (commaIndex != -1) {
-        lastTemp = input.substring(5, commaIndex);
-        int humIndex = input.indexOf("HUM:");
-        if (humIndex != -1) {
-          lastHum = input.substring(humIndex + 4);
-        }
-      }
-      displayTempAndHum();
+void onEspMessage(uint8_t type, const uint8_t *payload, uint8_t len) {
+  // Handle access response
+  if (type == MEGA_MSG_AUTH_RESULT && len == 1) {
+    Serial.print("Access result from ESP32: ");
+    Serial.println(payload[0]);
+    // Late answers to a request that already timed out are dropped
+    if (uiState != UI_WAITING_AUTH) return;
+
+    if (payload[0] == MEGA_AUTH_GRANTED) {
+      showResult("Access Granted", resultShowTime);
+      // Access granted beep (short high tone)
+      tone(buzzerPin, 1500, grantedBeepDuration);
+    } else if (payload[0] == MEGA_AUTH_DENIED) {
+      showResult("Access Denied", resultShowTime);
+      // Access denied beep (long low tone)
+      tone(buzzerPin, 800, deniedBeepDuration);
+    } else {
+      showResult("Unknown Status", resultShowTime);
     }
+    return;
+  }
+
+  if (type == MEGA_MSG_COMMAND_REPLY) {
+    Serial.print("ESP32: ");
+    Serial.write(payload, len);
+    Serial.println();
+    return;
+  }
+
+  // Keep the latest reading; the screen only shows it while idle
+  if (type == MEGA_MSG_SENSOR && len == 4) {
+    lastTemp = payload[0] | (payload[1] << 8);
+    lastHum = payload[2] | (payload[3] << 8);
+    haveReading = true;
+    if (uiState == UI_IDLE) displayTempAndHum();
   }
 }
 
 // Handle Keypad Logic
 void handleKeypadInput() {
   char key = keypad.getKey();
-  if (key) {
-    // Short beep for any key press
-    tone(buzzerPin, 1000, keyPressDuration);
-    
-    if (!isEnteringPassword) {
-      isEnteringPassword = true;
-      lcd.clear();
-      lcd.print("Enter Password:");
-      lcd.setCursor(0, 1);
-      lcd.print("PWD: ");
-    }
+  if (!key) return;
 
-    if (key == '#') {
-      if (enteredPassword.length() > 0) {
-        // Send password to ESP32
-        Serial1.print("KEYPAD:");
-        Serial1.println(enteredPassword);
-        Serial.print("Sent password: ");
-        Serial.println(enteredPassword);
-
-        lcd.clear();
-        lcd.print("Checking...");
-        waitingForAccessResponse = true;
-        isEnteringPassword = false;
-      }
-    } else if (key == '*') {
-      enteredPassword = "";
-      lcd.clear();
-      lcd.print("Cleared");
-      delay(1000);
-      isEnteringPassword = false;
-      displayTempAndHum();
-    } else {
-      enteredPassword += key;
-      lcd.setCursor(0, 1);
-      lcd.print("PWD: ");
-      for (int i = 0; i < (int)enteredPassword.length(); i++) {
-        lcd.print("*");
+  // Short beep for any key press
+  tone(buzzerPin, 1000, keyPressDuration);
+
+  switch (uiState) {
+    case UI_WAITING_AUTH:
+      // The PIN is on its way; keys wait for the answer
+      return;
+    case UI_SHOWING_RESULT:
+      // A key skips the rest of the message and starts a new PIN
+    case UI_IDLE:
+      passwordLength = 0;
+      screen.clear();
+      screen.print("Enter Password:");
+      screen.setCursor(0, 1);
+      screen.print("PWD: ");
+      break;
+    case UI_ENTERING_PIN:
+      break;
+  }
+  // Every key restarts the idle timeout
+  enterUiState(UI_ENTERING_PIN, pinIdleTimeout);
+
+  if (key == '#') {
+    if (passwordLength > 0) {
+      // Send password to ESP32 (acknowledged and retried by the link)
+      if (!espLink.send(MEGA_MSG_KEYPAD, enteredPassword, passwordLength, true)) {
+        showResult("Link Busy", resultShowTime);
+        return;
       }
+      Serial.println("Sent password");
+
+      screen.clear();
+      screen.print("Checking...");
+      passwordLength = 0;
+      enterUiState(UI_WAITING_AUTH, authTimeout);
+    }
+  } else if (key == '*') {
+    showResult("Cleared", clearedShowTime);
+  } else {
+    // Keys past the link's payload size are ignored
+    if (passwordLength == MegaLink::MAX_PAYLOAD) return;
+    enteredPassword[passwordLength++] = key;
+    enteredPassword[passwordLength] = '\0';
+    // Only the new '*' differs from what the LCD shows
+    screen.setCursor(0, 1);
+    screen.print("PWD: ");
+    for (uint8_t i = 0; i < passwordLength; i++) {
+      screen.print('*');
+    }
+  }
+}
+
+// Collect a console line; CR or LF sends it. Characters past the link's
+// payload size are dropped.
+void handleConsoleInput() {
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\r' && c != '\n') {
+      if (consoleLength < MegaLink::MAX_PAYLOAD) consoleLine[consoleLength++] = c;
+      continue;
+    }
+    if (consoleLength == 0) continue;
+    if (!espLink.send(MEGA_MSG_COMMAND, consoleLine, consoleLength, true)) {
+      Serial.println("Link busy, command not sent");
     }
+    consoleLength = 0;
   }
 }
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <math.h>
+
+// Geofence engine for many named zones.
+// Each zone has its own flat frame (equirectangular around its centre, on
+// the same sphere as TinyGPSPlus::distanceBetween) with the scales fixed
+// when the table is built; a fix is integer microdegrees and moving it
+// into a zone's frame is two 64-bit multiplies, no trig. Zones are indexed
+// in microdegrees by a uniform grid stored as compressed rows: a fix looks
+// up its cell, bbox-rejects the zones listed there and only runs the exact
+// circle / point-in-polygon test on what's left.
+//
+// Zone file (one zone per line, '#' comments):
+//   circle <name> <lat> <lon> <radius_m> [dwell_s]
+//   poly <name> <vertices> [dwell_s]
+//   <lat> <lon>                      <- one line per vertex
+// Frame coordinates are in 1/16 m, so the error is the flat frame's own:
+// about r^2 * tan(lat) / 2R at a zone's edge, r being its radius (half the
+// width for polygons). That is under 1 m for zones up to 3 km in radius
+// below 45 degrees of latitude; geofence_bench checks it against great
+// circle distances. Zones must stay under ~4000 km across.
+
+enum GeofenceEventType : uint8_t {
+  GEOFENCE_ENTER,
+  GEOFENCE_EXIT,
+  GEOFENCE_DWELL,  // still inside dwell_s after entering
+};
+
+struct GeofenceEvent {
+  GeofenceEventType type;
+  uint16_t zone;
+  const char *name;
+  uint32_t insideMs;  // time since ENTER (0 for ENTER)
+};
+
+typedef void (*GeofenceHandler)(const GeofenceEvent &ev);
+
+class Geofence {
+public:
+  static const uint8_t MAX_NAME = 16;
+  static const uint8_t MAX_INSIDE = 16;   // zones one position can be in at once
+  static const uint16_t GRID_SIDE = 64;   // cells per side, at most
+  static const int32_t MIN_CELL_E6 = 450; // microdegrees, ~50 m of latitude
+
+  ~Geofence() { clear(); }
+
+  // Allocate room for the zones about to be added; drops any loaded table
+  bool reserve(uint16_t zones, uint16_t vertices) {
+    clear();
+    zoneTable = (Zone *)calloc(zones ? zones : 1, sizeof(Zone));
+    vertexTable = (Point *)calloc(vertices ? vertices : 1, sizeof(Point));
+    if (!zoneTable || !vertexTable) {
+      clear();
+      return false;
+    }
+    zoneCapacity = zones;
+    vertexCapacity = vertices;
+    return true;
+  }
+
+  bool addCircle(const char *name, double lat, double lon, uint32_t radiusM, uint32_t dwellS = 0) {
+    Zone *z = radiusM ? newZone(name, dwellS) : nullptr;
+    if (!z) return false;
+    Point c = toE6(lat, lon);
+    setFrame(*z, c);
+    z->radius = radiusM;
+    // Everything the frame puts within the radius, plus a microdegree
+    int64_t r = (int64_t)radiusM << SUB_M_BITS;
+    int32_t dx = (int32_t)min((int64_t)360000000, ((r << FRAME_BITS) + z->scaleX - 1) / z->scaleX + 1);
+    int32_t dy = (int32_t)min((int64_t)180000000, ((r << FRAME_BITS) + z->scaleY - 1) / z->scaleY + 1);
+    z->minX = c.x - dx;
+    z->maxX = c.x + dx;
+    z->minY = c.y - dy;
+    z->maxY = c.y + dy;
+    zoneCount++;
+    return true;
+  }
+
+  // Vertices follow with addVertex(); at least three are needed
+  bool beginPolygon(const char *name, uint32_t dwellS = 0) {
+    Zone *z = newZone(name, dwellS);
+    if (!z) return false;
+    z->firstVertex = vertexCount;
+    z->minX = z->minY = INT32_MAX;
+    z->maxX = z->maxY = INT32_MIN;
+    zoneCount++;
+    return true;
+  }
+
+  // Vertices are kept in microdegrees until build() moves them into the
+  // polygon's frame
+  bool addVertex(double lat, double lon) {
+    if (!zoneCount || vertexCount >= vertexCapacity) return false;
+    Zone &z = zoneTable[zoneCount - 1];
+    if (z.radius || z.scaleX) return false;
+    Point p = toE6(lat, lon);
+    vertexTable[vertexCount++] = p;
+    z.vertices++;
+    z.minX = min(z.minX, p.x);
+    z.maxX = max(z.maxX, p.x);
+    z.minY = min(z.minY, p.y);
+    z.maxY = max(z.maxY, p.y);
+    return true;
+  }
+
+  // Build the grid index; call once after the last zone is added
+  bool build() {
+    free(cellStart);
+    free(cellZones);
+    cellStart = nullptr;
+    cellZones = nullptr;
+    for (uint16_t i = 0; i < zoneCount; i++) {
+      if (!zoneTable[i].radius && zoneTable[i].vertices < 3) return false;
+    }
+    for (uint16_t i = 0; i < zoneCount; i++) {
+      if (!zoneTable[i].scaleX) projectPolygon(zoneTable[i]);
+    }
+    if (!zoneCount) return true;
+
+    gridMinX = gridMinY = INT32_MAX;
+    int32_t gridMaxX = INT32_MIN, gridMaxY = INT32_MIN;
+    for (uint16_t i = 0; i < zoneCount; i++) {
+      gridMinX = min(gridMinX, zoneTable[i].minX);
+      gridMinY = min(gridMinY, zoneTable[i].minY);
+      gridMaxX = max(gridMaxX, zoneTable[i].maxX);
+      gridMaxY = max(gridMaxY, zoneTable[i].maxY);
+    }
+    int64_t spanX = (int64_t)gridMaxX - gridMinX + 1;
+    int64_t spanY = (int64_t)gridMaxY - gridMinY + 1;
+    int64_t cell = max((int64_t)MIN_CELL_E6, max((spanX + GRID_SIDE - 1) / GRID_SIDE, (spanY + GRID_SIDE - 1) / GRID_SIDE));
+    cellSize = (int32_t)cell;
+    cols = (uint16_t)((spanX + cell - 1) / cell);
+    rows = (uint16_t)((spanY + cell - 1) / cell);
+
+    // Count, prefix-sum, then fill: cellZones[cellStart[c]..cellStart[c+1])
+    uint32_t cells = (uint32_t)cols * rows;
+    cellStart = (uint32_t *)calloc(cells + 1, sizeof(uint32_t));
+    if (!cellStart) return false;
+    for (uint16_t i = 0; i < zoneCount; i++) forEachCell(zoneTable[i], [&](uint32_t c) { cellStart[c + 1]++; });
+    for (uint32_t c = 0; c < cells; c++) cellStart[c + 1] += cellStart[c];
+    cellZones = (uint16_t *)malloc((cellStart[cells] ? cellStart[cells] : 1) * sizeof(uint16_t));
+    uint32_t *fill = (uint32_t *)malloc(cells * sizeof(uint32_t));
+    if (!cellZones || !fill) {
+      free(fill);
+      return false;
+    }
+    memcpy(fill, cellStart, cells * sizeof(uint32_t));
+    for (uint16_t i = 0; i < zoneCount; i++) forEachCell(zoneTable[i], [&](uint32_t c) { cellZones[fill[c]++] = i; });
+    free(fill);
+    insideCount = 0;
+    return true;
+  }
+
+  // Parse a zone file (see top of file). Returns false, leaving no zones,
+  // if it's missing or malformed.
+  bool load(fs::FS &fs, const char *path) {
+    uint16_t zones = 0, vertices = 0;
+    if (!parse(fs, path, zones, vertices, false) || !reserve(zones, vertices) ||
+        !parse(fs, path, zones, vertices, true) || !build()) {
+      clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Feed a position; fires ENTER/EXIT/DWELL through handler and returns
+  // how many zones contain it.
+  uint8_t update(double lat, double lon, uint32_t nowMs, GeofenceHandler handler) {
+    uint16_t hits[MAX_INSIDE];
+    uint8_t hitCount = query(toE6(lat, lon), hits);
+
+    for (uint8_t i = 0; i < insideCount;) {
+      if (contains(hits, hitCount, inside[i].zone)) {
+        i++;
+        continue;
+      }
+      emit(handler, GEOFENCE_EXIT, inside[i].zone, nowMs - inside[i].since);
+      inside[i] = inside[--insideCount];
+    }
+    for (uint8_t i = 0; i < hitCount; i++) {
+      if (isInside(hits[i]) || insideCount == MAX_INSIDE) continue;
+      inside[insideCount++] = { hits[i], nowMs, false };
+      emit(handler, GEOFENCE_ENTER, hits[i], 0);
+    }
+    for (uint8_t i = 0; i < insideCount; i++) {
+      Inside &in = inside[i];
+      uint32_t dwellMs = zoneTable[in.zone].dwellMs;
+      if (in.dwellSent || !dwellMs || nowMs - in.since < dwellMs) continue;
+      in.dwellSent = true;
+      emit(handler, GEOFENCE_DWELL, in.zone, nowMs - in.since);
+    }
+    return insideCount;
+  }
+
+  uint16_t zones() const { return zoneCount; }
+  const char *name(uint16_t zone) const { return zoneTable[zone].name; }
+  uint32_t exactTests() const { return exactTestCount; }
+
+private:
+  // Microdegrees of longitude / latitude, or 1/16 m east / north of a
+  // zone's centre once in its frame
+  struct Point {
+    int32_t x, y;
+  };
+
+  struct Zone {
+    char name[MAX_NAME];
+    int32_t minX, minY, maxX, maxY;  // bbox, microdegrees
+    uint32_t dwellMs;
+    Point centre;          // frame origin, microdegrees
+    int32_t scaleX, scaleY;  // frame units per microdegree, FRAME_BITS fraction; 0 until set
+    uint32_t radius;       // meters, 0 for polygons
+    uint16_t firstVertex;
+    uint16_t vertices;
+  };
+
+  static const uint8_t SUB_M_BITS = 4;   // frame coordinates in 1/16 m
+  static const uint8_t FRAME_BITS = 20;
+  static constexpr double EARTH_RADIUS_M = 6372795;  // as TinyGPSPlus::distanceBetween
+
+  struct Inside {
+    uint16_t zone;
+    uint32_t since;
+    bool dwellSent;
+  };
+
+  Zone *zoneTable = nullptr;
+  Point *vertexTable = nullptr;
+  uint16_t zoneCount = 0, zoneCapacity = 0;
+  uint16_t vertexCount = 0, vertexCapacity = 0;
+
+  int32_t gridMinX = 0, gridMinY = 0, cellSize = 1;
+  uint16_t cols = 0, rows = 0;
+  uint32_t *cellStart = nullptr;
+  uint16_t *cellZones = nullptr;
+
+  Inside inside[MAX_INSIDE];
+  uint8_t insideCount = 0;
+  uint32_t exactTestCount = 0;
+
+  void clear() {
+    free(zoneTable);
+    free(vertexTable);
+    free(cellStart);
+    free(cellZones);
+    zoneTable = nullptr;
+    vertexTable = nullptr;
+    cellStart = nullptr;
+    cellZones = nullptr;
+    zoneCount = zoneCapacity = vertexCount = vertexCapacity = 0;
+    cols = rows = 0;
+    insideCount = 0;
+  }
+
+  Zone *newZone(const char *name, uint32_t dwellS) {
+    if (zoneCount >= zoneCapacity) return nullptr;
+    Zone *z = &zoneTable[zoneCount];
+    memset(z, 0, sizeof(*z));
+    strlcpy(z->name, name, sizeof(z->name));
+    z->dwellMs = dwellS * 1000;
+    return z;
+  }
+
+  static Point toE6(double lat, double lon) {
+    Point p;
+    p.x = (int32_t)lround(lon * 1e6);
+    p.y = (int32_t)lround(lat * 1e6);
+    return p;
+  }
+
+  // The only trig, once per zone
+  static void setFrame(Zone &z, Point centre) {
+    double perE6 = EARTH_RADIUS_M * M_PI / 180e6 * (1 << SUB_M_BITS) * (1 << FRAME_BITS);
+    z.centre = centre;
+    z.scaleY = (int32_t)lround(perE6);
+    z.scaleX = max((int32_t)1, (int32_t)lround(perE6 * cos(centre.y * M_PI / 180e6)));
+  }
+
+  // Rounded to the nearest 1/16 m
+  static Point toFrame(const Zone &z, Point p) {
+    const int64_t half = 1 << (FRAME_BITS - 1);
+    Point f;
+    f.x = (int32_t)(((int64_t)(p.x - z.centre.x) * z.scaleX + half) >> FRAME_BITS);
+    f.y = (int32_t)(((int64_t)(p.y - z.centre.y) * z.scaleY + half) >> FRAME_BITS);
+    return f;
+  }
+
+  // Frame around the middle of the bbox, so no vertex is more than half
+  // the polygon's size from its origin
+  void projectPolygon(Zone &z) {
+    Point centre = { (int32_t)(((int64_t)z.minX + z.maxX) / 2), (int32_t)(((int64_t)z.minY + z.maxY) / 2) };
+    setFrame(z, centre);
+    for (uint16_t i = 0; i < z.vertices; i++) {
+      Point &v = vertexTable[z.firstVertex + i];
+      v = toFrame(z, v);
+    }
+  }
+
+  template <typename F>
+  void forEachCell(const Zone &z, F f) const {
+    uint16_t c0 = (z.minX - gridMinX) / cellSize, c1 = (z.maxX - gridMinX) / cellSize;
+    uint16_t r0 = (z.minY - gridMinY) / cellSize, r1 = (z.maxY - gridMinY) / cellSize;
+    for (uint16_t r = r0; r <= r1; r++) {
+      for (uint16_t c = c0; c <= c1; c++) f((uint32_t)r * cols + c);
+    }
+  }
+
+  uint8_t query(Point p, uint16_t *hits) {
+    if (!cellStart || p.x < gridMinX || p.y < gridMinY) return 0;
+    uint32_t c = (uint32_t)(p.x - gridMinX) / cellSize;
+    uint32_t r = (uint32_t)(p.y - gridMinY) / cellSize;
+    if (c >= cols || r >= rows) return 0;
+
+    uint8_t n = 0;
+    uint32_t cell = r * cols + c;
+    for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1] && n < MAX_INSIDE; k++) {
+      const Zone &z = zoneTable[cellZones[k]];
+      if (p.x < z.minX || p.x > z.maxX || p.y < z.minY || p.y > z.maxY) continue;
+      exactTestCount++;
+      Point f = toFrame(z, p);
+      if (z.radius ? inCircle(z, f) : inPolygon(z, f)) hits[n++] = cellZones[k];
+    }
+    return n;
+  }
+
+  // p in the zone's frame, as for inPolygon()
+  static bool inCircle(const Zone &z, Point p) {
+    int64_t r = (int64_t)z.radius << SUB_M_BITS;
+    return (int64_t)p.x * p.x + (int64_t)p.y * p.y <= r * r;
+  }
+
+  // Crossing number, all in integers: the edge crosses the ray to +x when
+  // the intersection's x is right of p, compared without dividing.
+  bool inPolygon(const Zone &z, Point p) const {
+    const Point *v = &vertexTable[z.firstVertex];
+    bool in = false;
+    for (uint16_t i = 0, j = z.vertices - 1; i < z.vertices; j = i++) {
+      const Point &a = v[i], &b = v[j];
+      if ((a.y > p.y) == (b.y > p.y)) continue;
+      int64_t edge = ((int64_t)b.x - a.x) * ((int64_t)p.y - a.y);
+      int64_t point = ((int64_t)p.x - a.x) * ((int64_t)b.y - a.y);
+      if (b.y > a.y ? point < edge : point > edge) in = !in;
+    }
+    return in;
+  }
+
+  static bool contains(const uint16_t *list, uint8_t n, uint16_t zone) {
+    for (uint8_t i = 0; i < n; i++) {
+      if (list[i] == zone) return true;
+    }
+    return false;
+  }
+
+  bool isInside(uint16_t zone) const {
+    for (uint8_t i = 0; i < insideCount; i++) {
+      if (inside[i].zone == zone) return true;
+    }
+    return false;
+  }
+
+  void emit(GeofenceHandler handler, GeofenceEventType type, uint16_t zone, uint32_t insideMs) {
+    if (!handler) return;
+    GeofenceEvent ev = { type, zone, zoneTable[zone].name, insideMs };
+    handler(ev);
+  }
+
+  // First pass (fill=false) only counts zones and vertices
+  bool parse(fs::FS &fs, const char *path, uint16_t &zones, uint16_t &vertices, bool fill) {
+    File f = fs.open(path, "r");
+    if (!f) return false;
+    char line[96], name[MAX_NAME];
+    uint16_t pendingVertices = 0;
+    uint32_t z = 0, v = 0;
+    bool ok = true;
+
+    while (ok && f.available()) {
+      size_t len = f.readBytesUntil('\n', line, sizeof(line) - 1);
+      line[len] = '\0';
+      char *hash = strchr(line, '#');
+      if (hash) *hash = '\0';
+      double lat, lon;
+      unsigned long a = 0, b = 0;
+
+      if (pendingVertices) {
+        ok = sscanf(line, "%lf %lf", &lat, &lon) == 2 && (!fill || addVertex(lat, lon));
+        pendingVertices--;
+        v++;
+      } else if (sscanf(line, " circle %15s %lf %lf %lu %lu", name, &lat, &lon, &a, &b) >= 4) {
+        ok = !fill || addCircle(name, lat, lon, a, b);
+        z++;
+      } else if (sscanf(line, " poly %15s %lu %lu", name, &a, &b) >= 2) {
+        ok = a >= 3 && (!fill || beginPolygon(name, b));
+        pendingVertices = a;
+        z++;
+      } else {
+        for (char *p = line; *p; p++) {
+          if (!isspace((uint8_t)*p)) ok = false;  // not blank, not a comment
+        }
+      }
+    }
+    f.close();
+    if (!ok || pendingVertices || z > UINT16_MAX || v > UINT16_MAX) return false;
+    zones = z;
+    vertices = v;
+    return true;
+  }
+};
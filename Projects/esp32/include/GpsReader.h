@@ -0,0 +1,159 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <TinyGPSPlus.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// NMEA ingestion on its own task.
+// The UART driver's ISR moves bytes from the 128-byte hardware FIFO into a
+// large driver ring buffer; its event task wakes us through onReceive() and
+// we drain everything into TinyGPSPlus in one go. Nothing on this path
+// blocks, so HTTP posts and WiFi reconnects in loop() can't make the FIFO
+// overflow. Loop code only ever sees a copy of the latest fix.
+
+struct GpsFix {
+  uint32_t seq;         // bumped for every new position
+  uint32_t millisAt;    // millis() when the position arrived
+  double lat;
+  double lon;
+  float speedKmph;
+  float altitudeM;
+  uint8_t satellites;
+  uint16_t year;        // 0 until the receiver reports a date
+  uint8_t month, day, hour, minute, second;
+};
+
+struct GpsStats {
+  uint32_t chars;
+  uint32_t sentencesWithFix;
+  uint32_t passedChecksum;
+  uint32_t failedChecksum;
+  uint32_t overruns;    // driver ring buffer or hardware FIFO full, bytes lost
+  uint32_t lineErrors;  // framing / parity / break
+  uint16_t maxBacklog;  // most bytes waiting when the task woke up
+};
+
+class GpsReader {
+public:
+  static const size_t RX_BUFFER = 2048;     // ~2 s of NMEA at 9600 baud
+  static const uint32_t BLINK_MS = 50;
+
+  GpsReader(HardwareSerial &serial, int8_t ledPin = -1) : serial(serial), ledPin(ledPin) {}
+
+  bool begin(uint32_t baud, int8_t rxPin, int8_t txPin, BaseType_t core = 0) {
+    if (ledPin >= 0) pinMode(ledPin, OUTPUT);
+    serial.setRxBufferSize(RX_BUFFER);  // must precede begin()
+    serial.begin(baud, SERIAL_8N1, rxPin, txPin);
+    if (xTaskCreatePinnedToCore(readerTask, "gps", 4096, this, 3, &task, core) != pdPASS) return false;
+    serial.onReceiveError([this](hardwareSerial_error_t err) { onError(err); });
+    serial.onReceive([this]() { xTaskNotifyGive(task); });
+    return true;
+  }
+
+  // Copy of the newest fix; false until the receiver has produced one
+  bool latest(GpsFix &out) {
+    portENTER_CRITICAL(&mux);
+    out = fix;
+    portEXIT_CRITICAL(&mux);
+    return out.seq != 0;
+  }
+
+  GpsStats stats() {
+    portENTER_CRITICAL(&mux);
+    GpsStats s = counters;
+    portEXIT_CRITICAL(&mux);
+    return s;
+  }
+
+  void printStats(Print &out) {
+    GpsStats s = stats();
+    out.printf("[GPS] chars=%lu fixes=%lu ok=%lu badsum=%lu overrun=%lu lineerr=%lu backlog=%u\n",
+               (unsigned long)s.chars, (unsigned long)s.sentencesWithFix,
+               (unsigned long)s.passedChecksum, (unsigned long)s.failedChecksum,
+               (unsigned long)s.overruns, (unsigned long)s.lineErrors, s.maxBacklog);
+  }
+
+private:
+  HardwareSerial &serial;
+  int8_t ledPin;
+  TaskHandle_t task = nullptr;
+  TinyGPSPlus gps;  // only touched by the reader task
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+  GpsFix fix = {};
+  GpsStats counters = {};
+  uint32_t ledOffAt = 0;
+  bool ledOn = false;
+
+  void onError(hardwareSerial_error_t err) {
+    portENTER_CRITICAL(&mux);
+    if (err == UART_BUFFER_FULL_ERROR || err == UART_FIFO_OVF_ERROR) counters.overruns++;
+    else counters.lineErrors++;
+    portEXIT_CRITICAL(&mux);
+  }
+
+  void blink() {
+    if (ledPin < 0) return;
+    digitalWrite(ledPin, HIGH);
+    ledOn = true;
+    ledOffAt = millis() + BLINK_MS;
+  }
+
+  void publish() {
+    GpsFix next;
+    next.millisAt = millis();
+    next.lat = gps.location.lat();
+    next.lon = gps.location.lng();
+    next.speedKmph = gps.speed.kmph();
+    next.altitudeM = gps.altitude.meters();
+    next.satellites = gps.satellites.value();
+    next.year = gps.date.isValid() ? gps.date.year() : 0;
+    next.month = gps.date.month();
+    next.day = gps.date.day();
+    next.hour = gps.time.hour();
+    next.minute = gps.time.minute();
+    next.second = gps.time.second();
+
+    portENTER_CRITICAL(&mux);
+    next.seq = fix.seq + 1;
+    fix = next;
+    portEXIT_CRITICAL(&mux);
+  }
+
+  void drain() {
+    uint8_t buf[128];
+    size_t waiting = serial.available();
+
+    size_t n;
+    while ((n = serial.read(buf, sizeof(buf))) > 0) {
+      for (size_t i = 0; i < n; i++) {
+        if (!gps.encode(buf[i])) continue;
+        blink();
+        if (gps.location.isUpdated()) publish();
+      }
+    }
+
+    portENTER_CRITICAL(&mux);
+    if (waiting > counters.maxBacklog) counters.maxBacklog = waiting;
+    counters.chars = gps.charsProcessed();
+    counters.sentencesWithFix = gps.sentencesWithFix();
+    counters.passedChecksum = gps.passedChecksum();
+    counters.failedChecksum = gps.failedChecksum();
+    portEXIT_CRITICAL(&mux);
+  }
+
+  static void readerTask(void *arg) {
+    GpsReader *self = static_cast<GpsReader *>(arg);
+    for (;;) {
+      // Wake on data, or in time to switch the LED off
+      TickType_t wait = self->ledOn ? pdMS_TO_TICKS(10) : pdMS_TO_TICKS(1000);
+      ulTaskNotifyTake(pdTRUE, wait);
+      self->drain();
+      if (self->ledOn && (int32_t)(millis() - self->ledOffAt) >= 0) {
+        digitalWrite(self->ledPin, LOW);
+        self->ledOn = false;
+      }
+    }
+  }
+};
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "GpsReader.h"
+#include "TrackReporter.h"
+
+// Append-only flash log for track points that couldn't be uploaded.
+// Points are grouped into 256-byte pages. The first record of a page is a
+// keyframe with absolute values, every later record holds zig-zag varint
+// deltas from the one before it (time, lat/lon in microdegrees, speed in
+// 0.1 km/h, altitude in dm); a fix a few seconds apart takes ~7 bytes.
+//
+// The page being filled lives in the tail file and grows by one record per
+// append; LittleFS commits each append atomically, so a reset can only
+// lose the record being written. Full pages get a CRC16 header and move
+// to the log file. Uploads read from an on-flash cursor (page, record); once
+// everything is out the files are deleted. The cursor page is the head of
+// the log: uploaded pages, and pages dropped because the log is full, stay
+// in the file until COMPACT_AFTER of them have piled up and are then
+// compacted away in one copy. Delivery is at-least-once: a reset
+// mid-upload can send a chunk twice, never skip one.
+
+static const char TRACKLOG_FILE[] = "/track.log";
+static const char TRACKLOG_TAIL_FILE[] = "/track.tail";
+static const char TRACKLOG_CURSOR_FILE[] = "/track.idx";
+static const char TRACKLOG_TMP_FILE[] = "/track.tmp";
+
+class TrackLog {
+public:
+  static const uint16_t PAGE_SIZE = 256;
+  static const uint16_t MAX_PAGES = 1024;     // unsent pages: 256 KB of flash, ~35k fixes
+  static const uint16_t COMPACT_AFTER = 64;   // dead pages before the head before compacting
+
+  // LittleFS must already be mounted
+  bool begin() {
+    // Compaction cut short: the copy is complete once the old log is gone
+    if (LittleFS.exists(TRACKLOG_TMP_FILE)) {
+      if (LittleFS.exists(TRACKLOG_FILE)) LittleFS.remove(TRACKLOG_TMP_FILE);
+      else LittleFS.rename(TRACKLOG_TMP_FILE, TRACKLOG_FILE);
+    }
+    File f = LittleFS.open(TRACKLOG_FILE, "r");
+    sealed = f ? f.size() / PAGE_SIZE : 0;
+    if (f) f.close();
+
+    cursorPage = cursorRecord = 0;
+    File idx = LittleFS.open(TRACKLOG_CURSOR_FILE, "r");
+    if (idx) {
+      uint16_t c[2];
+      if (idx.read((uint8_t *)c, sizeof(c)) == sizeof(c) && c[0] <= sealed) {
+        cursorPage = c[0];
+        cursorRecord = c[1];
+      }
+      idx.close();
+    }
+
+    loadTail();
+
+    pendingRecords = tailCount;
+    for (uint16_t p = cursorPage; p < sealed; p++) {
+      PageHeader h;
+      if (readPage(p, h, nullptr)) pendingRecords += h.count;
+    }
+    pendingRecords -= min((uint32_t)cursorRecord, pendingRecords);
+    Serial.printf("[TRACKLOG] %lu points waiting in %u pages\n", (unsigned long)pendingRecords, sealed - cursorPage);
+    return true;
+  }
+
+  bool append(const GpsFix &fix) {
+    if (!fix.year) return false;  // no date yet, nothing to key deltas on
+    Record r = toRecord(fix);
+
+    uint8_t rec[MAX_RECORD];
+    uint8_t n = encode(rec, r, tailCount ? &last : nullptr);
+    if (tailLen + n > PAYLOAD) {
+      if (!seal()) return false;
+      n = encode(rec, r, nullptr);
+    }
+
+    File f = LittleFS.open(TRACKLOG_TAIL_FILE, "a");
+    if (!f) return false;
+    bool ok = f.write(rec, n) == n;
+    f.close();
+    if (!ok) return false;
+
+    memcpy(tail + tailLen, rec, n);
+    tailLen += n;
+    tailCount++;
+    last = r;
+    pendingRecords++;
+    appendedBytes += n;
+    appendedRecords++;
+    return true;
+  }
+
+  uint32_t pending() const { return pendingRecords; }
+  uint32_t dropped() const { return droppedRecords; }
+
+  // Bytes per record over this boot's appends, 0 before the first
+  float bytesPerFix() const { return appendedRecords ? (float)appendedBytes / appendedRecords : 0; }
+
+  // Oldest pending points as a JSON array, stopping before outLen is
+  // exceeded. Returns the number of points; commit() once accepted.
+  uint16_t buildBatch(char *out, size_t outLen, const char *deviceId) {
+    size_t len = 0;
+    out[len++] = '[';
+    batchCount = 0;
+    batchDropped = 0;
+    batchPage = cursorPage;
+    batchRecord = cursorRecord;
+
+    char item[200];
+    uint8_t page[PAYLOAD];
+    while (batchPage <= sealed) {
+      PageHeader h;
+      const uint8_t *data;
+      if (batchPage == sealed) {
+        data = tail;
+        h.used = tailLen;
+        h.count = tailCount;
+      } else if (readPage(batchPage, h, page)) {
+        data = page;
+      } else {
+        // Unreadable page, skip it rather than wedging the upload
+        batchDropped += h.count > batchRecord ? h.count - batchRecord : 0;
+        batchPage++;
+        batchRecord = 0;
+        continue;
+      }
+
+      const uint8_t *p = data, *end = data + h.used;
+      Record r;
+      bool full = false;
+      uint8_t i = 0;
+      for (; i < h.count && decode(p, end, r, i ? &r : nullptr); i++) {
+        if (i < batchRecord) continue;
+        GpsFix fix = toFix(r);
+        int n = formatTrackPoint(item, sizeof(item), fix, deviceId);
+        // room for the separator, the closing bracket and the NUL
+        if (n < 0 || len + n + 3 > outLen) {
+          full = true;
+          break;
+        }
+        if (batchCount) out[len++] = ',';
+        memcpy(out + len, item, n);
+        len += n;
+        batchCount++;
+        batchRecord = i + 1;
+      }
+      if (!full && i < h.count) {
+        // Passed its CRC but a record doesn't decode; the rest of the page
+        // can't be recovered without it
+        uint8_t lost = h.count - max(i, batchRecord);
+        Serial.printf("[TRACKLOG] Page %u record %u undecodable, %u points lost\n", batchPage, i, lost);
+        batchDropped += lost;
+        batchRecord = h.count;
+      }
+      if (full || batchPage == sealed) break;
+      batchPage++;
+      batchRecord = 0;
+    }
+    out[len++] = ']';
+    out[len] = '\0';
+    return batchCount;
+  }
+
+  void commit() {
+    pendingRecords -= min((uint32_t)batchCount + batchDropped, pendingRecords);
+    droppedRecords += batchDropped;
+    batchCount = 0;
+    batchDropped = 0;
+    cursorPage = batchPage;
+    cursorRecord = batchRecord;
+
+    if (cursorPage == sealed && cursorRecord >= tailCount) {
+      // Everything is on the server, start over with empty files
+      LittleFS.remove(TRACKLOG_FILE);
+      LittleFS.remove(TRACKLOG_TAIL_FILE);
+      LittleFS.remove(TRACKLOG_CURSOR_FILE);
+      sealed = cursorPage = cursorRecord = 0;
+      tailLen = tailCount = 0;
+      pendingRecords = 0;
+      return;
+    }
+    if (cursorPage >= COMPACT_AFTER) compact();
+    else saveCursor();
+  }
+
+  void printStats(Print &out) const {
+    out.printf("[TRACKLOG] pending=%lu pages=%u bytes/fix=%.1f dropped=%lu\n", (unsigned long)pendingRecords,
+               sealed - cursorPage + 1, bytesPerFix(), (unsigned long)droppedRecords);
+  }
+
+private:
+  struct PageHeader {
+    uint16_t magic;
+    uint16_t used;   // payload bytes
+    uint8_t count;   // records
+    uint8_t reserved;
+    uint16_t crc;    // CRC16-CCITT of the payload
+  };
+
+  struct Record {
+    uint32_t time;   // unix seconds (UTC, from the GPS date)
+    int32_t lat;     // microdegrees
+    int32_t lon;
+    int32_t speed;   // 0.1 km/h
+    int32_t alt;     // dm
+  };
+
+  static const uint16_t MAGIC = 0x4B54;  // "TK"
+  static const uint16_t PAYLOAD = PAGE_SIZE - sizeof(PageHeader);
+  static const uint8_t MAX_RECORD = 5 * 5;
+
+  uint16_t sealed = 0;        // full pages in TRACKLOG_FILE
+  uint16_t cursorPage = 0;    // first page with unsent records (== sealed: the tail)
+  uint8_t cursorRecord = 0;   // records of cursorPage already sent
+  uint8_t tail[PAYLOAD];
+  uint16_t tailLen = 0;
+  uint8_t tailCount = 0;
+  Record last = {};
+
+  uint16_t batchCount = 0;
+  uint16_t batchDropped = 0;  // undecodable records the batch skips over
+  uint16_t batchPage = 0;
+  uint8_t batchRecord = 0;
+
+  uint32_t pendingRecords = 0;
+  uint32_t droppedRecords = 0;
+  uint32_t appendedBytes = 0, appendedRecords = 0;
+
+  static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+  static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+  static uint8_t putVarint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+      p[n++] = (uint8_t)v | 0x80;
+      v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+  }
+
+  static bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v) {
+    v = 0;
+    for (uint8_t shift = 0; p < end && shift < 35; shift += 7) {
+      uint8_t b = *p++;
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  // Keyframe when prev is null, deltas otherwise
+  static uint8_t encode(uint8_t *out, const Record &r, const Record *prev) {
+    Record base = prev ? *prev : Record();
+    uint8_t n = 0;
+    n += putVarint(out + n, prev ? zigzag((int32_t)(r.time - base.time)) : r.time);
+    n += putVarint(out + n, zigzag(r.lat - base.lat));
+    n += putVarint(out + n, zigzag(r.lon - base.lon));
+    n += putVarint(out + n, zigzag(r.speed - base.speed));
+    n += putVarint(out + n, zigzag(r.alt - base.alt));
+    return n;
+  }
+
+  // prev may alias r
+  static bool decode(const uint8_t *&p, const uint8_t *end, Record &r, const Record *prev) {
+    Record base = prev ? *prev : Record();
+    uint32_t v[5];
+    for (uint8_t i = 0; i < 5; i++) {
+      if (!getVarint(p, end, v[i])) return false;
+    }
+    r.time = prev ? base.time + unzigzag(v[0]) : v[0];
+    r.lat = base.lat + unzigzag(v[1]);
+    r.lon = base.lon + unzigzag(v[2]);
+    r.speed = base.speed + unzigzag(v[3]);
+    r.alt = base.alt + unzigzag(v[4]);
+    return true;
+  }
+
+  static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+      crc ^= (uint16_t)*data++ << 8;
+      for (uint8_t i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+  }
+
+  // Days since 1970-01-01 for a civil date, and back (Howard Hinnant)
+  static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+  }
+
+  static void civilFromDays(int32_t z, uint16_t &y, uint8_t &m, uint8_t &d) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (uint16_t)((int32_t)yoe + era * 400 + (m <= 2));
+  }
+
+  static Record toRecord(const GpsFix &fix) {
+    Record r;
+    r.time = (uint32_t)daysFromCivil(fix.year, fix.month, fix.day) * 86400UL +
+             fix.hour * 3600UL + fix.minute * 60UL + fix.second;
+    r.lat = (int32_t)lround(fix.lat * 1e6);
+    r.lon = (int32_t)lround(fix.lon * 1e6);
+    r.speed = (int32_t)lroundf(fix.speedKmph * 10);
+    r.alt = (int32_t)lroundf(fix.altitudeM * 10);
+    return r;
+  }
+
+  static GpsFix toFix(const Record &r) {
+    GpsFix fix = {};
+    civilFromDays(r.time / 86400, fix.year, fix.month, fix.day);
+    uint32_t s = r.time % 86400;
+    fix.hour = s / 3600;
+    fix.minute = s / 60 % 60;
+    fix.second = s % 60;
+    fix.lat = r.lat / 1e6;
+    fix.lon = r.lon / 1e6;
+    fix.speedKmph = r.speed / 10.0f;
+    fix.altitudeM = r.alt / 10.0f;
+    return fix;
+  }
+
+  // Header of a sealed page, plus its CRC-checked payload when out is
+  // given; false if it can't be read or fails its checks
+  bool readPage(uint16_t page, PageHeader &h, uint8_t *out) {
+    h.count = 0;
+    File f = LittleFS.open(TRACKLOG_FILE, "r");
+    if (!f) return false;
+    bool ok = f.seek((uint32_t)page * PAGE_SIZE) && f.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+              h.magic == MAGIC && h.used <= PAYLOAD;
+    if (ok && out) ok = f.read(out, h.used) == h.used && crc16(out, h.used) == h.crc;
+    f.close();
+    return ok;
+  }
+
+  void loadTail() {
+    tailLen = tailCount = 0;
+    File f = LittleFS.open(TRACKLOG_TAIL_FILE, "r");
+    if (!f) return;
+    size_t size = f.read(tail, PAYLOAD);
+    f.close();
+
+    // Keep the records that decode cleanly
+    const uint8_t *p = tail, *end = tail + size;
+    Record r;
+    while (p < end && decode(p, end, r, tailCount ? &last : nullptr)) {
+      last = r;
+      tailCount++;
+      tailLen = p - tail;
+    }
+
+    // A reset between sealing and deleting the tail leaves it duplicated
+    PageHeader h;
+    uint8_t page[PAYLOAD];
+    if (sealed && readPage(sealed - 1, h, page) && h.used == tailLen && memcmp(page, tail, tailLen) == 0) {
+      LittleFS.remove(TRACKLOG_TAIL_FILE);
+      tailLen = tailCount = 0;
+    } else if (tailLen != size) {
+      rewriteTail();
+    }
+  }
+
+  void rewriteTail() {
+    File f = LittleFS.open(TRACKLOG_TAIL_FILE, "w");
+    if (!f) return;
+    f.write(tail, tailLen);
+    f.close();
+  }
+
+  bool seal() {
+    if (sealed - cursorPage >= MAX_PAGES) dropOldestPage();
+
+    PageHeader h = { MAGIC, tailLen, tailCount, 0, crc16(tail, tailLen) };
+    File f = LittleFS.open(TRACKLOG_FILE, "a");
+    if (!f) return false;
+    bool ok = f.write((const uint8_t *)&h, sizeof(h)) == sizeof(h) && f.write(tail, PAYLOAD) == PAYLOAD;
+    f.close();
+    if (!ok) return false;
+
+    sealed++;
+    LittleFS.remove(TRACKLOG_TAIL_FILE);
+    tailLen = tailCount = 0;
+    return true;
+  }
+
+  // Offline for so long that the log is full: lose the oldest page
+  void dropOldestPage() {
+    PageHeader h;
+    readPage(cursorPage, h, nullptr);
+    uint32_t lost = h.count > cursorRecord ? h.count - cursorRecord : 0;
+    droppedRecords += lost;
+    pendingRecords -= min(lost, pendingRecords);
+    cursorPage++;
+    cursorRecord = 0;
+    if (cursorPage >= COMPACT_AFTER) compact();
+    else saveCursor();
+  }
+
+  // Copy the unsent pages to a fresh file. The cursor is saved first, so
+  // a reset in between re-sends pages instead of skipping them. If a page
+  // can't be copied the old file stays as it is and a later commit tries
+  // again.
+  void compact() {
+    uint16_t keep = cursorPage;
+    uint16_t record = cursorRecord;
+    File in = LittleFS.open(TRACKLOG_FILE, "r");
+    File out = LittleFS.open(TRACKLOG_TMP_FILE, "w");
+    if (!in || !out || !in.seek((uint32_t)keep * PAGE_SIZE)) {
+      if (in) in.close();
+      if (out) out.close();
+      saveCursor();
+      return;
+    }
+    uint8_t buf[PAGE_SIZE];
+    bool copied = true;
+    for (uint16_t p = keep; p < sealed && copied; p++) {
+      copied = in.read(buf, PAGE_SIZE) == PAGE_SIZE && out.write(buf, PAGE_SIZE) == PAGE_SIZE;
+    }
+    in.close();
+    out.close();
+    if (!copied) {
+      Serial.println("[TRACKLOG] Compaction failed, keeping the old log");
+      LittleFS.remove(TRACKLOG_TMP_FILE);
+      saveCursor();
+      return;
+    }
+
+    cursorPage = 0;
+    cursorRecord = 0;
+    saveCursor();
+    LittleFS.remove(TRACKLOG_FILE);
+    LittleFS.rename(TRACKLOG_TMP_FILE, TRACKLOG_FILE);
+    sealed -= keep;
+    cursorRecord = record;
+    saveCursor();
+  }
+
+  void saveCursor() {
+    File f = LittleFS.open(TRACKLOG_CURSOR_FILE, "w");
+    if (!f) return;
+    uint16_t c[2] = { cursorPage, cursorRecord };
+    f.write((const uint8_t *)c, sizeof(c));
+    f.close();
+  }
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <Arduino.h>
+#include <math.h>
+#include "GpsReader.h"
+
+// Decides which fixes are worth uploading.
+// 1. Dead-band: a fix is only considered when it moved minDistanceM from
+//    the last considered one, turned by minHeadingDeg, or changed speed by
+//    minSpeedKmph. Parked jitter never gets past this.
+// 2. The considered fixes collect in a short window that is simplified
+//    with Douglas-Peucker at toleranceM once full (or before an upload);
+//    the points it keeps go to the outbox.
+// 3. The outbox is uploaded as one JSON array when it's full or its oldest
+//    point is maxBatchAgeMs old. A stationary tracker still sends a
+//    heartbeat fix every heartbeatMs.
+// Every dropped fix lies within max(minDistanceM, toleranceM) of the
+// uploaded track; maxError() reports the worst seen.
+
+struct TrackConfig {
+  float minDistanceM = 10;
+  float minHeadingDeg = 25;
+  float minSpeedKmph = 8;
+  float toleranceM = 10;
+  uint32_t heartbeatMs = 300000;
+  uint32_t maxBatchAgeMs = 60000;
+};
+
+// One point of the /api/gps-data/ JSON array; returns snprintf's length
+inline int formatTrackPoint(char *out, size_t len, const GpsFix &p, const char *deviceId) {
+  return snprintf(out, len,
+                  "{\"device_id\":\"%s\",\"timestamp\":\"%04u-%02u-%02u %02u:%02u:%02u\","
+                  "\"latitude\":%.6f,\"longitude\":%.6f,\"speed\":%.2f,\"altitude\":%.2f}",
+                  deviceId, p.year ? p.year : 2024, p.month, p.day, p.hour, p.minute, p.second,
+                  p.lat, p.lon, p.speedKmph, p.altitudeM);
+}
+
+class TrackReporter {
+public:
+  static const uint8_t WINDOW = 32;
+  static const uint8_t OUTBOX = 48;
+
+  explicit TrackReporter(const TrackConfig &config = TrackConfig()) : config(config) {}
+
+  void add(const GpsFix &fix) {
+    fixesIn++;
+    if (windowCount && !significant(fix)) {
+      float err = distance(window[windowCount - 1], fix);
+      if (err > maxErrorM) maxErrorM = err;
+      if (fix.millisAt - lastOutputAt >= config.heartbeatMs) {
+        flushWindow();
+        emit(fix);
+        window[0] = fix;
+        windowCount = 1;
+      }
+      return;
+    }
+
+    if (!windowCount) {
+      // First fix of the track (or after a reset) goes out as-is
+      emit(fix);
+      window[windowCount++] = fix;
+      return;
+    }
+    window[windowCount++] = fix;
+    if (windowCount == WINDOW) flushWindow();
+  }
+
+  // An upload is worth doing now
+  bool due(uint32_t now) const {
+    uint8_t waiting = outboxCount + (windowCount > 1 ? windowCount - 1 : 0);
+    if (!waiting) return false;
+    if (waiting >= OUTBOX / 2) return true;
+    uint32_t oldest = outboxCount ? outbox[outboxHead].millisAt : window[1].millisAt;
+    return now - oldest >= config.maxBatchAgeMs;
+  }
+
+  // Simplify whatever is in the window and write the outbox as a JSON
+  // array into out. Returns the number of points; release them with
+  // commit() once the server accepted them.
+  uint8_t buildBatch(char *out, size_t outLen, const char *deviceId) {
+    flushWindow();
+    size_t len = 0;
+    batchCount = 0;
+    out[len++] = '[';
+
+    char item[200];
+    while (batchCount < outboxCount) {
+      const GpsFix &p = outbox[(outboxHead + batchCount) % OUTBOX];
+      int n = formatTrackPoint(item, sizeof(item), p, deviceId);
+      // room for the separator, the closing bracket and the NUL
+      if (n < 0 || len + n + 3 > outLen) break;
+      if (batchCount) out[len++] = ',';
+      memcpy(out + len, item, n);
+      len += n;
+      batchCount++;
+    }
+    out[len++] = ']';
+    out[len] = '\0';
+    return batchCount;
+  }
+
+  void commit() {
+    outboxHead = (outboxHead + batchCount) % OUTBOX;
+    outboxCount -= batchCount;
+    pointsSent += batchCount;
+    batchCount = 0;
+  }
+
+  // Hand the oldest queued point to the caller instead of uploading it,
+  // e.g. to park it on flash while offline. Ends any batch in progress.
+  bool takeOldest(GpsFix &out) {
+    batchCount = 0;
+    if (!outboxCount) return false;
+    out = outbox[outboxHead];
+    outboxHead = (outboxHead + 1) % OUTBOX;
+    outboxCount--;
+    return true;
+  }
+
+  uint8_t pending() const { return outboxCount; }
+  uint32_t fixes() const { return fixesIn; }
+  uint32_t sent() const { return pointsSent; }
+  uint32_t dropped() const { return droppedCount; }
+  float maxError() const { return maxErrorM; }
+
+  void printStats(Print &out) const {
+    out.printf("[TRACK] fixes=%lu sent=%lu ratio=%.1f maxerr=%.1fm dropped=%lu\n",
+               (unsigned long)fixesIn, (unsigned long)pointsSent,
+               pointsSent ? (float)fixesIn / pointsSent : 0.0f, maxErrorM, (unsigned long)droppedCount);
+  }
+
+private:
+  TrackConfig config;
+  GpsFix window[WINDOW];  // window[0] was already emitted
+  uint8_t windowCount = 0;
+  GpsFix outbox[OUTBOX];
+  uint8_t outboxHead = 0, outboxCount = 0, batchCount = 0;
+  uint32_t lastOutputAt = 0;
+  uint32_t fixesIn = 0, pointsSent = 0, droppedCount = 0;
+  float maxErrorM = 0;
+
+  // Flat-earth offsets are plenty at window scale
+  static void offset(const GpsFix &from, const GpsFix &to, float &dx, float &dy) {
+    dy = (float)(to.lat - from.lat) * 110574.0f;
+    dx = (float)(to.lon - from.lon) * 111320.0f * cosf((float)from.lat * (float)M_PI / 180.0f);
+  }
+
+  static float distance(const GpsFix &a, const GpsFix &b) {
+    float dx, dy;
+    offset(a, b, dx, dy);
+    return sqrtf(dx * dx + dy * dy);
+  }
+
+  bool significant(const GpsFix &fix) const {
+    const GpsFix &last = window[windowCount - 1];
+    float dx, dy;
+    offset(last, fix, dx, dy);
+    float d = sqrtf(dx * dx + dy * dy);
+    if (d >= config.minDistanceM) return true;
+    if (fabsf(fix.speedKmph - last.speedKmph) >= config.minSpeedKmph) return true;
+    // Turning: compare against the previous leg, ignoring sub-meter wobble
+    if (windowCount < 2 || d < config.minDistanceM / 4) return false;
+    float px, py;
+    offset(window[windowCount - 2], last, px, py);
+    float turn = fabsf(atan2f(dx * py - dy * px, dx * px + dy * py)) * 180.0f / (float)M_PI;
+    return turn >= config.minHeadingDeg;
+  }
+
+  void emit(const GpsFix &fix) {
+    if (outboxCount == OUTBOX) {
+      // Server unreachable for a long time: lose the oldest point
+      outboxHead = (outboxHead + 1) % OUTBOX;
+      outboxCount--;
+      if (batchCount) batchCount--;
+      droppedCount++;
+    }
+    outbox[(outboxHead + outboxCount) % OUTBOX] = fix;
+    outboxCount++;
+    lastOutputAt = fix.millisAt;
+  }
+
+  // Distance from p to the segment a-b, in meters
+  static float segmentDistance(const GpsFix &a, const GpsFix &b, const GpsFix &p) {
+    float bx, by, px, py;
+    offset(a, b, bx, by);
+    offset(a, p, px, py);
+    float len2 = bx * bx + by * by;
+    float t = len2 > 0 ? (px * bx + py * by) / len2 : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    float ex = px - t * bx, ey = py - t * by;
+    return sqrtf(ex * ex + ey * ey);
+  }
+
+  // Douglas-Peucker over window[0..windowCount), iterative; emits every
+  // kept point after window[0] and restarts the window at the last one.
+  void flushWindow() {
+    if (windowCount < 2) return;
+    bool keep[WINDOW] = {};
+    keep[0] = keep[windowCount - 1] = true;
+    uint8_t stack[WINDOW * 2];
+    uint8_t top = 0;
+    stack[top++] = 0;
+    stack[top++] = windowCount - 1;
+
+    while (top) {
+      uint8_t last = stack[--top], first = stack[--top];
+      float worst = 0;
+      uint8_t at = 0;
+      for (uint8_t i = first + 1; i < last; i++) {
+        float d = segmentDistance(window[first], window[last], window[i]);
+        if (d > worst) {
+          worst = d;
+          at = i;
+        }
+      }
+      if (worst > config.toleranceM) {
+        keep[at] = true;
+        stack[top++] = first;
+        stack[top++] = at;
+        stack[top++] = at;
+        stack[top++] = last;
+      } else if (worst > maxErrorM) {
+        maxErrorM = worst;
+      }
+    }
+
+    for (uint8_t i = 1; i < windowCount; i++) {
+      if (keep[i]) emit(window[i]);
+    }
+    window[0] = window[windowCount - 1];
+    windowCount = 1;
+  }
+};
@@ -3,129 +3,169 @@
 #include <HTTPClient.h>
 #include <TinyGPSPlus.h>
 #include <HardwareSerial.h>
+#include <DjangoLink.h>
+#ifdef USE_MQTT
+#include <MqttLink.h>
+#endif
+#include <LittleFS.h>
+#include <WifiLink.h>
+#include "GpsReader.h"
+#include "Geofence.h"
+#include "TrackReporter.h"
+#include "TrackLog.h"
 
 // WiFi credentials
 const char* ssid = "WWW.et";
 const char* password = "123456788";
+WifiLink wifi(ssid, password);  // reconnects in the background (see WifiLink.h)
 
 // Django API endpoint
-const char* apiEndpoint = "http://192.168.137.204:8000/api/gps-data/";
-
-// GPS setup
-TinyGPSPlus gps;
+const char* apiHost = "192.168.137.204";
+const uint16_t apiPort = 8000;
+const char* apiPath = "/api/gps-data/";
+const char* deviceId = "esp32_001";
+#ifdef USE_MQTT
+// -DUSE_MQTT: batches go out on one broker session and are only released
+// once the server has replied (see MqttLink.h)
+const uint16_t mqttPort = 1883;
+MqttLink apiLink(apiHost, mqttPort, deviceId);
+#else
+DjangoLink apiLink(apiHost, apiPort);  // keep-alive, reused every fix
+#endif
+Transport &api = apiLink;
+
+// GPS setup, parsed on its own task (see GpsReader.h)
 HardwareSerial gpsSerial(2);  // UART2 (RX=16, TX=17)
 #define INDICATOR_LED 13
+GpsReader gpsReader(gpsSerial, INDICATOR_LED);
 
-// Geofence config
+// Geofence zones come from /zones.txt on LittleFS (format in Geofence.h);
+// without it the single default circle below is used
+Geofence geofence;
+const char* zonesPath = "/zones.txt";
 float fenceLat = -15.391967;
 float fenceLon = 28.330280;
 float radiusMeters = 1000000.0;
 
-unsigned long lastSendTime = 0;
+// Fixes are thinned and batched before upload (see TrackReporter.h)
+TrackReporter reporter;
+unsigned long lastUploadAttempt = 0;
+bool lastUploadFailed = false;
+const unsigned long UPLOAD_RETRY_INTERVAL = 10000;  // after a failed upload
+
+// Points that can't go out right now wait on flash (see TrackLog.h)
+TrackLog trackLog;
+
+unsigned long lastStatsTime = 0;
+const unsigned long GPS_STATS_INTERVAL = 60000;
+uint32_t lastSeq = 0;
 
-void sendToAPI(float lat, float lon, float speed, float alt, int hour, int minute, int second);
+bool uploadTrack();
+void parkTrack();
+void loadZones();
+void onGeofenceEvent(const GeofenceEvent &ev);
 void setup() {
   Serial.begin(115200);
-  gpsSerial.begin(9600, SERIAL_8N1, 16, 17);
-  pinMode(INDICATOR_LED, OUTPUT);
+  gpsReader.begin(9600, 16, 17);
+  if (!LittleFS.begin(true)) Serial.println("❌ LittleFS mount failed");
+  loadZones();
+  trackLog.begin();
   
   Serial.println("\n🔍 Starting GPS Tracker...");
-  
-  // Connect to WiFi
-  WiFi.begin(ssid, password);
-  Serial.print("Connecting to WiFi");
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
-  Serial.println("\n✅ Wi-Fi Connected");
+
+  // Tracking starts right away; points wait on flash until WiFi is up
+  wifi.begin();
 }
 
 void loop() {
-  // Read and process GPS data
-  while (gpsSerial.available()) {
-    char c = gpsSerial.read();
-    
-    // Debug: Echo raw GPS data (comment out if too verbose)
-    // Serial.write(c); 
-    
-    if (gps.encode(c)) {
-      digitalWrite(INDICATOR_LED, HIGH);
-      delay(50);
-      digitalWrite(INDICATOR_LED, LOW);
-    }
+  GpsFix fix;
+
+  // Every new position goes through the geofence and the reporter
+  if (gpsReader.latest(fix) && fix.seq != lastSeq) {
+    lastSeq = fix.seq;
+    geofence.update(fix.lat, fix.lon, fix.millisAt, onGeofenceEvent);
+    reporter.add(fix);
   }
 
-  // Process and send data every 5 seconds
-  if (gps.location.isUpdated() && millis() - lastSendTime > 5000) {
-    lastSendTime = millis();
-
-    // Get GPS data
-    float lat = gps.location.lat();
-    float lon = gps.location.lng();
-    float speed = gps.speed.kmph();
-    float alt = gps.altitude.meters();
-    int hour = gps.time.hour();
-    int minute = gps.time.minute();
-    int second = gps.time.second();
-
-    // Print debug info
-    Serial.println("\n📍 GPS Fix:");
-    Serial.print("Chars processed: "); Serial.println(gps.charsProcessed());
-    Serial.print("Satellites: "); Serial.println(gps.satellites.value());
-    Serial.print("Latitude: "); Serial.println(lat, 6);
-    Serial.print("Longitude: "); Serial.println(lon, 6);
-    Serial.print("Speed: "); Serial.print(speed); Serial.println(" km/h");
-    Serial.print("Altitude: "); Serial.print(alt); Serial.println(" m");
-    Serial.print("Time: ");
-    Serial.printf("%02d:%02d:%02d\n", hour, minute, second);
-
-    // Geofence check
-    float distance = TinyGPSPlus::distanceBetween(lat, lon, fenceLat, fenceLon);
-    Serial.print("Distance from center: ");
-    Serial.print(distance); Serial.println(" meters");
-    Serial.println(distance > radiusMeters ? "⚠️ OUTSIDE GEOFENCE!" : "✅ Inside geofence");
-
-    // Send to Django server
-    sendToAPI(lat, lon, speed, alt, hour, minute, second);
+  // Offline: keep the points on flash until WifiLink is back
+  wifi.loop();
+  bool online = wifi.connected();
+  if (online) api.poll();
+  if (!online || lastUploadFailed) parkTrack();
+  bool retryWait = millis() - lastUploadAttempt < UPLOAD_RETRY_INTERVAL;
+
+  if (online && (trackLog.pending() || reporter.due(millis())) && (!lastUploadFailed || !retryWait)) {
+    // The GPS task keeps parsing while this blocks on HTTP
+    lastUploadAttempt = millis();
+    lastUploadFailed = !uploadTrack();
+  }
+
+  if (millis() - lastStatsTime > GPS_STATS_INTERVAL) {
+    lastStatsTime = millis();
+    gpsReader.printStats(Serial);
+    reporter.printStats(Serial);
+    trackLog.printStats(Serial);
+    wifi.printStats(Serial);
   }
 }
 
-void sendToAPI(float lat, float lon, float speed, float alt, int hour, int minute, int second) {
-  if (WiFi.status() == WL_CONNECTED) {
-    WiFiClient client;
-    HTTPClient http;
-
-    http.begin(client, apiEndpoint);
-    http.addHeader("Content-Type", "application/json");
-
-    // Create JSON payload
-    String timestamp = "2024-" + String(gps.date.month()) + "-" + String(gps.date.day()) + 
-                      " " + String(hour) + ":" + String(minute) + ":" + String(second);
-    
-    String json = "{";
-    json += "\"device_id\":\"esp32_001\",";
-    json += "\"timestamp\":\"" + timestamp + "\",";
-    json += "\"latitude\":" + String(lat, 6) + ",";
-    json += "\"longitude\":" + String(lon, 6) + ",";
-    json += "\"speed\":" + String(speed, 2) + ",";
-    json += "\"altitude\":" + String(alt, 2);
-    json += "}";
-
-    Serial.println("📤 Sending to server:");
-    Serial.println(json);
-
-    int httpCode = http.POST(json);
-    String response = http.getString();
-
-    Serial.print("HTTP status: ");
-    Serial.println(httpCode);
+// Sends the oldest chunk: flash backlog first, then the live batch.
+// Returns false if the server didn't take it.
+bool uploadTrack() {
+  static char json[4096];
+  bool fromLog = trackLog.pending() > 0;
+  uint16_t points = fromLog ? trackLog.buildBatch(json, sizeof(json), deviceId)
+                            : reporter.buildBatch(json, sizeof(json), deviceId);
+  if (!points) {
+    if (fromLog) trackLog.commit();  // only unreadable pages were left
+    return true;
+  }
+  Serial.printf("📤 Sending %u track points%s\n", points, fromLog ? " from flash" : "");
+
+  char response[128];
+  int httpCode = api.post(apiPath, json, response, sizeof(response));
+  Serial.print("HTTP status: ");
+  Serial.println(httpCode);
+  if (httpCode < 200 || httpCode >= 300) {
     Serial.print("Response: ");
     Serial.println(response);
+    return false;
+  }
+  if (fromLog) trackLog.commit();
+  else reporter.commit();
+  api.printStats(Serial);
+  return true;
+}
+
+// Move everything the reporter has queued to the flash log
+void parkTrack() {
+  GpsFix point;
+  while (reporter.takeOldest(point)) {
+    if (!trackLog.append(point)) Serial.println("[TRACKLOG] Append failed, point lost");
+  }
+}
+
+void loadZones() {
+  if (geofence.load(LittleFS, zonesPath)) {
+    Serial.printf("Loaded %u geofence zones\n", geofence.zones());
+    return;
+  }
+  Serial.println("No zone file, using the default geofence");
+  geofence.reserve(1, 0);
+  geofence.addCircle("default", fenceLat, fenceLon, (uint32_t)radiusMeters);
+  geofence.build();
+}
 
-    http.end();
-  } else {
-    Serial.println("❌ Wi-Fi disconnected - attempting to reconnect...");
-    WiFi.reconnect();
+void onGeofenceEvent(const GeofenceEvent &ev) {
+  switch (ev.type) {
+    case GEOFENCE_ENTER:
+      Serial.printf("✅ Entered zone %s\n", ev.name);
+      break;
+    case GEOFENCE_EXIT:
+      Serial.printf("⚠️ Left zone %s after %lu s\n", ev.name, (unsigned long)(ev.insideMs / 1000));
+      break;
+    case GEOFENCE_DWELL:
+      Serial.printf("Dwelling in zone %s for %lu s\n", ev.name, (unsigned long)(ev.insideMs / 1000));
+      break;
   }
 }
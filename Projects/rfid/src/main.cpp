@@ -1,35 +1,73 @@
 #include <SPI.h>
 #include <MFRC522.h>
+#include <CardReader.h>
+#include <ReaderManager.h>
 
-#define SS_PIN 5
-#define RST_PIN 22
+// All readers share SCK=18, MISO=19, MOSI=23; each has its own chip
+// select, reset and IRQ line. IRQ pins are input-only GPIOs, the RC522
+// drives them push-pull.
+struct ReaderPins {
+  const char *name;
+  uint8_t ss;
+  uint8_t rst;
+  int8_t irq;
+};
 
-MFRC522 rfid(SS_PIN, RST_PIN);
+const ReaderPins READER_PINS[] = {
+  {"entry", 5, 22, 34},
+  {"exit", 17, 16, 35},
+  // {"third", 4, 21, 36},  // also add it to rc522[] and cardReaders[] below
+};
+const uint8_t READER_COUNT = sizeof(READER_PINS) / sizeof(READER_PINS[0]);
+
+MFRC522 rc522[READER_COUNT] = {
+  MFRC522(READER_PINS[0].ss, READER_PINS[0].rst),
+  MFRC522(READER_PINS[1].ss, READER_PINS[1].rst),
+};
+CardReader cardReaders[READER_COUNT] = {
+  CardReader(rc522[0], READER_PINS[0].irq),
+  CardReader(rc522[1], READER_PINS[1].irq),
+};
+ReaderManager readers;
+
+const unsigned long statsInterval = 60000;
+unsigned long lastStats = 0;
 
 void setup() {
   Serial.begin(115200);
-  SPI.begin(18, 19, 23, SS_PIN);  // SCK, MISO, MOSI, SS
-  rfid.PCD_Init();
-  Serial.println("📡 RFID Reader Ready");
-  Serial.print("RC522 Version: 0x");
-  Serial.println(rfid.PCD_ReadRegister(rfid.VersionReg), HEX);
+
+  // Deselect every reader before talking to any of them
+  for (uint8_t i = 0; i < READER_COUNT; i++) {
+    pinMode(READER_PINS[i].ss, OUTPUT);
+    digitalWrite(READER_PINS[i].ss, HIGH);
+  }
+  SPI.begin(18, 19, 23);  // SCK, MISO, MOSI
+
+  for (uint8_t i = 0; i < READER_COUNT; i++) {
+    rc522[i].PCD_Init();
+    readers.add(cardReaders[i], READER_PINS[i].name);
+    Serial.printf("📡 RFID reader %u (%s) RC522 Version: 0x%02X\n", i, READER_PINS[i].name,
+                  rc522[i].PCD_ReadRegister(rc522[i].VersionReg));
+  }
+  readers.begin();
 }
 
 void loop() {
-  // Wait for a new card
-  if (!rfid.PICC_IsNewCardPresent() || !rfid.PICC_ReadCardSerial()) {
-    delay(100);
-    return;
-  }
+  // Staggered probes across the readers; one event per tap
+  readers.poll();
 
-  Serial.print("🎫 Card UID: ");
-  for (byte i = 0; i < rfid.uid.size; i++) {
-    Serial.print(rfid.uid.uidByte[i] < 0x10 ? " 0" : " ");
-    Serial.print(rfid.uid.uidByte[i], HEX);
+  ReaderEvent event;
+  while (readers.read(event)) {
+    Serial.printf("🎫 Card UID (%s):", readers.name(event.reader));
+    for (byte i = 0; i < event.card.size; i++) {
+      Serial.print(event.card.uid[i] < 0x10 ? " 0" : " ");
+      Serial.print(event.card.uid[i], HEX);
+    }
+    Serial.println();
   }
-  Serial.println();
 
-  rfid.PICC_HaltA();
-  rfid.PCD_StopCrypto1();
-  delay(1000); // Short delay to avoid multiple reads
+  if (millis() - lastStats >= statsInterval) {
+    lastStats = millis();
+    readers.printStats(Serial);
+  }
 }
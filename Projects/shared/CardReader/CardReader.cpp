@@ -0,0 +1,115 @@
+#include "CardReader.h"
+
+void CardEvent::toHex(char *out, size_t len) const {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  size_t n = 0;
+  for (uint8_t i = 0; i < size && n + 2 < len; i++) {
+    out[n++] = HEX_DIGITS[uid[i] >> 4];
+    out[n++] = HEX_DIGITS[uid[i] & 0x0F];
+  }
+  if (len) out[n] = '\0';
+}
+
+void IRAM_ATTR CardReader::onIrq(void *arg) {
+  static_cast<CardReader *>(arg)->irqPending = true;
+}
+
+void CardReader::begin() {
+  if (irqPin >= 0) {
+    pinMode(irqPin, INPUT);
+    // IRQ pin push-pull (works without a pull-up), active low, and only
+    // "receiver got a frame" routed to it
+    rc522.PCD_WriteRegister(MFRC522::DivIEnReg, 0x80);
+    rc522.PCD_WriteRegister(MFRC522::ComIEnReg, 0xA0);
+    irqPending = false;
+    attachInterruptArg(digitalPinToInterrupt(irqPin), onIrq, this, FALLING);
+  }
+  running = true;
+  lastProbe = millis() - PROBE_MS;  // probe on the first poll
+}
+
+void CardReader::end() {
+  if (irqPin >= 0 && running) {
+    detachInterrupt(digitalPinToInterrupt(irqPin));
+    rc522.PCD_WriteRegister(MFRC522::ComIEnReg, 0x00);
+  }
+  running = false;
+}
+
+void CardReader::poll() {
+  service();
+  if (millis() - lastProbe >= PROBE_MS) scan();
+}
+
+void CardReader::service() {
+  if (!running || irqPin < 0 || !irqPending) return;
+  counters.interrupts++;
+  readCard();
+}
+
+void CardReader::scan() {
+  if (!running) return;
+  lastProbe = millis();
+  counters.probes++;
+
+  if (irqPin < 0) {
+    if (rc522.PICC_IsNewCardPresent()) readCard();
+    return;
+  }
+
+  // Start a REQA and leave the RC522 listening for the answer
+  rc522.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);      // clear all flags
+  rc522.PCD_WriteRegister(MFRC522::FIFOLevelReg, 0x80);   // flush the FIFO
+  rc522.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+  rc522.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  rc522.PCD_WriteRegister(MFRC522::BitFramingReg, 0x87);  // StartSend, 7-bit short frame
+}
+
+void CardReader::readCard() {
+  if (rc522.PICC_ReadCardSerial()) {
+    CardEvent event;
+    event.size = rc522.uid.size < CardEvent::MAX_UID ? rc522.uid.size : CardEvent::MAX_UID;
+    memcpy(event.uid, rc522.uid.uidByte, event.size);
+    event.at = millis();
+    rc522.PICC_HaltA();
+    counters.reads++;
+
+    bool repeat = last.size == event.size && memcmp(last.uid, event.uid, event.size) == 0 &&
+                  event.at - last.at < DEDUPE_MS;
+    last = event;  // a card kept bouncing in and out stays suppressed
+    if (repeat) counters.duplicates++;
+    else push(event);
+  } else {
+    counters.readErrors++;
+  }
+
+  if (irqPin >= 0) {
+    // The select and halt exchanges raised the receive interrupt too
+    rc522.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);
+    irqPending = false;
+  }
+}
+
+void CardReader::push(const CardEvent &event) {
+  if (queueCount == QUEUE) {
+    counters.dropped++;
+    return;
+  }
+  queue[(queueHead + queueCount) % QUEUE] = event;
+  queueCount++;
+}
+
+bool CardReader::read(CardEvent &out) {
+  if (!queueCount) return false;
+  out = queue[queueHead];
+  queueHead = (queueHead + 1) % QUEUE;
+  queueCount--;
+  return true;
+}
+
+void CardReader::printStats(Print &out) const {
+  out.printf("[RFID] probes=%lu irq=%lu reads=%lu errors=%lu dup=%lu dropped=%lu\n",
+             (unsigned long)counters.probes, (unsigned long)counters.interrupts,
+             (unsigned long)counters.reads, (unsigned long)counters.readErrors,
+             (unsigned long)counters.duplicates, (unsigned long)counters.dropped);
+}
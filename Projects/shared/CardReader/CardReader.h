@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+// Card detection for an RC522, turned into a queue of tap events.
+//
+// With an IRQ pin the reader is armed instead of polled: every PROBE_MS
+// poll() clears the interrupt flags and the FIFO and starts one REQA
+// transmission (five register writes), with only the receive interrupt
+// routed to the pin. When a card answers, the IRQ line drops and the ISR sets a flag;
+// the next poll() selects the card, reads its UID and halts it. A halted
+// card ignores REQA until it leaves the field, so a card held on the
+// reader stays silent instead of being read over and over. With no card
+// present no register is ever read back.
+// The RC522 has no autonomous card detection, so the probe still has to
+// be started from here; without an IRQ pin poll() falls back to the
+// library's PICC_IsNewCardPresent() on the same schedule.
+//
+// A UID seen again within DEDUPE_MS (a card lifted and put back, or
+// bouncing at the edge of the field) is dropped, so one tap is one event.
+
+struct CardEvent {
+  static const uint8_t MAX_UID = 10;
+
+  uint8_t uid[MAX_UID];
+  uint8_t size;
+  uint32_t at;  // millis() when the card was read
+
+  // Lowercase hex without separators, e.g. "04a1b2c3"
+  void toHex(char *out, size_t len) const;
+};
+
+struct CardReaderStats {
+  uint32_t probes;      // REQA sent (or presence checks in polling mode)
+  uint32_t interrupts;
+  uint32_t reads;       // UIDs read
+  uint32_t readErrors;  // woken up but the select failed
+  uint32_t duplicates;  // suppressed by the dedupe window
+  uint32_t dropped;     // queue full
+};
+
+class CardReader {
+public:
+  static const uint8_t QUEUE = 4;
+  static const uint16_t PROBE_MS = 100;
+  static const uint16_t DEDUPE_MS = 3000;
+
+  CardReader(MFRC522 &rc522, int8_t irqPin = -1) : rc522(rc522), irqPin(irqPin) {}
+
+  // Call after rc522.PCD_Init(), and again after every re-init
+  void begin();
+
+  // Stop probing and release the IRQ pin, e.g. before PCD_SoftPowerDown()
+  void end();
+
+  // Run the probe schedule and read any card that answered. Call from
+  // every loop(); does nothing on the bus between probes.
+  void poll();
+
+  // The two halves of poll(), for a scheduler sharing the bus between
+  // several readers: service() reads a card that answered the last probe
+  // (IRQ mode only), scan() probes now regardless of PROBE_MS.
+  void service();
+  void scan();
+
+  bool available() const { return queueCount != 0; }
+  bool read(CardEvent &out);
+
+  const CardReaderStats &stats() const { return counters; }
+  void printStats(Print &out) const;
+
+private:
+  MFRC522 &rc522;
+  int8_t irqPin;
+  bool running = false;
+  volatile bool irqPending = false;
+  uint32_t lastProbe = 0;
+
+  CardEvent queue[QUEUE];
+  uint8_t queueHead = 0, queueCount = 0;
+
+  CardEvent last = {};  // most recent UID, for the dedupe window
+  CardReaderStats counters = {};
+
+  static void IRAM_ATTR onIrq(void *arg);
+  void readCard();
+  void push(const CardEvent &event);
+};
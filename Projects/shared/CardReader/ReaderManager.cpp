@@ -0,0 +1,65 @@
+#include "ReaderManager.h"
+
+bool ReaderManager::add(CardReader &reader, const char *name) {
+  if (readerCount == MAX_READERS) return false;
+  Slot &s = slots[readerCount++];
+  s.reader = &reader;
+  s.name = name;
+  s.lastScanAt = 0;
+  s.maxGapMs = 0;
+  s.probesAtMark = reader.stats().probes;
+  return true;
+}
+
+void ReaderManager::begin() {
+  for (uint8_t i = 0; i < readerCount; i++) {
+    slots[i].reader->begin();
+    slots[i].lastScanAt = millis();
+  }
+  nextScan = 0;
+  lastScan = millis() - CardReader::PROBE_MS;  // first scan on the first poll
+  statsSince = millis();
+}
+
+void ReaderManager::poll() {
+  if (!readerCount) return;
+  for (uint8_t i = 0; i < readerCount; i++) slots[i].reader->service();
+
+  if (millis() - lastScan < CardReader::PROBE_MS / readerCount) return;
+  lastScan = millis();
+
+  Slot &s = slots[nextScan];
+  uint32_t gap = lastScan - s.lastScanAt;
+  if (gap > s.maxGapMs) s.maxGapMs = gap > 0xFFFF ? 0xFFFF : gap;
+  s.lastScanAt = lastScan;
+  s.reader->scan();
+  nextScan = (nextScan + 1) % readerCount;
+}
+
+bool ReaderManager::read(ReaderEvent &out) {
+  for (uint8_t n = 0; n < readerCount; n++) {
+    uint8_t i = (nextRead + n) % readerCount;
+    if (slots[i].reader->read(out.card)) {
+      out.reader = i;
+      nextRead = (i + 1) % readerCount;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ReaderManager::printStats(Print &out) {
+  uint32_t now = millis();
+  uint32_t elapsed = now - statsSince;
+  for (uint8_t i = 0; i < readerCount; i++) {
+    Slot &s = slots[i];
+    const CardReaderStats &c = s.reader->stats();
+    float rate = elapsed ? (c.probes - s.probesAtMark) * 1000.0f / elapsed : 0;
+    out.printf("[RFID] %u:%s scans/s=%.1f maxgap=%ums reads=%lu dup=%lu errors=%lu\n", i, s.name, rate,
+               s.maxGapMs, (unsigned long)c.reads, (unsigned long)c.duplicates,
+               (unsigned long)c.readErrors);
+    s.probesAtMark = c.probes;
+    s.maxGapMs = 0;
+  }
+  statsSince = now;
+}
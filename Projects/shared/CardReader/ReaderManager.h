@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include "CardReader.h"
+
+// Several RC522s on one SPI bus (shared SCK/MISO/MOSI, one chip select
+// each), scanned in turn.
+//
+// Every reader is still probed once per CardReader::PROBE_MS, but the
+// probes are staggered: with N readers one scan goes out every
+// PROBE_MS / N, so the bus carries one transaction at a time and no two
+// RF fields start a REQA together. A reader never waits longer than
+// PROBE_MS plus one other reader's scan; the longest gap actually seen is
+// kept per reader. Readers in polling mode block for the RC522's receive
+// timeout on every scan, so with several of them give each an IRQ pin.
+//
+// Events come back tagged with the index the reader was added under.
+
+struct ReaderEvent {
+  uint8_t reader;
+  CardEvent card;
+};
+
+class ReaderManager {
+public:
+  static const uint8_t MAX_READERS = 4;
+
+  // Register a reader whose RC522 is already PCD_Init()ed; false if full
+  bool add(CardReader &reader, const char *name);
+
+  // begin() every reader and start the rotation
+  void begin();
+
+  // Read cards that answered, then scan the next reader if its slot came.
+  // Call from every loop().
+  void poll();
+
+  // Next tap from any reader, taken round-robin so a busy reader can't
+  // starve the others
+  bool read(ReaderEvent &out);
+
+  uint8_t count() const { return readerCount; }
+  const char *name(uint8_t reader) const { return slots[reader].name; }
+  uint16_t maxGap(uint8_t reader) const { return slots[reader].maxGapMs; }
+
+  // Scans per second for each reader since the last call, plus the
+  // longest gap and the reader's own counters; restarts the measurement
+  void printStats(Print &out);
+
+private:
+  struct Slot {
+    CardReader *reader;
+    const char *name;
+    uint32_t lastScanAt;
+    uint16_t maxGapMs;
+    uint32_t probesAtMark;  // CardReader probes when the stats window opened
+  };
+
+  Slot slots[MAX_READERS];
+  uint8_t readerCount = 0;
+  uint8_t nextScan = 0;
+  uint8_t nextRead = 0;
+  uint32_t lastScan = 0;
+  uint32_t statsSince = 0;
+};
@@ -0,0 +1,71 @@
+#include "DjangoLink.h"
+
+DjangoLink::DjangoLink(const char *host, uint16_t port) : host(host), port(port) {
+  http.setReuse(true);
+}
+
+int DjangoLink::send(const char *path, const char *body, uint32_t timeoutMs) {
+  http.setConnectTimeout(timeoutMs);
+  http.setTimeout(timeoutMs > 65535 ? 65535 : (uint16_t)timeoutMs);
+  http.begin(client, host, port, path);
+  http.addHeader("Content-Type", "application/json");
+  return http.POST((uint8_t *)body, strlen(body));
+}
+
+int DjangoLink::post(const char *path, const char *body, char *response, size_t responseLen,
+                     uint32_t timeoutMs) {
+  uint32_t start = micros();
+  counters.requests++;
+
+  bool reusing = client.connected();
+  if (reusing) counters.reused++;
+  else counters.connects++;
+
+  int code = send(path, body, timeoutMs);
+
+  // Server dropped the idle socket under us while the request was being
+  // written, so it never arrived whole and is safe to resend once on a new
+  // connection. A connection lost after the body went out (CONNECTION_LOST
+  // or NOT_CONNECTED from reading the response) or a read timeout is not
+  // retried: the server may already have stored the batch or logged the
+  // access, and these POSTs aren't idempotent. The caller keeps its data
+  // and sends it again later.
+  if (reusing && (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED)) {
+    http.end();
+    client.stop();
+    counters.staleRetries++;
+    counters.connects++;
+    code = send(path, body, timeoutMs);
+  }
+
+  if (code > 0) {
+    // Always drain the body, a half-read response would poison the socket
+    String res = http.getString();
+    if (response && responseLen) strlcpy(response, res.c_str(), responseLen);
+  } else {
+    counters.failures++;
+    if (response && responseLen) response[0] = '\0';
+  }
+  http.end();  // keeps the socket open unless the server asked to close
+
+  uint32_t elapsed = micros() - start;
+  counters.lastLatencyUs = elapsed;
+  counters.totalLatencyUs += elapsed;
+  if (elapsed > counters.maxLatencyUs) counters.maxLatencyUs = elapsed;
+  return code;
+}
+
+void DjangoLink::close() {
+  http.end();
+  client.stop();
+}
+
+void DjangoLink::printStats(Print &out) const {
+  out.printf("[HTTP] requests=%lu failures=%lu reused=%lu connects=%lu stale=%lu "
+             "last=%lums avg=%lums max=%lums\n",
+             (unsigned long)counters.requests, (unsigned long)counters.failures,
+             (unsigned long)counters.reused, (unsigned long)counters.connects,
+             (unsigned long)counters.staleRetries, (unsigned long)(counters.lastLatencyUs / 1000),
+             (unsigned long)(counters.requests ? counters.totalLatencyUs / counters.requests / 1000 : 0),
+             (unsigned long)(counters.maxLatencyUs / 1000));
+}
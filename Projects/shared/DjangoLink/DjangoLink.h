@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "Transport.h"
+
+// Persistent HTTP/1.1 keep-alive connection to the Django backend.
+// One socket is kept open and reused across requests; when the server has
+// closed it (idle timeout, restart) the next request reconnects, and a
+// request whose write fails on a stale socket is retried once on a fresh
+// one. Failures after the request was written are returned, never resent.
+// Not thread safe: use one DjangoLink per task.
+
+struct DjangoLinkStats {
+  uint32_t requests;      // requests attempted
+  uint32_t failures;      // requests that ended with a negative code
+  uint32_t reused;        // requests sent on an already-open socket
+  uint32_t connects;      // new TCP connections opened
+  uint32_t staleRetries;  // reused socket turned out dead while writing, retried
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+  uint64_t totalLatencyUs;
+};
+
+class DjangoLink : public Transport {
+public:
+  DjangoLink(const char *host, uint16_t port);
+
+  // POST a JSON body to path. The response body is copied into response
+  // (truncated, NUL terminated) when a buffer is given. Returns the HTTP
+  // status, or a negative HTTPC_ERROR_* code.
+  int post(const char *path, const char *body, char *response = nullptr, size_t responseLen = 0,
+           uint32_t timeoutMs = 5000) override;
+
+  // Close the socket, e.g. before WiFi goes down on purpose
+  void close() override;
+
+  const DjangoLinkStats &stats() const { return counters; }
+  void printStats(Print &out) const override;
+
+private:
+  const char *host;
+  uint16_t port;
+  WiFiClient client;
+  HTTPClient http;
+  DjangoLinkStats counters = {};
+
+  int send(const char *path, const char *body, uint32_t timeoutMs);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Request/response path to the backend, whatever carries it.
+// Paths are the Django API paths ("/api/check-auth/"); a transport that
+// isn't HTTP maps them onto its own addressing. Implementations are not
+// thread safe: poll() and post() must come from the same task.
+
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  // POST a JSON body to path. The response body is copied into response
+  // (truncated, NUL terminated) when a buffer is given. Returns an HTTP
+  // style status, or a negative error code.
+  virtual int post(const char *path, const char *body, char *response = nullptr, size_t responseLen = 0,
+                   uint32_t timeoutMs = 5000) = 0;
+
+  // Keep a persistent session alive and take in pushed messages. Call
+  // regularly from the task that posts; HTTP has nothing to do here.
+  virtual void poll() {}
+
+  // Drop the connection, e.g. before WiFi goes down on purpose
+  virtual void close() = 0;
+
+  virtual void printStats(Print &out) const = 0;
+};
@@ -0,0 +1,63 @@
+#include "LcdShadow.h"
+
+void LcdShadow::begin() {
+  lcd.clear();
+  writes++;
+  memset(front, ' ', sizeof(front));
+  memset(back, ' ', sizeof(back));
+  col = row = 0;
+  lcdCol = lcdRow = 0;
+}
+
+void LcdShadow::clear() {
+  memset(back, ' ', sizeof(back));
+  col = row = 0;
+}
+
+void LcdShadow::setCursor(uint8_t c, uint8_t r) {
+  col = c;
+  row = r < ROWS ? r : ROWS - 1;
+}
+
+void LcdShadow::clearToEnd() {
+  if (col < COLS) memset(&back[row][col], ' ', COLS - col);
+  col = COLS;
+}
+
+size_t LcdShadow::write(uint8_t c) {
+  // Text past the last column is dropped rather than wrapped
+  if (c == '\n' || c == '\r') return 1;
+  if (col < COLS) back[row][col] = c;
+  col++;
+  return 1;
+}
+
+bool LcdShadow::render(uint16_t budget) {
+  for (uint8_t r = 0; r < ROWS; r++) {
+    for (uint8_t c = 0; c < COLS; c++) {
+      if (back[r][c] == front[r][c]) continue;
+      if (lcdRow != r || lcdCol != c) {
+        if (budget-- == 0) return false;
+        lcd.setCursor(c, r);
+        writes++;
+      }
+      if (budget-- == 0) {
+        lcdCol = c;
+        lcdRow = r;
+        return false;
+      }
+      lcd.write((uint8_t)back[r][c]);
+      writes++;
+      front[r][c] = back[r][c];
+      // The address counter runs on past the line into DDRAM that isn't
+      // shown, so the next line always needs a cursor move
+      lcdRow = r;
+      lcdCol = c + 1 < COLS ? c + 1 : UNKNOWN;
+    }
+  }
+  return true;
+}
+
+bool LcdShadow::dirty() const {
+  return memcmp(front, back, sizeof(front)) != 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+
+// Shadow framebuffer for a 16x2 HD44780.
+// Drawing (print, setCursor, clear) only touches RAM. render() compares the
+// drawn screen with what the LCD is known to show and sends just the cells
+// that differ, moving the cursor only when the next changed cell isn't the
+// one the controller's auto-increment already points at. Redrawing an
+// unchanged screen costs nothing, and clear() never reaches the bus, so
+// there's no 2 ms blank and no flicker.
+//
+// render() takes a budget of bus operations, so a screen change can be
+// spread over several loop() passes.
+
+class LcdShadow : public Print {
+public:
+  static const uint8_t COLS = 16;
+  static const uint8_t ROWS = 2;
+
+  explicit LcdShadow(LiquidCrystal &lcd) : lcd(lcd) {}
+
+  // Call after lcd.begin(); blanks the display once
+  void begin();
+
+  // Blank the drawing and home the cursor (RAM only)
+  void clear();
+  void setCursor(uint8_t col, uint8_t row);
+
+  // Overwrite the rest of the current line with spaces
+  void clearToEnd();
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Send up to budget bus operations (one per changed character or
+  // cursor move). Returns true once the LCD matches the drawing.
+  bool render(uint16_t budget = 0xFFFF);
+
+  bool dirty() const;
+  uint32_t busWrites() const { return writes; }
+
+private:
+  static const uint8_t UNKNOWN = 0xFF;
+
+  LiquidCrystal &lcd;
+  char back[ROWS][COLS];    // what the firmware drew
+  char front[ROWS][COLS];   // what the LCD shows
+  uint8_t col = 0, row = 0;
+  uint8_t lcdCol = UNKNOWN, lcdRow = UNKNOWN;  // controller's address counter
+  uint32_t writes = 0;
+};
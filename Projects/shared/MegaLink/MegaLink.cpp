@@ -0,0 +1,239 @@
+#include "MegaLink.h"
+
+uint16_t MegaLink::crc16(const uint8_t *data, uint8_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Standard COBS; out needs len + 1 bytes. Returns the encoded length.
+uint8_t MegaLink::cobsEncode(const uint8_t *in, uint8_t len, uint8_t *out) {
+  uint8_t codeAt = 0;
+  uint8_t code = 1;
+  uint8_t o = 1;
+  for (uint8_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[codeAt] = code;
+      codeAt = o++;
+      code = 1;
+    } else {
+      out[o++] = in[i];
+      if (++code == 0xFF) {
+        out[codeAt] = code;
+        codeAt = o++;
+        code = 1;
+      }
+    }
+  }
+  out[codeAt] = code;
+  return o;
+}
+
+// Returns the decoded length, or 0 if the input isn't valid COBS
+uint8_t MegaLink::cobsDecode(const uint8_t *in, uint8_t len, uint8_t *out) {
+  uint8_t i = 0;
+  uint8_t o = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) return 0;
+    for (uint8_t j = 1; j < code; j++) out[o++] = in[i++];
+    if (code != 0xFF && i < len) out[o++] = 0;
+  }
+  return o;
+}
+
+void MegaLink::begin(MegaLinkHandler h, uint32_t fast) {
+  handler = h;
+  fastBaud = fast;
+  currentBaud = BASE_BAUD;
+  // Start somewhere arbitrary; the peer's dedupe window also expires
+  // while we reboot, so a reset never has our first frame swallowed
+  reliableSeq = (uint8_t)micros();
+  lastRxMs = millis();
+  if (fastBaud) sendHello();
+}
+
+uint8_t MegaLink::frame(uint8_t type, uint8_t seq, const void *payload, uint8_t len, uint8_t *wire) {
+  uint8_t raw[RAW_MAX];
+  raw[0] = type;
+  raw[1] = seq;
+  memcpy(raw + 2, payload, len);
+  uint16_t crc = crc16(raw, len + 2);
+  raw[len + 2] = crc & 0xFF;
+  raw[len + 3] = crc >> 8;
+  uint8_t n = cobsEncode(raw, len + 4, wire);
+  wire[n++] = 0;
+  return n;
+}
+
+bool MegaLink::send(uint8_t type, const void *payload, uint8_t len, bool reliable) {
+  if (len > MAX_PAYLOAD) return false;
+
+  if (!reliable) {
+    uint8_t wire[WIRE_MAX];
+    uint8_t n = frame(type, txSeq++, payload, len, wire);
+    port.write(wire, n);
+    counters.txFrames++;
+    return true;
+  }
+
+  if (queueCount == TX_QUEUE) return false;
+  Pending &p = queue[(queueHead + queueCount) % TX_QUEUE];
+  p.seq = reliableSeq++;
+  p.type = type;
+  p.len = frame(type | RELIABLE, p.seq, payload, len, p.wire);
+  queueCount++;
+  if (!inFlight) transmitHead();
+  return true;
+}
+
+void MegaLink::transmitHead() {
+  Pending &p = queue[queueHead];
+  port.write(p.wire, p.len);
+  counters.txFrames++;
+  inFlight = true;
+  tries = 1;
+  sentAtMs = millis();
+}
+
+void MegaLink::sendAck(uint8_t seq) {
+  uint8_t wire[WIRE_MAX];
+  uint8_t n = frame(MEGA_MSG_ACK, txSeq++, &seq, 1, wire);
+  port.write(wire, n);
+  counters.txFrames++;
+}
+
+void MegaLink::sendHello() {
+  uint8_t b[4] = { (uint8_t)fastBaud, (uint8_t)(fastBaud >> 8), (uint8_t)(fastBaud >> 16),
+                   (uint8_t)(fastBaud >> 24) };
+  send(MEGA_MSG_HELLO, b, sizeof(b), true);
+  lastKeepaliveMs = millis();
+}
+
+void MegaLink::switchBaud(uint32_t baud) {
+  if (baud == currentBaud) return;
+  port.flush();  // let the last frame out at the old rate
+  setBaud(baud);
+  currentBaud = baud;
+  rxLen = 0;
+}
+
+void MegaLink::handleFrame(const uint8_t *raw, uint8_t len) {
+  if (len < 4) {
+    counters.rxFramingErrors++;
+    return;
+  }
+  uint16_t crc = raw[len - 2] | ((uint16_t)raw[len - 1] << 8);
+  if (crc16(raw, len - 2) != crc) {
+    counters.rxCrcErrors++;
+    return;
+  }
+  counters.rxFrames++;
+  lastRxMs = millis();
+  up = true;
+
+  uint8_t type = raw[0];
+  uint8_t seq = raw[1];
+  const uint8_t *payload = raw + 2;
+  uint8_t payloadLen = len - 4;
+
+  if (type == MEGA_MSG_ACK) {
+    if (inFlight && payloadLen == 1 && payload[0] == queue[queueHead].seq) {
+      bool wasHello = queue[queueHead].type == MEGA_MSG_HELLO;
+      inFlight = false;
+      queueHead = (queueHead + 1) % TX_QUEUE;
+      queueCount--;
+      // Our HELLO was accepted, move to the negotiated rate
+      if (wasHello && fastBaud) switchBaud(fastBaud);
+      if (queueCount) transmitHead();
+    }
+    return;
+  }
+
+  if (type & RELIABLE) {
+    sendAck(seq);
+    uint32_t now = millis();
+    bool repeat = seq == lastRxSeq && now - lastReliableMs < DEDUPE_MS;
+    lastRxSeq = seq;
+    lastReliableMs = now;
+    if (repeat) {
+      counters.rxDuplicates++;
+      return;
+    }
+    type &= ~RELIABLE;
+  }
+
+  if (type == MEGA_MSG_HELLO) {
+    if (!fastBaud && payloadLen == 4) {
+      pendingBaud = payload[0] | ((uint32_t)payload[1] << 8) | ((uint32_t)payload[2] << 16) |
+                    ((uint32_t)payload[3] << 24);
+    }
+    return;
+  }
+
+  if (handler) handler(type, payload, payloadLen);
+}
+
+void MegaLink::poll() {
+  while (port.available()) {
+    uint8_t b = port.read();
+    if (b != 0) {
+      if (rxLen < sizeof(rxBuf)) rxBuf[rxLen++] = b;
+      else rxOverflow = true;
+      continue;
+    }
+    if (rxOverflow) {
+      counters.rxFramingErrors++;
+    } else if (rxLen) {
+      uint8_t raw[WIRE_MAX];
+      uint8_t n = cobsDecode(rxBuf, rxLen, raw);
+      if (n) handleFrame(raw, n);
+      else counters.rxFramingErrors++;
+    }
+    rxLen = 0;
+    rxOverflow = false;
+  }
+
+  // Responder: the ACK for HELLO went out at the old rate, now follow
+  if (pendingBaud) {
+    switchBaud(pendingBaud);
+    pendingBaud = 0;
+  }
+
+  uint32_t now = millis();
+  if (inFlight && now - sentAtMs >= RETRY_MS) {
+    if (tries < MAX_TRIES) {
+      Pending &p = queue[queueHead];
+      port.write(p.wire, p.len);
+      counters.txRetries++;
+      tries++;
+      sentAtMs = now;
+    } else {
+      // Give up on this frame; the peer is gone or at another baud
+      counters.txFailures++;
+      inFlight = false;
+      up = false;
+      queueHead = (queueHead + 1) % TX_QUEUE;
+      queueCount--;
+      if (fastBaud && currentBaud != BASE_BAUD) {
+        counters.baudFallbacks++;
+        switchBaud(BASE_BAUD);
+      }
+      if (queueCount) transmitHead();
+    }
+  }
+
+  if (fastBaud) {
+    if (!inFlight && now - lastKeepaliveMs >= KEEPALIVE_MS) sendHello();
+  } else if (currentBaud != BASE_BAUD && now - lastRxMs >= SILENCE_FALLBACK_MS) {
+    counters.baudFallbacks++;
+    up = false;
+    switchBaud(BASE_BAUD);
+    lastRxMs = now;
+  }
+}
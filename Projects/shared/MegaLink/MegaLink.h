@@ -0,0 +1,137 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Framed binary link between the ESP32 and the Arduino Mega.
+//
+// Frame, before encoding:  [type][seq][payload 0..32][crc16 lo][crc16 hi]
+// The frame is COBS encoded and terminated by a single 0x00, so a receiver
+// always resynchronises on the next delimiter after line noise. The CRC is
+// CRC-16/CCITT-FALSE over type, seq and payload.
+//
+// Types with RELIABLE set are acknowledged (ACK carries the seq) and
+// retransmitted until acked, one frame in flight at a time. Reliable frames
+// are numbered on their own counter, so consecutive ones always differ; a
+// receiver drops a reliable frame that repeats the previous seq within the
+// retransmit window, so a retransmit is never delivered twice. After the
+// window the same seq is a new frame (e.g. from a peer that reset).
+//
+// Both ends start at BASE_BAUD. The initiator (ESP32) sends HELLO with the
+// baud it wants; the responder (Mega) ACKs at the old rate and switches.
+// HELLO doubles as a keepalive: if it goes unanswered the initiator drops
+// back to BASE_BAUD, and a responder that hears nothing valid for a while
+// does the same, so a reset on either side renegotiates by itself.
+//
+// Everything is parsed in place from fixed buffers; no heap is used.
+
+enum MegaLinkType : uint8_t {
+  MEGA_MSG_HELLO = 0x01,          // uint32 baud, little endian
+  MEGA_MSG_ACK = 0x02,            // uint8 acked seq
+  MEGA_MSG_SENSOR = 0x10,         // int16 temp x10, int16 hum x10 (ESP32 -> Mega)
+  MEGA_MSG_KEYPAD = 0x20,         // PIN characters (Mega -> ESP32)
+  MEGA_MSG_AUTH_RESULT = 0x21,    // uint8 MegaAuthStatus (ESP32 -> Mega)
+  MEGA_MSG_COMMAND = 0x30,        // console command line, e.g. "STATUS" (Mega -> ESP32)
+  MEGA_MSG_COMMAND_REPLY = 0x31,  // reply text, truncated to MAX_PAYLOAD (ESP32 -> Mega)
+};
+
+enum MegaAuthStatus : uint8_t {
+  MEGA_AUTH_DENIED = 0,
+  MEGA_AUTH_GRANTED = 1,
+  MEGA_AUTH_ERROR = 2,
+};
+
+struct MegaLinkStats {
+  uint32_t rxFrames;
+  uint32_t rxCrcErrors;
+  uint32_t rxFramingErrors;  // bad COBS, overlong or runt frames
+  uint32_t rxDuplicates;
+  uint32_t txFrames;
+  uint32_t txRetries;
+  uint32_t txFailures;       // reliable frames given up on
+  uint32_t baudFallbacks;
+};
+
+typedef void (*MegaLinkHandler)(uint8_t type, const uint8_t *payload, uint8_t len);
+typedef void (*MegaLinkBaudSetter)(uint32_t baud);
+
+class MegaLink {
+public:
+  static const uint32_t BASE_BAUD = 9600;
+  static const uint8_t MAX_PAYLOAD = 32;
+  static const uint8_t RELIABLE = 0x80;  // or'd into the type on the wire
+
+  MegaLink(Stream &port, MegaLinkBaudSetter setBaud) : port(port), setBaud(setBaud) {}
+
+  // fastBaud > 0 makes this end the initiator that negotiates the speed
+  // and sends keepalives; 0 makes it the responder.
+  void begin(MegaLinkHandler handler, uint32_t fastBaud = 0);
+
+  // Queue a message. Reliable messages wait behind any unacknowledged one.
+  // Returns false if the payload is too big or the reliable queue is full.
+  bool send(uint8_t type, const void *payload, uint8_t len, bool reliable);
+
+  // Read and dispatch received frames, run retransmits and keepalives.
+  // Call from every loop().
+  void poll();
+
+  uint32_t baud() const { return currentBaud; }
+  bool linkUp() const { return up; }
+  const MegaLinkStats &stats() const { return counters; }
+
+  // Exposed for the host-side tools
+  static uint16_t crc16(const uint8_t *data, uint8_t len);
+  static uint8_t cobsEncode(const uint8_t *in, uint8_t len, uint8_t *out);
+  static uint8_t cobsDecode(const uint8_t *in, uint8_t len, uint8_t *out);
+
+private:
+  static const uint8_t RAW_MAX = MAX_PAYLOAD + 4;        // type, seq, payload, crc
+  static const uint8_t WIRE_MAX = RAW_MAX + 2;           // COBS overhead + delimiter
+  static const uint8_t TX_QUEUE = 4;
+  static const uint16_t RETRY_MS = 150;
+  static const uint8_t MAX_TRIES = 5;
+  static const uint16_t KEEPALIVE_MS = 5000;
+  static const uint16_t SILENCE_FALLBACK_MS = 15000;
+  static const uint16_t DEDUPE_MS = RETRY_MS * (MAX_TRIES + 1);  // outlives every retransmit
+
+  struct Pending {
+    uint8_t wire[WIRE_MAX];
+    uint8_t len;
+    uint8_t seq;
+    uint8_t type;
+  };
+
+  Stream &port;
+  MegaLinkBaudSetter setBaud;
+  MegaLinkHandler handler = nullptr;
+
+  uint32_t fastBaud = 0;
+  uint32_t currentBaud = BASE_BAUD;
+  uint32_t pendingBaud = 0;   // responder: switch after our ACK is out
+  bool up = false;
+
+  uint8_t rxBuf[WIRE_MAX];
+  uint8_t rxLen = 0;
+  bool rxOverflow = false;
+  uint32_t lastRxMs = 0;
+  int16_t lastRxSeq = -1;       // last reliable seq delivered
+  uint32_t lastReliableMs = 0;  // when it (or a repeat of it) arrived
+
+  uint8_t txSeq = 0;        // unreliable frames and ACKs, never checked
+  uint8_t reliableSeq = 0;  // reliable frames only
+  Pending queue[TX_QUEUE];
+  uint8_t queueHead = 0;
+  uint8_t queueCount = 0;
+  bool inFlight = false;
+  uint8_t tries = 0;
+  uint32_t sentAtMs = 0;
+  uint32_t lastKeepaliveMs = 0;
+
+  MegaLinkStats counters = {};
+
+  uint8_t frame(uint8_t type, uint8_t seq, const void *payload, uint8_t len, uint8_t *wire);
+  void transmitHead();
+  void sendAck(uint8_t seq);
+  void handleFrame(const uint8_t *raw, uint8_t len);
+  void switchBaud(uint32_t baud);
+  void sendHello();
+};
@@ -0,0 +1,185 @@
+#include "MqttLink.h"
+
+MqttLink::MqttLink(const char *host, uint16_t port, const char *deviceId) : mqtt(net), deviceId(deviceId) {
+  snprintf(prefix, sizeof(prefix), "home/%s", deviceId);
+  mqtt.setServer(host, port);
+  mqtt.setBufferSize(BUFFER_SIZE);
+  mqtt.setKeepAlive(KEEPALIVE_S);
+  mqtt.setCallback([this](char *topic, uint8_t *payload, unsigned int len) { onMessage(topic, payload, len); });
+}
+
+// "/api/check-auth/" -> "check-auth", "/api/cmd-reply/7/" -> "cmd-reply/7"
+bool MqttLink::topicName(const char *path, char *out, size_t len) {
+  if (strncmp(path, "/api/", 5) == 0) path += 5;
+  size_t n = strlen(path);
+  if (n && path[n - 1] == '/') n--;
+  if (!n || n >= len) return false;
+  memcpy(out, path, n);
+  out[n] = '\0';
+  return true;
+}
+
+// A 202 for a publish only means it reached the socket, so anything whose
+// caller drops its copy on success (sensor and GPS batches) needs the
+// server's reply. Command replies are the only fire-and-forget messages.
+bool MqttLink::reliable(const char *name) {
+  return strncmp(name, "cmd-reply", 9) != 0;
+}
+
+bool MqttLink::ensureConnected() {
+  if (mqtt.connected()) return true;
+  if (WiFi.status() != WL_CONNECTED) return false;
+  if ((int32_t)(millis() - nextConnectAt) < 0) return false;
+
+  char statusTopic[sizeof(prefix) + 8];
+  snprintf(statusTopic, sizeof(statusTopic), "%s/status", prefix);
+
+  // Persistent session: the broker keeps the QoS 1 subscriptions and
+  // queues commands while we're away
+  if (!mqtt.connect(deviceId, authenticated() ? username : nullptr, authenticated() ? password : nullptr,
+                    statusTopic, 1, true, "offline", false)) {
+    counters.connectFailures++;
+    Serial.printf("[MQTT] Connect failed, state %d, next try in %lums\n", mqtt.state(),
+                  (unsigned long)reconnectDelay);
+    nextConnectAt = millis() + reconnectDelay;
+    reconnectDelay = reconnectDelay * 2 > RECONNECT_MAX_MS ? RECONNECT_MAX_MS : reconnectDelay * 2;
+    return false;
+  }
+  counters.connects++;
+  reconnectDelay = RECONNECT_MIN_MS;
+  // Request ids restart from a random point so a reboot doesn't reuse ids
+  // the server has just seen
+  if (!nextRequestId) nextRequestId = (uint16_t)esp_random() | 1;
+
+  char topic[sizeof(prefix) + 16];
+  mqtt.publish(statusTopic, "online", true);
+  snprintf(topic, sizeof(topic), "%s/cmd/+", prefix);
+  mqtt.subscribe(topic, 1);
+  snprintf(topic, sizeof(topic), "%s/reply/#", prefix);
+  mqtt.subscribe(topic, 1);
+  Serial.println("[MQTT] Connected");
+  return true;
+}
+
+void MqttLink::onMessage(char *topic, uint8_t *payload, unsigned int len) {
+  size_t prefixLen = strlen(prefix);
+  if (strncmp(topic, prefix, prefixLen) != 0 || topic[prefixLen] != '/') return;
+  const char *rest = topic + prefixLen + 1;
+
+  // reply/<id>/<status>
+  if (strncmp(rest, "reply/", 6) == 0) {
+    char *end;
+    unsigned long id = strtoul(rest + 6, &end, 10);
+    int status = *end == '/' ? atoi(end + 1) : 200;
+    if (!awaitingId || id != awaitingId || replied) {
+      counters.lateReplies++;
+      return;
+    }
+    if (replyBuf && replyLen) {
+      size_t n = len < replyLen - 1 ? len : replyLen - 1;
+      memcpy(replyBuf, payload, n);
+      replyBuf[n] = '\0';
+    }
+    replyCode = status;
+    replied = true;
+    return;
+  }
+
+  // cmd/<id>
+  if (strncmp(rest, "cmd/", 4) == 0) {
+    counters.commands++;
+    if (!commandHandler) return;
+    char line[MAX_COMMAND];
+    size_t n = len < sizeof(line) - 1 ? len : sizeof(line) - 1;
+    memcpy(line, payload, n);
+    line[n] = '\0';
+    commandHandler(rest + 4, line, n);
+  }
+}
+
+int MqttLink::post(const char *path, const char *body, char *response, size_t responseLen, uint32_t timeoutMs) {
+  if (response && responseLen) response[0] = '\0';
+
+  char name[48];
+  if (!topicName(path, name, sizeof(name))) {
+    counters.failures++;
+    return MQTT_ERR_PATH;
+  }
+  if (!ensureConnected()) {
+    counters.failures++;
+    return MQTT_ERR_OFFLINE;
+  }
+
+  char topic[sizeof(prefix) + sizeof(name) + 12];
+  if (!reliable(name)) {
+    snprintf(topic, sizeof(topic), "%s/up/%s", prefix, name);
+    if (!mqtt.publish(topic, body)) {
+      counters.failures++;
+      return MQTT_ERR_PUBLISH;
+    }
+    counters.published++;
+    return 202;
+  }
+
+  uint32_t start = micros();
+  counters.requests++;
+  uint16_t id = nextRequestId++;
+  if (!nextRequestId) nextRequestId = 1;
+  snprintf(topic, sizeof(topic), "%s/req/%s/%u", prefix, name, id);
+
+  awaitingId = id;
+  replied = false;
+  replyBuf = response;
+  replyLen = responseLen;
+
+  // Same topic every time, so the server can tell a retransmission from a
+  // new request
+  uint32_t startMs = millis();
+  uint32_t sentAt = 0;
+  bool sent = false;
+  while (!replied && millis() - startMs < timeoutMs) {
+    if (!mqtt.connected()) break;
+    if (!sent || millis() - sentAt >= RETRY_MS) {
+      if (sent) counters.retries++;
+      if (!mqtt.publish(topic, body)) break;
+      sent = true;
+      sentAt = millis();
+    }
+    mqtt.loop();
+    if (!replied) delay(1);
+  }
+
+  bool ok = replied;
+  awaitingId = 0;
+  replyBuf = nullptr;
+  replyLen = 0;
+  if (!ok) {
+    counters.failures++;
+    return mqtt.connected() ? MQTT_ERR_TIMEOUT : MQTT_ERR_OFFLINE;
+  }
+
+  uint32_t elapsed = micros() - start;
+  counters.totalLatencyUs += elapsed;
+  if (elapsed > counters.maxLatencyUs) counters.maxLatencyUs = elapsed;
+  return replyCode;
+}
+
+void MqttLink::poll() {
+  if (ensureConnected()) mqtt.loop();
+}
+
+void MqttLink::close() {
+  mqtt.disconnect();
+  net.stop();
+}
+
+void MqttLink::printStats(Print &out) const {
+  out.printf("[MQTT] published=%lu requests=%lu failures=%lu retries=%lu late=%lu commands=%lu "
+             "connects=%lu connectFailures=%lu avg=%lums max=%lums\n",
+             (unsigned long)counters.published, (unsigned long)counters.requests,
+             (unsigned long)counters.failures, (unsigned long)counters.retries,
+             (unsigned long)counters.lateReplies, (unsigned long)counters.commands,
+             (unsigned long)counters.connects, (unsigned long)counters.connectFailures,
+             (unsigned long)(counters.requests ? counters.totalLatencyUs / counters.requests / 1000 : 0),
+             (unsigned long)(counters.maxLatencyUs / 1000));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <Transport.h>
+
+// The backend API over one persistent MQTT session instead of an HTTP
+// request per message.
+//
+// Topics, under home/<deviceId>/:
+//   req/<name>/<id>          everything the caller acts on: auth, alerts and
+//                            the sensor and GPS batches that are released
+//                            on a 2xx. post() waits for the server's
+//                            reply/<id>/<status> and republishes every
+//                            RETRY_MS until it arrives, so delivery is at
+//                            least once (PubSubClient can only publish at
+//                            QoS 0; the reply is the acknowledgement and the
+//                            server drops repeated ids)
+//   up/<name>                command replies only, QoS 0: post() returns
+//                            202 once the message is on the socket
+//   cmd/<id>                 commands pushed by the server, subscribed at
+//                            QoS 1 on a persistent session, so commands sent
+//                            while the device was offline arrive on reconnect
+//   status                   retained "online", "offline" as the last will
+// <name> is the Django path without "/api/" and the trailing slash, e.g.
+// "/api/gps-data/" -> "gps-data".
+
+// Negative results in addition to the HTTP-style codes
+const int MQTT_ERR_OFFLINE = -200;  // no broker session
+const int MQTT_ERR_PUBLISH = -201;  // message didn't fit or the socket failed
+const int MQTT_ERR_TIMEOUT = -202;  // no reply before the deadline
+const int MQTT_ERR_PATH = -203;     // path doesn't map to a topic
+
+// A command from cmd/<id>; line is NUL terminated. Runs on the task that
+// calls poll()/post().
+typedef void (*MqttCommandHandler)(const char *id, const char *line, size_t len);
+
+struct MqttLinkStats {
+  uint32_t published;      // QoS 0 messages
+  uint32_t requests;       // request/reply exchanges
+  uint32_t failures;       // posts that ended with a negative code
+  uint32_t retries;        // request republished while waiting for its reply
+  uint32_t lateReplies;    // replies for requests already given up on
+  uint32_t commands;
+  uint32_t connects;
+  uint32_t connectFailures;
+  uint32_t maxLatencyUs;   // slowest request/reply
+  uint64_t totalLatencyUs;
+};
+
+class MqttLink : public Transport {
+public:
+  static const uint16_t BUFFER_SIZE = 4352;  // a 4 KB GPS batch plus topic and header
+  static const uint16_t KEEPALIVE_S = 30;
+  static const uint16_t RETRY_MS = 1000;
+  static const uint32_t RECONNECT_MIN_MS = 1000;
+  static const uint32_t RECONNECT_MAX_MS = 30000;
+  static const size_t MAX_COMMAND = 128;
+
+  MqttLink(const char *host, uint16_t port, const char *deviceId);
+
+  void onCommand(MqttCommandHandler handler) { commandHandler = handler; }
+
+  // Log in to the broker with these from the next connect on. Without them
+  // the session is anonymous, and so is whoever publishes on cmd/.
+  void setCredentials(const char *user, const char *password) {
+    username = user;
+    this->password = password;
+  }
+  bool authenticated() const { return username && *username; }
+
+  int post(const char *path, const char *body, char *response = nullptr, size_t responseLen = 0,
+           uint32_t timeoutMs = 5000) override;
+
+  // (Re)connect with backoff and deliver incoming commands
+  void poll() override;
+  void close() override;
+
+  bool connected() { return mqtt.connected(); }
+  const MqttLinkStats &stats() const { return counters; }
+  void printStats(Print &out) const override;
+
+private:
+  WiFiClient net;
+  PubSubClient mqtt;
+  const char *deviceId;
+  const char *username = nullptr;
+  const char *password = nullptr;
+  char prefix[40];
+  MqttCommandHandler commandHandler = nullptr;
+  MqttLinkStats counters = {};
+
+  uint32_t nextConnectAt = 0;
+  uint32_t reconnectDelay = RECONNECT_MIN_MS;
+  uint16_t nextRequestId = 0;
+
+  // The one request waiting for its reply
+  uint16_t awaitingId = 0;
+  bool replied = false;
+  int replyCode = 0;
+  char *replyBuf = nullptr;
+  size_t replyLen = 0;
+
+  bool ensureConnected();
+  void onMessage(char *topic, uint8_t *payload, unsigned int len);
+  static bool topicName(const char *path, char *out, size_t len);
+  static bool reliable(const char *name);
+};
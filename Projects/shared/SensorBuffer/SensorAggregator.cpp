@@ -0,0 +1,61 @@
+#include "SensorAggregator.h"
+
+#include <math.h>
+
+static int16_t tenths(float v) {
+  return (int16_t)lroundf(v * 10);
+}
+
+void SensorAggregator::Channel::add(float v, bool newWindow, bool seed, float alpha) {
+  if (newWindow) {
+    min = max = sum = v;
+  } else {
+    if (v < min) min = v;
+    if (v > max) max = v;
+    sum += v;
+  }
+  ewma = seed ? v : ewma + alpha * (v - ewma);
+}
+
+bool SensorAggregator::add(float temperature, float humidity, uint32_t timestamp, uint32_t nowMs,
+                           SensorSample &out) {
+  readingCount++;
+  bool newWindow = windowCount == 0;
+  bool seed = !started;
+  if (newWindow) windowStartMs = nowMs;
+  temp.add(temperature, newWindow, seed, config.alpha);
+  hum.add(humidity, newWindow, seed, config.alpha);
+  windowCount++;
+
+  if (seed || fabsf(temp.ewma - temp.reported) >= config.tempDelta ||
+      fabsf(hum.ewma - hum.reported) >= config.humDelta || nowMs - windowStartMs >= config.windowMs) {
+    started = true;
+    emit(timestamp, out);
+    return true;
+  }
+  return false;
+}
+
+bool SensorAggregator::flush(uint32_t timestamp, SensorSample &out) {
+  if (!windowCount) return false;
+  emit(timestamp, out);
+  return true;
+}
+
+void SensorAggregator::emit(uint32_t timestamp, SensorSample &out) {
+  out.timestamp = timestamp;
+  out.temperature = temp.ewma;
+  out.humidity = hum.ewma;
+  out.count = windowCount;
+  out.tempMin = tenths(temp.min);
+  out.tempMax = tenths(temp.max);
+  out.tempMean = tenths(temp.sum / windowCount);
+  out.humMin = tenths(hum.min);
+  out.humMax = tenths(hum.max);
+  out.humMean = tenths(hum.sum / windowCount);
+
+  temp.reported = temp.ewma;
+  hum.reported = hum.ewma;
+  windowCount = 0;
+  recordCount++;
+}
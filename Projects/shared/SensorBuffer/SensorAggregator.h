@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include "SensorBuffer.h"
+
+// Turns a stream of DHT readings into a few summary records.
+// Every reading updates a window (min, max, mean) and an EWMA per
+// channel. A record is emitted when the EWMA has moved tempDelta /
+// humDelta away from the last record, or when the window is windowMs old,
+// and it carries the window's summary, so a short excursion that the EWMA
+// smooths over still shows up in min/max. The first reading is emitted
+// right away so the server has a value after boot.
+
+struct AggregatorConfig {
+  float tempDelta = 1.0f;     // degrees C of EWMA movement that forces a record
+  float humDelta = 3.0f;      // %RH
+  float alpha = 0.25f;        // EWMA weight of a new reading
+  uint32_t windowMs = 150000; // a record at least this often
+};
+
+class SensorAggregator {
+public:
+  explicit SensorAggregator(const AggregatorConfig &config = AggregatorConfig()) : config(config) {}
+
+  // Feed one reading. Returns true and fills out when a record is due;
+  // out.temperature/humidity are the EWMA at that point.
+  bool add(float temperature, float humidity, uint32_t timestamp, uint32_t nowMs, SensorSample &out);
+
+  // Emit whatever the open window holds; false if it's empty. The
+  // firmware calls it when WiFi drops, so the last record before an
+  // outage covers every reading up to it.
+  bool flush(uint32_t timestamp, SensorSample &out);
+
+  uint32_t readings() const { return readingCount; }
+  uint32_t records() const { return recordCount; }
+
+private:
+  struct Channel {
+    float min, max, sum;
+    float ewma;
+    float reported;  // EWMA in the last record
+
+    void add(float v, bool newWindow, bool seed, float alpha);
+  };
+
+  AggregatorConfig config;
+  Channel temp = {}, hum = {};
+  uint16_t windowCount = 0;
+  uint32_t windowStartMs = 0;
+  bool started = false;  // EWMA seeded and a first record out
+  uint32_t readingCount = 0, recordCount = 0;
+
+  void emit(uint32_t timestamp, SensorSample &out);
+};
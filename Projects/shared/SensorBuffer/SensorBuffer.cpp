@@ -0,0 +1,173 @@
+#include "SensorBuffer.h"
+
+#include <LittleFS.h>
+#include <time.h>
+
+static const char SPILL_FILE[] = "/sensor_spill2.bin";
+static const char CURSOR_FILE[] = "/sensor_spill2.idx";
+// Spill files of the smaller pre-summary record, unreadable now
+static const char LEGACY_SPILL_FILE[] = "/sensor_spill.bin";
+static const char LEGACY_CURSOR_FILE[] = "/sensor_spill.idx";
+
+// Rough size of one formatted record with its window summary, used to
+// decide when a batch is full
+static const size_t APPROX_SAMPLE_BYTES = 192;
+
+bool SensorBuffer::begin() {
+  fsReady = LittleFS.begin(true);
+  if (!fsReady) {
+    Serial.println("[BUFFER] LittleFS unavailable, RAM only");
+    return false;
+  }
+
+  if (LittleFS.exists(LEGACY_SPILL_FILE)) {
+    LittleFS.remove(LEGACY_SPILL_FILE);
+    LittleFS.remove(LEGACY_CURSOR_FILE);
+  }
+
+  File f = LittleFS.open(SPILL_FILE, "r");
+  if (f) {
+    spillTotal = f.size() / sizeof(SensorSample);
+    f.close();
+  }
+  File c = LittleFS.open(CURSOR_FILE, "r");
+  if (c) {
+    c.read((uint8_t *)&spillRead, sizeof(spillRead));
+    c.close();
+  }
+  if (spillRead > spillTotal) spillRead = spillTotal;
+  if (spilledPending()) {
+    oldestPendingMs = millis();
+    Serial.print("[BUFFER] Recovered spilled samples: ");
+    Serial.println(spilledPending());
+  }
+  return true;
+}
+
+void SensorBuffer::push(const SensorSample &sample) {
+  if (pending() == 0) oldestPendingMs = millis();
+  if (count == CAPACITY) spillOldest(CAPACITY / 2);
+  ring[(head + count) % CAPACITY] = sample;
+  count++;
+}
+
+bool SensorBuffer::due(uint32_t maxAgeMs, size_t byteBudget) const {
+  if (pending() == 0) return false;
+  if (pending() * APPROX_SAMPLE_BYTES >= byteBudget) return true;
+  return millis() - oldestPendingMs >= maxAgeMs;
+}
+
+// Spill records are always older than anything in the ring
+bool SensorBuffer::sampleAt(uint32_t index, SensorSample &out) const {
+  uint32_t spilled = spilledPending();
+  if (index < spilled) {
+    File f = LittleFS.open(SPILL_FILE, "r");
+    if (!f) return false;
+    bool ok = f.seek((spillRead + index) * sizeof(SensorSample)) &&
+              f.read((uint8_t *)&out, sizeof(out)) == sizeof(out);
+    f.close();
+    return ok;
+  }
+  index -= spilled;
+  if (index >= count) return false;
+  out = ring[(head + index) % CAPACITY];
+  return true;
+}
+
+uint16_t SensorBuffer::buildBatch(char *out, size_t outLen, size_t byteBudget, const char *deviceId) {
+  if (byteBudget > outLen) byteBudget = outLen;
+  size_t len = 0;
+  batchCount = 0;
+  out[len++] = '[';
+
+  char item[256];
+  SensorSample s;
+  while (batchCount < pending() && sampleAt(batchCount, s)) {
+    size_t n = formatSample(item, sizeof(item), s, deviceId);
+    // room for the separator, the closing bracket and the NUL
+    if (len + n + 3 > byteBudget) break;
+    if (batchCount) out[len++] = ',';
+    memcpy(out + len, item, n);
+    len += n;
+    batchCount++;
+  }
+  out[len++] = ']';
+  out[len] = '\0';
+  return batchCount;
+}
+
+void SensorBuffer::commit() {
+  uint16_t n = batchCount;
+  batchCount = 0;
+
+  uint32_t fromSpill = n < spilledPending() ? n : spilledPending();
+  if (fromSpill) {
+    spillRead += fromSpill;
+    n -= fromSpill;
+    if (spilledPending() == 0) {
+      // Everything on flash went out, start the spill area over
+      LittleFS.remove(SPILL_FILE);
+      LittleFS.remove(CURSOR_FILE);
+      spillTotal = spillRead = 0;
+    } else {
+      saveSpillCursor();
+    }
+  }
+  if (n > count) n = count;
+  head = (head + n) % CAPACITY;
+  count -= n;
+
+  oldestPendingMs = millis();
+}
+
+void SensorBuffer::spillOldest(uint16_t n) {
+  if (fsReady && spillTotal + n <= MAX_SPILLED) {
+    File f = LittleFS.open(SPILL_FILE, "a");
+    if (f) {
+      for (uint16_t i = 0; i < n; i++) {
+        f.write((const uint8_t *)&ring[(head + i) % CAPACITY], sizeof(SensorSample));
+      }
+      f.close();
+      spillTotal += n;
+    } else {
+      dropOldest(n);
+    }
+  } else {
+    dropOldest(n);
+  }
+  // Spilled or not, these samples are out of the ring now; order is kept
+  head = (head + n) % CAPACITY;
+  count -= n;
+}
+
+void SensorBuffer::dropOldest(uint16_t n) {
+  droppedCount += n;
+  batchCount = 0;  // an unconfirmed batch no longer lines up, resend it
+}
+
+void SensorBuffer::saveSpillCursor() {
+  File c = LittleFS.open(CURSOR_FILE, "w");
+  if (!c) return;
+  c.write((const uint8_t *)&spillRead, sizeof(spillRead));
+  c.close();
+}
+
+size_t SensorBuffer::formatSample(char *out, size_t outLen, const SensorSample &s, const char *deviceId) {
+  int n = snprintf(out, outLen, "{\"temperature\":%.1f,\"humidity\":%.1f", s.temperature, s.humidity);
+  if (deviceId) n += snprintf(out + n, outLen - n, ",\"device_id\":\"%s\"", deviceId);
+  if (s.timestamp) {
+    time_t t = s.timestamp;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    n += strftime(out + n, outLen - n, ",\"timestamp\":\"%Y-%m-%d %H:%M:%S\"", &tm);
+  }
+  if (s.count) {
+    n += snprintf(out + n, outLen - n,
+                  ",\"window\":{\"n\":%u,\"t_min\":%.1f,\"t_max\":%.1f,\"t_mean\":%.1f,"
+                  "\"h_min\":%.1f,\"h_max\":%.1f,\"h_mean\":%.1f}",
+                  s.count, s.tempMin / 10.0f, s.tempMax / 10.0f, s.tempMean / 10.0f,
+                  s.humMin / 10.0f, s.humMax / 10.0f, s.humMean / 10.0f);
+  }
+  n += snprintf(out + n, outLen - n, "}");
+  return n;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Store-and-forward buffer for DHT samples.
+// Samples go into a fixed RAM ring. When the ring fills up (WiFi down, server
+// unreachable) its older half is spilled to LittleFS, so a long outage costs
+// flash space instead of data. Uploads are built oldest-first as one JSON
+// array per request, capped by a byte budget; the samples are only released
+// by commit() once the server has accepted the batch.
+
+struct SensorSample {
+  uint32_t timestamp;  // unix seconds, 0 if the clock wasn't set yet
+  float temperature;
+  float humidity;
+  // Window summary from SensorAggregator, in tenths; count is 0 for a
+  // plain reading and the rest is then unused
+  uint16_t count;
+  int16_t tempMin, tempMax, tempMean;
+  int16_t humMin, humMax, humMean;
+};
+
+class SensorBuffer {
+public:
+  static const uint16_t CAPACITY = 64;        // samples held in RAM
+  static const uint32_t MAX_SPILLED = 4096;   // samples held on flash (112 KB)
+
+  // Mounts LittleFS and picks up samples spilled before a reboot
+  bool begin();
+
+  void push(const SensorSample &sample);
+
+  uint32_t pending() const { return spilledPending() + count; }
+  uint32_t dropped() const { return droppedCount; }
+
+  // True once the oldest pending sample is maxAgeMs old or enough samples
+  // are waiting to fill byteBudget.
+  bool due(uint32_t maxAgeMs, size_t byteBudget) const;
+
+  // Write the oldest pending samples as a JSON array into out, stopping
+  // before byteBudget (and outLen) is exceeded. device_id is added when
+  // deviceId is given. Returns the number of samples in the batch.
+  uint16_t buildBatch(char *out, size_t outLen, size_t byteBudget, const char *deviceId = nullptr);
+
+  // Release the samples of the last buildBatch() after a successful upload
+  void commit();
+
+private:
+  SensorSample ring[CAPACITY];
+  uint16_t head = 0;
+  uint16_t count = 0;
+  uint32_t spillTotal = 0;  // records in the spill file
+  uint32_t spillRead = 0;   // records already uploaded from it
+  uint16_t batchCount = 0;
+  uint32_t oldestPendingMs = 0;
+  uint32_t droppedCount = 0;
+  bool fsReady = false;
+
+  uint32_t spilledPending() const { return spillTotal - spillRead; }
+  bool sampleAt(uint32_t index, SensorSample &out) const;
+  void spillOldest(uint16_t n);
+  void dropOldest(uint16_t n);
+  void saveSpillCursor();
+  static size_t formatSample(char *out, size_t outLen, const SensorSample &s, const char *deviceId);
+};
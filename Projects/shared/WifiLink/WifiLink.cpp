@@ -0,0 +1,183 @@
+#include "WifiLink.h"
+#include <Preferences.h>
+
+static const char *const STATE_NAMES[] = { "idle", "connecting", "waiting", "connected" };
+
+void WifiLink::begin(WifiLinkCallback cb) {
+  callback = cb;
+  WiFi.persistent(false);  // credentials come from the sketch, don't rewrite flash on every begin
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) { onEvent(event, info); });
+  loadCache();
+  startedAt = offlineSince = millis();
+  startAttempt(startedAt);
+}
+
+// WiFi event task: record and return
+void WifiLink::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  portENTER_CRITICAL(&mux);
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      memcpy(eventBssid, info.wifi_sta_connected.bssid, sizeof(eventBssid));
+      eventChannel = info.wifi_sta_connected.channel;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      eventUp = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      eventUp = false;
+      eventReason = info.wifi_sta_disconnected.reason;
+      disconnectEvents++;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      eventUp = false;
+      break;
+    default:
+      break;
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+void WifiLink::loop() {
+  if (linkState == WIFI_LINK_IDLE) return;
+  uint32_t now = millis();
+  portENTER_CRITICAL(&mux);
+  bool up = eventUp;
+  uint32_t disconnects = disconnectEvents;
+  counters.lastReason = eventReason;
+  portEXIT_CRITICAL(&mux);
+
+  switch (linkState) {
+    case WIFI_LINK_CONNECTED:
+      if (!up) linkDown(now);
+      break;
+    case WIFI_LINK_CONNECTING:
+      if (up) linkUp(now);
+      else if (disconnects != attemptDisconnects || now - attemptStart >= ATTEMPT_TIMEOUT_MS) attemptFailed(now);
+      break;
+    case WIFI_LINK_WAITING:
+      if ((int32_t)(now - nextAttemptAt) >= 0) startAttempt(now);
+      break;
+    default:
+      break;
+  }
+}
+
+void WifiLink::startAttempt(uint32_t now) {
+  counters.attempts++;
+  attemptFast = cachedChannel && (failedAttempts < FAST_FAILS_MAX || failedAttempts % 2 == 0);
+  // Only events from here on count for this attempt
+  portENTER_CRITICAL(&mux);
+  eventUp = false;
+  attemptDisconnects = disconnectEvents;
+  portEXIT_CRITICAL(&mux);
+  attemptStart = now;
+  linkState = WIFI_LINK_CONNECTING;
+  if (attemptFast) WiFi.begin(ssid, password, cachedChannel, cachedBssid);
+  else WiFi.begin(ssid, password);
+}
+
+void WifiLink::attemptFailed(uint32_t now) {
+  counters.failures++;
+  if (++failedAttempts == FAST_FAILS_MAX && cachedChannel) {
+    Serial.println("[WIFI] Cached AP not answering, scanning too");
+  }
+  WiFi.disconnect();
+
+  // Half of the backoff is fixed, the other half random
+  backoff = !backoff ? BACKOFF_MIN_MS : backoff * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : backoff * 2;
+  uint32_t wait = backoff / 2 + esp_random() % (backoff / 2 + 1);
+  nextAttemptAt = now + wait;
+  linkState = WIFI_LINK_WAITING;
+  Serial.printf("[WIFI] Attempt failed (reason %u), retry in %lums\n", counters.lastReason, (unsigned long)wait);
+}
+
+void WifiLink::linkUp(uint32_t now) {
+  uint32_t took = now - attemptStart;
+  uint32_t outage = now - offlineSince;
+  counters.connects++;
+  if (attemptFast) counters.fastConnects++;
+  counters.lastConnectMs = took;
+  if (took > counters.maxConnectMs) counters.maxConnectMs = took;
+  if (!everConnected) counters.bootConnectMs = now - startedAt;
+  counters.lastOfflineMs = outage;
+  counters.offlineMs += outage;
+  everConnected = true;
+  failedAttempts = 0;
+  backoff = 0;
+  linkState = WIFI_LINK_CONNECTED;
+
+  saveCache();
+  Serial.printf("[WIFI] Connected, IP %s, channel %u%s, %lums (offline %lums)\n",
+                WiFi.localIP().toString().c_str(), cachedChannel, attemptFast ? " (cached)" : "",
+                (unsigned long)took, (unsigned long)outage);
+  if (callback) callback(true);
+}
+
+// The first retry goes out at once: a short blip reconnects in one attempt
+void WifiLink::linkDown(uint32_t now) {
+  offlineSince = now;
+  Serial.printf("[WIFI] Link lost (reason %u)\n", counters.lastReason);
+  if (callback) callback(false);
+  startAttempt(now);
+}
+
+void WifiLink::disconnect() {
+  bool wasUp = connected();
+  if (wasUp) offlineSince = millis();
+  linkState = WIFI_LINK_IDLE;
+  WiFi.disconnect();
+  if (wasUp && callback) callback(false);
+}
+
+void WifiLink::reconnect() {
+  if (linkState == WIFI_LINK_CONNECTED || linkState == WIFI_LINK_CONNECTING) return;
+  backoff = 0;
+  failedAttempts = 0;
+  startAttempt(millis());
+}
+
+uint32_t WifiLink::offlineFor() const {
+  return connected() ? 0 : millis() - offlineSince;
+}
+
+void WifiLink::loadCache() {
+  Preferences prefs;
+  if (!prefs.begin(WIFILINK_NVS_NAMESPACE, true)) return;
+  if (prefs.getString(WIFILINK_NVS_SSID, "") == ssid &&
+      prefs.getBytes(WIFILINK_NVS_BSSID, cachedBssid, sizeof(cachedBssid)) == sizeof(cachedBssid)) {
+    cachedChannel = prefs.getUChar(WIFILINK_NVS_CHANNEL, 0);
+  }
+  prefs.end();
+}
+
+// Written only when the AP changed, so NVS isn't worn by every reconnect
+void WifiLink::saveCache() {
+  uint8_t bssid[6];
+  portENTER_CRITICAL(&mux);
+  memcpy(bssid, eventBssid, sizeof(bssid));
+  uint8_t channel = eventChannel;
+  portEXIT_CRITICAL(&mux);
+  if (!channel || (channel == cachedChannel && memcmp(bssid, cachedBssid, sizeof(bssid)) == 0)) return;
+
+  memcpy(cachedBssid, bssid, sizeof(cachedBssid));
+  cachedChannel = channel;
+  Preferences prefs;
+  if (!prefs.begin(WIFILINK_NVS_NAMESPACE, false)) return;
+  prefs.putString(WIFILINK_NVS_SSID, ssid);
+  prefs.putBytes(WIFILINK_NVS_BSSID, cachedBssid, sizeof(cachedBssid));
+  prefs.putUChar(WIFILINK_NVS_CHANNEL, cachedChannel);
+  prefs.end();
+}
+
+void WifiLink::printStats(Print &out) const {
+  uint64_t offline = counters.offlineMs + offlineFor();
+  out.printf("[WIFI] state=%s connects=%lu fast=%lu attempts=%lu failures=%lu boot=%lums last=%lums max=%lums "
+             "offline=%lus lastOutage=%lums reason=%u rssi=%d\n",
+             STATE_NAMES[linkState], (unsigned long)counters.connects, (unsigned long)counters.fastConnects,
+             (unsigned long)counters.attempts, (unsigned long)counters.failures,
+             (unsigned long)counters.bootConnectMs, (unsigned long)counters.lastConnectMs,
+             (unsigned long)counters.maxConnectMs, (unsigned long)(offline / 1000),
+             (unsigned long)counters.lastOfflineMs, counters.lastReason, connected() ? WiFi.RSSI() : 0);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Event-driven station connection that never blocks the caller.
+// WiFi events (from the WiFi task) only record what happened; loop() runs
+// the state machine on the caller's task. A dropped link is retried at
+// once, then with exponential backoff and jitter, so a fleet doesn't hit a
+// rebooted AP in lockstep. Each attempt is bounded by ATTEMPT_TIMEOUT_MS.
+// The AP's BSSID and channel are kept in NVS after every connection and
+// used on the next attempt (boot included), which skips the full channel
+// scan; after FAST_FAILS_MAX failed attempts, attempts alternate between a
+// full scan (the AP moved) and the cache (it's just slow to come back).
+// The core's own auto-reconnect is turned off so it can't race with this.
+
+static const char WIFILINK_NVS_NAMESPACE[] = "wifilink";
+static const char WIFILINK_NVS_BSSID[] = "bssid";
+static const char WIFILINK_NVS_CHANNEL[] = "chan";
+static const char WIFILINK_NVS_SSID[] = "ssid";  // cache only applies to the same network
+
+enum WifiLinkState : uint8_t {
+  WIFI_LINK_IDLE,        // not started, or disconnect() called
+  WIFI_LINK_CONNECTING,  // attempt in progress
+  WIFI_LINK_WAITING,     // backing off until the next attempt
+  WIFI_LINK_CONNECTED,   // associated and has an IP
+};
+
+// Called from loop() when the link comes up or goes down
+typedef void (*WifiLinkCallback)(bool connected);
+
+struct WifiLinkStats {
+  uint32_t attempts;
+  uint32_t failures;       // attempts that timed out or were refused
+  uint32_t connects;
+  uint32_t fastConnects;   // connects that used the cached BSSID/channel
+  uint32_t bootConnectMs;  // begin() to the first IP
+  uint32_t lastConnectMs;  // link lost (or begin()) to IP, last time
+  uint32_t maxConnectMs;
+  uint32_t lastOfflineMs;  // length of the last outage
+  uint64_t offlineMs;      // total time without a link since begin(), finished outages
+  uint8_t lastReason;      // last disconnect reason (wifi_err_reason_t)
+};
+
+class WifiLink {
+public:
+  static const uint32_t ATTEMPT_TIMEOUT_MS = 10000;
+  static const uint32_t BACKOFF_MIN_MS = 500;
+  static const uint32_t BACKOFF_MAX_MS = 8000;  // bounds how long a rebooted AP waits for us
+  static const uint8_t FAST_FAILS_MAX = 2;
+
+  WifiLink(const char *ssid, const char *password) : ssid(ssid), password(password) {}
+
+  // Registers for WiFi events and starts the first attempt
+  void begin(WifiLinkCallback cb = nullptr);
+
+  // Timeouts, backoff and callbacks. Call often from loop().
+  void loop();
+
+  // Drop the link on purpose and stay down until reconnect()
+  void disconnect();
+  // Start an attempt now with the backoff reset
+  void reconnect();
+
+  bool connected() const { return linkState == WIFI_LINK_CONNECTED; }
+  WifiLinkState state() const { return linkState; }
+  // ms since the link was lost (or begin()), 0 while connected
+  uint32_t offlineFor() const;
+
+  const WifiLinkStats &stats() const { return counters; }
+  void printStats(Print &out) const;
+
+private:
+  const char *ssid;
+  const char *password;
+  WifiLinkCallback callback = nullptr;
+  WifiLinkState linkState = WIFI_LINK_IDLE;
+  WifiLinkStats counters = {};
+
+  // Written by the WiFi event task
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+  volatile bool eventUp = false;
+  volatile uint32_t disconnectEvents = 0;
+  uint8_t eventBssid[6] = {};
+  uint8_t eventChannel = 0;
+  uint8_t eventReason = 0;
+
+  // Cached AP, valid when cachedChannel != 0
+  uint8_t cachedBssid[6] = {};
+  uint8_t cachedChannel = 0;
+  uint8_t failedAttempts = 0;  // since the link was last up
+  bool attemptFast = false;
+
+  uint32_t startedAt = 0;     // begin()
+  uint32_t offlineSince = 0;
+  uint32_t attemptStart = 0;
+  uint32_t attemptDisconnects = 0;
+  uint32_t nextAttemptAt = 0;
+  uint32_t backoff = 0;       // 0 until the first failure
+  bool everConnected = false;
+
+  void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+  void startAttempt(uint32_t now);
+  void attemptFailed(uint32_t now);
+  void linkUp(uint32_t now);
+  void linkDown(uint32_t now);
+  void loadCache();
+  void saveCache();
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Incremental parser for SIM900 responses and unsolicited result codes.
+// Bytes from the modem UART are fed one at a time; complete lines are
+// classified by a small state machine and turned into typed events. All
+// text lands in fixed buffers, nothing is allocated and nothing is rescanned.
+//
+// SMS text bodies may span several lines. The first line after a +CMT,
+// +CMGL or +CMGR header is always body text; further lines are appended
+// until something that can't be body shows up (next +CMGL header, final
+// OK/ERROR, another URC) or flush() is called after the UART goes quiet.
+//
+// After AT+CMGS the modem asks for the SMS text with "> " and no line end;
+// that prompt is reported as soon as its space arrives.
+
+enum AtEventType : uint8_t {
+  AT_EVENT_OK,
+  AT_EVENT_ERROR,  // ERROR, +CMS ERROR, +CME ERROR
+  AT_EVENT_CMTI,   // new message stored: index
+  AT_EVENT_CMT,    // message delivered directly: sender, body
+  AT_EVENT_CMGL,   // one record of a list: index, status, sender, body
+  AT_EVENT_CMGR,   // single read message: status, sender, body
+  AT_EVENT_PROMPT, // "> ": the modem is waiting for SMS text
+};
+
+struct AtEvent {
+  AtEventType type;
+  int16_t index;       // CMTI / CMGL, -1 otherwise
+  char status[12];     // "REC UNREAD", ...
+  char sender[24];
+  char body[161];      // one SMS worth of text, lines joined with '\n'
+};
+
+typedef void (*AtEventHandler)(const AtEvent &ev);
+
+class AtParser {
+public:
+  explicit AtParser(AtEventHandler handler) : handler(handler) {}
+
+  void feed(char c) {
+    if (c == '\r') return;
+    if (c != '\n') {
+      if (c == ' ' && lineLen == 1 && line[0] == '>' && state == IDLE) {
+        lineLen = 0;
+        emit(AT_EVENT_PROMPT);
+        return;
+      }
+      if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+      return;
+    }
+    line[lineLen] = '\0';
+    onLine();
+    lineLen = 0;
+  }
+
+  // Emit a message whose body may still have been growing. Call when no
+  // byte has arrived for a few tens of milliseconds.
+  void flush() {
+    if (state == IN_BODY) emitPending();
+  }
+
+  // Forget any half-received response, e.g. after a command timeout
+  void reset() {
+    state = IDLE;
+    lineLen = 0;
+  }
+
+private:
+  enum State : uint8_t { IDLE, EXPECT_BODY, IN_BODY };
+
+  AtEventHandler handler;
+  char line[200];
+  uint8_t lineLen = 0;
+  State state = IDLE;
+  AtEvent pending;
+  uint8_t bodyLen = 0;
+
+  static bool startsWith(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+  }
+
+  // Copy the next comma-separated field (quotes stripped) into out and
+  // advance p past it.
+  static void nextField(const char *&p, char *out, size_t outLen) {
+    while (*p == ' ') p++;
+    size_t n = 0;
+    if (*p == '"') {
+      p++;
+      while (*p && *p != '"') {
+        if (n < outLen - 1) out[n++] = *p;
+        p++;
+      }
+      if (*p == '"') p++;
+    } else {
+      while (*p && *p != ',') {
+        if (n < outLen - 1) out[n++] = *p;
+        p++;
+      }
+    }
+    out[n] = '\0';
+    if (*p == ',') p++;
+  }
+
+  void emit(AtEventType type) {
+    AtEvent ev;
+    ev.type = type;
+    ev.index = -1;
+    ev.status[0] = ev.sender[0] = ev.body[0] = '\0';
+    if (type == AT_EVENT_CMTI) {
+      const char *p = strchr(line, ',');
+      ev.index = p ? atoi(p + 1) : -1;
+    }
+    handler(ev);
+  }
+
+  void emitPending() {
+    // Modems pad the end of a listing with a blank line
+    while (bodyLen && (pending.body[bodyLen - 1] == '\n' || pending.body[bodyLen - 1] == ' ')) bodyLen--;
+    pending.body[bodyLen] = '\0';
+    state = IDLE;
+    handler(pending);
+  }
+
+  void beginMessage(AtEventType type, const char *fields) {
+    if (state == IN_BODY) emitPending();
+    char scratch[24];
+    pending.type = type;
+    pending.index = -1;
+    pending.status[0] = pending.sender[0] = '\0';
+    bodyLen = 0;
+
+    const char *p = fields;
+    if (type == AT_EVENT_CMGL) {
+      nextField(p, scratch, sizeof(scratch));
+      pending.index = atoi(scratch);
+    }
+    if (type != AT_EVENT_CMT) nextField(p, pending.status, sizeof(pending.status));
+    nextField(p, pending.sender, sizeof(pending.sender));
+    state = EXPECT_BODY;
+  }
+
+  void appendBody() {
+    if (bodyLen && bodyLen < sizeof(pending.body) - 1) pending.body[bodyLen++] = '\n';
+    for (uint8_t i = 0; i < lineLen && bodyLen < sizeof(pending.body) - 1; i++) {
+      pending.body[bodyLen++] = line[i];
+    }
+  }
+
+  void onLine() {
+    if (state == EXPECT_BODY) {
+      appendBody();
+      state = IN_BODY;
+      return;
+    }
+
+    if (lineLen == 0) {
+      if (state == IN_BODY) appendBody();  // blank line inside a message
+      return;
+    }
+
+    if (strcmp(line, "OK") == 0) {
+      if (state == IN_BODY) emitPending();
+      emit(AT_EVENT_OK);
+    } else if (strcmp(line, "ERROR") == 0 || startsWith(line, "+CMS ERROR") || startsWith(line, "+CME ERROR")) {
+      if (state == IN_BODY) emitPending();
+      emit(AT_EVENT_ERROR);
+    } else if (startsWith(line, "+CMTI:")) {
+      if (state == IN_BODY) emitPending();
+      emit(AT_EVENT_CMTI);
+    } else if (startsWith(line, "+CMT:")) {
+      beginMessage(AT_EVENT_CMT, line + 5);
+    } else if (startsWith(line, "+CMGL:")) {
+      beginMessage(AT_EVENT_CMGL, line + 6);
+    } else if (startsWith(line, "+CMGR:")) {
+      beginMessage(AT_EVENT_CMGR, line + 6);
+    } else if (state == IN_BODY) {
+      appendBody();
+    }
+    // Anything else (command echo, +CSQ, RING, ...) is ignored
+  }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// One command table for every transport (SMS, WebSocket, Mega link, MQTT).
+//
+// Command names are hashed at compile time (FNV-1a, then a multiplicative
+// step into 32 slots) and the slot table is built by the compiler too; a
+// static_assert next to the table rejects any set of names that collides.
+// Dispatch uppercases and hashes the command word in one pass into a fixed
+// buffer, then does a single slot lookup and name compare: no String, no
+// heap, no if/else ladder. Handlers write their reply into the context and
+// the caller delivers it over the transport the command came in on.
+//
+// Each entry lists the sources allowed to run it. Only SMS from an admin
+// number and MQTT on a broker session with credentials are trusted; the
+// WebSocket port, the Mega's USB console and an anonymous broker are open
+// to anyone nearby, so they only get the harmless commands.
+
+enum CommandTransport : uint8_t {
+  TRANSPORT_SMS,
+  TRANSPORT_WEBSOCKET,
+  TRANSPORT_MEGA,
+  TRANSPORT_MQTT,
+};
+
+struct CommandContext {
+  CommandTransport transport;
+  uint8_t client;      // WebSocket client number
+  const char *replyTo; // MQTT command id
+  char args[48];       // text after the command word, trimmed
+  char reply[200];
+
+  // WebSocket and MQTT answers go to programs, SMS and the Mega to people
+  bool machineReply() const { return transport == TRANSPORT_WEBSOCKET || transport == TRANSPORT_MQTT; }
+
+  // Plain text for SMS and the Mega console, wsText (JSON or a short token) for
+  // WebSocket and MQTT clients; text is used everywhere when wsText is null.
+  void respond(const char *text, const char *wsText = nullptr) {
+    strlcpy(reply, (machineReply() && wsText) ? wsText : text, sizeof(reply));
+  }
+
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(reply, sizeof(reply), fmt, ap);
+    va_end(ap);
+  }
+};
+
+typedef void (*CommandHandler)(CommandContext &ctx);
+
+// Command sources, one bit each
+const uint8_t COMMAND_VIA_SMS = 0x01;        // admin numbers only reach dispatch
+const uint8_t COMMAND_VIA_WEBSOCKET = 0x02;
+const uint8_t COMMAND_VIA_MEGA = 0x04;       // the Mega's USB console
+const uint8_t COMMAND_VIA_MQTT = 0x08;       // broker session with credentials
+const uint8_t COMMAND_VIA_MQTT_ANON = 0x10;  // broker without credentials
+const uint8_t COMMAND_VIA_ADMIN = COMMAND_VIA_SMS | COMMAND_VIA_MQTT;
+const uint8_t COMMAND_VIA_ANY = 0x1F;
+
+struct CommandEntry {
+  const char *name;
+  uint32_t hash;
+  CommandHandler handler;
+  bool alwaysAllowed;  // still runs while the system is shut down
+  uint8_t via;         // COMMAND_VIA_* sources allowed to run it
+};
+
+// The source bit of a transport; authenticated says whether the MQTT
+// session logged in with credentials
+inline uint8_t commandSource(CommandTransport transport, bool authenticated) {
+  switch (transport) {
+    case TRANSPORT_SMS: return COMMAND_VIA_SMS;
+    case TRANSPORT_WEBSOCKET: return COMMAND_VIA_WEBSOCKET;
+    case TRANSPORT_MEGA: return COMMAND_VIA_MEGA;
+    case TRANSPORT_MQTT: return authenticated ? COMMAND_VIA_MQTT : COMMAND_VIA_MQTT_ANON;
+  }
+  return 0;
+}
+
+const uint8_t COMMAND_SLOTS = 32;
+const uint32_t COMMAND_HASH_SEED = 71;  // picked so the current names don't collide
+const uint8_t COMMAND_MAX_WORD = 16;
+
+constexpr uint32_t commandHashStep(uint32_t h, char c) {
+  return (h ^ (uint8_t)c) * 16777619u;
+}
+
+constexpr uint32_t commandHash(const char *s, uint32_t h = 2166136261u) {
+  return *s ? commandHash(s + 1, commandHashStep(h, *s)) : h;
+}
+
+constexpr uint8_t commandSlot(uint32_t hash) {
+  return (uint32_t)(hash * COMMAND_HASH_SEED) >> 27;
+}
+
+// 1-based index of the entry that owns slot, 0 if none
+constexpr uint8_t commandSlotOwner(const CommandEntry *table, uint8_t n, uint8_t slot, uint8_t i = 0) {
+  return i == n ? 0 : commandSlot(table[i].hash) == slot ? i + 1 : commandSlotOwner(table, n, slot, i + 1);
+}
+
+constexpr bool commandSlotsUnique(const CommandEntry *table, uint8_t n, uint8_t i = 0, uint8_t j = 1) {
+  return i >= n ? true
+       : j >= n ? commandSlotsUnique(table, n, i + 1, i + 2)
+       : commandSlot(table[i].hash) != commandSlot(table[j].hash) && commandSlotsUnique(table, n, i, j + 1);
+}
+
+#define COMMAND(name, handler, alwaysAllowed, via) { name, commandHash(name), handler, alwaysAllowed, via }
+#define COMMAND_COUNT(table) (uint8_t)(sizeof(table) / sizeof(table[0]))
+#define COMMAND_SLOT_(t, s) commandSlotOwner(t, COMMAND_COUNT(t), s)
+#define COMMAND_SLOTS_8_(t, b) \
+  COMMAND_SLOT_(t, b), COMMAND_SLOT_(t, b + 1), COMMAND_SLOT_(t, b + 2), COMMAND_SLOT_(t, b + 3), \
+  COMMAND_SLOT_(t, b + 4), COMMAND_SLOT_(t, b + 5), COMMAND_SLOT_(t, b + 6), COMMAND_SLOT_(t, b + 7)
+// Initialiser for a uint8_t[COMMAND_SLOTS] slot table, evaluated at compile time
+#define COMMAND_SLOT_TABLE(t) \
+  { COMMAND_SLOTS_8_(t, 0), COMMAND_SLOTS_8_(t, 8), COMMAND_SLOTS_8_(t, 16), COMMAND_SLOTS_8_(t, 24) }
+
+// Split "  toggle  now " into an uppercased command word and trimmed args,
+// and find its entry. Returns null for unknown or overlong words.
+inline const CommandEntry *lookupCommand(const CommandEntry *table, const uint8_t *slots,
+                                         const char *text, size_t len, CommandContext &ctx) {
+  size_t i = 0;
+  while (i < len && isspace((uint8_t)text[i])) i++;
+
+  char word[COMMAND_MAX_WORD + 1];
+  uint8_t n = 0;
+  uint32_t h = 2166136261u;
+  for (; i < len && text[i] && !isspace((uint8_t)text[i]); i++) {
+    if (n == COMMAND_MAX_WORD) return nullptr;
+    char c = toupper((uint8_t)text[i]);
+    word[n++] = c;
+    h = commandHashStep(h, c);
+  }
+  word[n] = '\0';
+
+  while (i < len && isspace((uint8_t)text[i])) i++;
+  size_t a = 0;
+  for (; i < len && text[i] && a < sizeof(ctx.args) - 1; i++) ctx.args[a++] = text[i];
+  while (a && isspace((uint8_t)ctx.args[a - 1])) a--;
+  ctx.args[a] = '\0';
+
+  uint8_t owner = slots[commandSlot(h)];
+  if (!owner || strcmp(table[owner - 1].name, word) != 0) return nullptr;
+  return &table[owner - 1];
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+
+// Local access-decision cache for RFID UIDs and keypad PINs.
+// Open-addressing (linear probe) table keyed by a 64-bit FNV-1a hash of the
+// credential, so PINs are never stored in clear. Grants and denials both
+// expire; the server stays authoritative and every hit is re-confirmed
+// asynchronously by the caller, which feeds the answer back via store().
+// The table is persisted to NVS so decisions survive a reboot.
+
+static const char CREDCACHE_NVS_NAMESPACE[] = "credcache";
+static const char CREDCACHE_NVS_KEY[] = "table";
+
+enum CredentialKind : uint8_t {
+  CRED_RFID = 'r',
+  CRED_KEYPAD = 'k',
+};
+
+enum CredentialState : uint8_t {
+  CRED_UNKNOWN = 0,
+  CRED_GRANTED,
+  CRED_DENIED,
+};
+
+class CredentialCache {
+public:
+  static const uint16_t CAPACITY = 128;  // power of two
+  static const uint32_t GRANT_TTL_S = 12UL * 3600;
+  static const uint32_t DENY_TTL_S = 120;
+
+  void begin() {
+    Preferences prefs;
+    if (!prefs.begin(CREDCACHE_NVS_NAMESPACE, true)) return;
+    size_t len = prefs.getBytesLength(CREDCACHE_NVS_KEY);
+    if (len > 0 && len <= sizeof(scratch) && len % sizeof(Entry) == 0) {
+      prefs.getBytes(CREDCACHE_NVS_KEY, scratch, len);
+      uint32_t now = nowSeconds();
+      // Stored expiries are remaining seconds, rebase onto this boot's clock
+      for (size_t i = 0; i < len / sizeof(Entry); i++) {
+        insert(scratch[i].key, (CredentialState)scratch[i].state, now + scratch[i].expires);
+      }
+    }
+    prefs.end();
+    dirty = false;
+    Serial.print("[CACHE] Loaded credentials: ");
+    Serial.println(liveCount);
+  }
+
+  CredentialState lookup(CredentialKind kind, const char *value) {
+    int16_t i = find(hashOf(kind, value));
+    if (i < 0 || expired(table[i])) {
+      misses++;
+      return CRED_UNKNOWN;
+    }
+    hits++;
+    return table[i].state == SLOT_GRANTED ? CRED_GRANTED : CRED_DENIED;
+  }
+
+  void store(CredentialKind kind, const char *value, bool granted) {
+    uint32_t ttl = granted ? GRANT_TTL_S : DENY_TTL_S;
+    insert(hashOf(kind, value), granted ? CRED_GRANTED : CRED_DENIED, nowSeconds() + ttl);
+    dirty = true;
+  }
+
+  void forget(CredentialKind kind, const char *value) {
+    int16_t i = find(hashOf(kind, value));
+    if (i < 0) return;
+    table[i].state = SLOT_TOMBSTONE;
+    liveCount--;
+    dirty = true;
+  }
+
+  // Periodic housekeeping: drop expired entries and tombstones, then write
+  // the table to NVS if it changed. Call from a slow timer, not per loop.
+  void maintain() {
+    uint16_t n = 0;
+    uint32_t now = nowSeconds();
+    for (uint16_t i = 0; i < CAPACITY; i++) {
+      if (isLive(table[i]) && !expired(table[i])) scratch[n++] = table[i];
+      else if (isLive(table[i])) dirty = true;
+    }
+    if (!dirty) return;
+
+    memset(table, 0, sizeof(table));
+    liveCount = 0;
+    for (uint16_t i = 0; i < n; i++) insert(scratch[i].key, (CredentialState)scratch[i].state, scratch[i].expires);
+
+    for (uint16_t i = 0; i < n; i++) scratch[i].expires -= now;
+    Preferences prefs;
+    if (prefs.begin(CREDCACHE_NVS_NAMESPACE, false)) {
+      prefs.putBytes(CREDCACHE_NVS_KEY, scratch, n * sizeof(Entry));
+      prefs.end();
+    }
+    dirty = false;
+  }
+
+  uint16_t size() const { return liveCount; }
+  uint32_t hitCount() const { return hits; }
+  uint32_t missCount() const { return misses; }
+
+private:
+  // Slot states; live slots reuse the CredentialState values
+  static const uint8_t SLOT_EMPTY = 0;
+  static const uint8_t SLOT_GRANTED = CRED_GRANTED;
+  static const uint8_t SLOT_DENIED = CRED_DENIED;
+  static const uint8_t SLOT_TOMBSTONE = 0xFF;
+
+  struct Entry {
+    uint64_t key;
+    uint32_t expires;  // seconds since boot
+    uint8_t state;
+  };
+
+  Entry table[CAPACITY] = {};
+  Entry scratch[CAPACITY];  // persistence / rehash buffer, kept off the stack
+  uint16_t liveCount = 0;
+  bool dirty = false;
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+
+  // esp_timer doesn't wrap like millis() does after 49 days
+  static uint32_t nowSeconds() { return (uint32_t)(esp_timer_get_time() / 1000000LL); }
+
+  static bool isLive(const Entry &e) { return e.state == SLOT_GRANTED || e.state == SLOT_DENIED; }
+  bool expired(const Entry &e) const { return (int32_t)(nowSeconds() - e.expires) >= 0; }
+
+  static uint64_t hashOf(CredentialKind kind, const char *value) {
+    uint64_t h = 14695981039346656037ULL;
+    h = (h ^ (uint8_t)kind) * 1099511628211ULL;
+    while (*value) h = (h ^ (uint8_t)*value++) * 1099511628211ULL;
+    return h ? h : 1;  // 0 marks an empty key
+  }
+
+  int16_t find(uint64_t key) const {
+    uint16_t i = key & (CAPACITY - 1);
+    for (uint16_t probes = 0; probes < CAPACITY; probes++) {
+      const Entry &e = table[i];
+      if (e.state == SLOT_EMPTY) return -1;
+      if (isLive(e) && e.key == key) return i;
+      i = (i + 1) & (CAPACITY - 1);
+    }
+    return -1;
+  }
+
+  void insert(uint64_t key, CredentialState state, uint32_t expires) {
+    int16_t i = find(key);
+    if (i < 0) {
+      i = freeSlot(key);
+      liveCount++;
+    }
+    table[i].key = key;
+    table[i].state = state;
+    table[i].expires = expires;
+  }
+
+  // First empty/tombstone slot on key's probe path; when the table is full
+  // the entry closest to expiry is evicted.
+  int16_t freeSlot(uint64_t key) {
+    uint16_t i = key & (CAPACITY - 1);
+    for (uint16_t probes = 0; probes < CAPACITY; probes++) {
+      if (!isLive(table[i])) return i;
+      i = (i + 1) & (CAPACITY - 1);
+    }
+    uint16_t victim = 0;
+    for (uint16_t j = 1; j < CAPACITY; j++) {
+      if ((int32_t)(table[j].expires - table[victim].expires) < 0) victim = j;
+    }
+    liveCount--;
+    return victim;
+  }
+};
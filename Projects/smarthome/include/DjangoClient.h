@@ -0,0 +1,227 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <DjangoLink.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+// Asynchronous Django client.
+// Callers enqueue a POST and return immediately; a worker task pinned to the
+// other core does the HTTP round trip. Completions are queued back and their
+// callbacks run from poll() on the loop task, so callbacks may touch the
+// servo, WebSocket server and serial ports like any other loop() code.
+// The worker owns the keep-alive DjangoLink, so requests share one socket.
+// setTransport() swaps it for another Transport (MQTT); the worker then
+// also polls it between requests so pushed messages keep flowing.
+
+// Lower value is served first
+enum DjangoPriority : uint8_t {
+  DJANGO_PRIO_AUTH = 0,    // keypad / RFID checks, somebody is at the door
+  DJANGO_PRIO_SENSOR = 1,  // telemetry, may be dropped
+};
+
+// Negative codes in addition to HTTPClient's HTTPC_ERROR_* values
+const int DJANGO_ERR_OFFLINE = -100;  // WiFi not connected
+const int DJANGO_ERR_EXPIRED = -101;  // timed out while still queued
+const int DJANGO_ERR_EVICTED = -102;  // pushed out of a full queue by an auth request
+
+struct DjangoResponse;
+typedef void (*DjangoCallback)(const DjangoResponse &res);
+
+struct DjangoResponse {
+  DjangoCallback cb;
+  int code;           // HTTP status, or a negative error
+  char context[32];   // echoed from post(), e.g. the RFID UID
+  char body[256];     // response body, truncated to fit
+};
+
+class DjangoClient {
+public:
+  static const uint8_t QUEUE_DEPTH = 8;
+  static const size_t MAX_PATH = 48;
+  static const size_t MAX_BODY = 1024;  // fits a batched sensor upload
+
+  static const uint32_t POLL_MS = 50;  // worker's transport poll while idle
+
+  DjangoClient(const char *host, uint16_t port) : link(host, port) {}
+
+  // Before begin(); the transport is used from the worker task only
+  void setTransport(Transport &t) { transport = &t; }
+
+  // Starts the worker. Arduino's loop() runs on core 1, so the default puts
+  // HTTP on core 0 next to the WiFi stack.
+  bool begin(BaseType_t core = 0) {
+    lock = xSemaphoreCreateMutex();
+    work = xSemaphoreCreateCounting(QUEUE_DEPTH, 0);
+    done = xQueueCreate(QUEUE_DEPTH, sizeof(DjangoResponse));
+    if (!lock || !work || !done) return false;
+    return xTaskCreatePinnedToCore(workerTask, "django", 6144, this, 1, nullptr, core) == pdPASS;
+  }
+
+  // Enqueue a JSON POST. timeoutMs covers queue wait plus the HTTP exchange.
+  // When the queue is full a sensor request is dropped, and an auth request
+  // evicts the oldest queued sensor request, whose callback then gets
+  // DJANGO_ERR_EVICTED. cb may be null for fire-and-forget posts.
+  // Returns false if the request was dropped.
+  bool post(const char *path, const char *body, DjangoPriority prio, uint32_t timeoutMs,
+            DjangoCallback cb, const char *context = "") {
+    if (strlen(path) >= MAX_PATH || strlen(body) >= MAX_BODY) {
+      Serial.println("[DJANGO] Request too large");
+      return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool isNew = true;
+    Request *slot = freeSlot();
+    if (!slot && prio == DJANGO_PRIO_AUTH) {
+      slot = oldestSensor();
+      if (slot && evict(*slot)) {
+        droppedCount++;
+        isNew = false;  // evicted request's work token is reused
+      } else {
+        slot = nullptr;
+      }
+    }
+    if (!slot) {
+      droppedCount++;
+      xSemaphoreGive(lock);
+      return false;
+    }
+
+    slot->used = true;
+    slot->priority = prio;
+    slot->seq = nextSeq++;
+    slot->deadline = millis() + timeoutMs;
+    slot->cb = cb;
+    strlcpy(slot->path, path, sizeof(slot->path));
+    strlcpy(slot->body, body, sizeof(slot->body));
+    strlcpy(slot->context, context, sizeof(slot->context));
+    xSemaphoreGive(lock);
+
+    if (isNew) xSemaphoreGive(work);
+    return true;
+  }
+
+  // Run completion callbacks. Call from loop().
+  void poll() {
+    DjangoResponse res;
+    while (xQueueReceive(done, &res, 0) == pdTRUE) {
+      if (res.cb) res.cb(res);
+    }
+  }
+
+  uint32_t dropped() const { return droppedCount; }
+
+  // Written by the worker; fine for reporting, not for exact accounting
+  const DjangoLinkStats &linkStats() const { return link.stats(); }
+
+  void printStats(Print &out) const {
+    transport->printStats(out);
+    out.printf("[HTTP] queue dropped=%lu\n", (unsigned long)droppedCount);
+  }
+
+private:
+  struct Request {
+    bool used;
+    DjangoPriority priority;
+    uint32_t seq;
+    uint32_t deadline;
+    DjangoCallback cb;
+    char path[MAX_PATH];
+    char body[MAX_BODY];
+    char context[32];
+  };
+
+  DjangoLink link;
+  Transport *transport = &link;
+  Request queue[QUEUE_DEPTH] = {};
+  SemaphoreHandle_t lock = nullptr;
+  SemaphoreHandle_t work = nullptr;
+  QueueHandle_t done = nullptr;
+  uint32_t nextSeq = 0;
+  volatile uint32_t droppedCount = 0;
+
+  Request *freeSlot() {
+    for (uint8_t i = 0; i < QUEUE_DEPTH; i++) {
+      if (!queue[i].used) return &queue[i];
+    }
+    return nullptr;
+  }
+
+  Request *oldestSensor() {
+    Request *oldest = nullptr;
+    for (uint8_t i = 0; i < QUEUE_DEPTH; i++) {
+      Request &r = queue[i];
+      if (!r.used || r.priority != DJANGO_PRIO_SENSOR) continue;
+      if (!oldest || (int32_t)(r.seq - oldest->seq) < 0) oldest = &r;
+    }
+    return oldest;
+  }
+
+  // Complete a queued request that's being pushed out, so its caller isn't
+  // left waiting forever. Fails if the done queue has no room right now.
+  bool evict(const Request &req) {
+    if (!req.cb) return true;
+    DjangoResponse res;
+    res.cb = req.cb;
+    res.code = DJANGO_ERR_EVICTED;
+    res.body[0] = '\0';
+    strlcpy(res.context, req.context, sizeof(res.context));
+    return xQueueSend(done, &res, 0) == pdTRUE;
+  }
+
+  // Highest priority first, FIFO within a priority. Copies out and frees the
+  // slot so post() can reuse it while the request is in flight.
+  bool takeNext(Request &out) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    Request *best = nullptr;
+    for (uint8_t i = 0; i < QUEUE_DEPTH; i++) {
+      Request &r = queue[i];
+      if (!r.used) continue;
+      if (!best || r.priority < best->priority ||
+          (r.priority == best->priority && (int32_t)(r.seq - best->seq) < 0)) {
+        best = &r;
+      }
+    }
+    if (best) {
+      out = *best;
+      best->used = false;
+    }
+    xSemaphoreGive(lock);
+    return best != nullptr;
+  }
+
+  void execute(const Request &req, DjangoResponse &res) {
+    res.cb = req.cb;
+    res.body[0] = '\0';
+    strlcpy(res.context, req.context, sizeof(res.context));
+
+    int32_t remaining = (int32_t)(req.deadline - millis());
+    if (remaining <= 0) {
+      res.code = DJANGO_ERR_EXPIRED;
+      return;
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+      res.code = DJANGO_ERR_OFFLINE;
+      return;
+    }
+
+    res.code = transport->post(req.path, req.body, res.body, sizeof(res.body), remaining);
+  }
+
+  static void workerTask(void *arg) {
+    DjangoClient *self = static_cast<DjangoClient *>(arg);
+    Request req;
+    DjangoResponse res;
+    for (;;) {
+      bool queued = xSemaphoreTake(self->work, pdMS_TO_TICKS(POLL_MS)) == pdTRUE;
+      if (WiFi.status() == WL_CONNECTED) self->transport->poll();
+      if (!queued || !self->takeNext(req)) continue;
+      self->execute(req, res);
+      if (req.cb) xQueueSend(self->done, &res, portMAX_DELAY);
+    }
+  }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Always-on timing for the handlers loop() runs inline.
+// Each section keeps a histogram of CPU cycles in log-spaced buckets: four
+// buckets per power of two, so a percentile read back is within ~20% of
+// the real value. Recording one sample is a cycle-counter read, a CLZ and
+// an increment; there is nothing to turn off in production.
+
+enum LoopSection : uint8_t {
+  LOOP_SCHEDULER,
+  LOOP_HTTP_CALLBACKS,
+  LOOP_WEBSOCKET,
+  LOOP_MEGA,
+  LOOP_RFID,
+  LOOP_MODEM,
+  LOOP_SENSORS,
+  LOOP_TOTAL,  // the whole loop() pass
+  LOOP_SECTIONS
+};
+
+static const char *const LOOP_SECTION_NAMES[LOOP_SECTIONS] = {
+  "sched", "http_cb", "ws", "mega", "rfid", "modem", "sensors", "loop",
+};
+
+enum MetricCounter : uint8_t {
+  METRIC_SMS_SENT,
+  METRIC_SMS_FAILED,
+  METRIC_COUNTERS
+};
+
+class LoopMetrics {
+public:
+  static const uint8_t BUCKETS = 124;  // exact below 8 cycles, then 4 per octave up to 2^32
+
+  // Cycle count to pass to lap() for the first section
+  static uint32_t now() { return ESP.getCycleCount(); }
+
+  // Records the time since start against section and returns the current
+  // cycle count, so back-to-back sections need one counter read each.
+  uint32_t lap(LoopSection section, uint32_t start) {
+    uint32_t t = ESP.getCycleCount();
+    record(section, t - start);
+    return t;
+  }
+
+  void record(LoopSection section, uint32_t cycles) {
+    Histogram &h = sections[section];
+    h.buckets[bucketOf(cycles)]++;
+    h.count++;
+    if (cycles > h.max) h.max = cycles;
+  }
+
+  void count(MetricCounter counter) { counters[counter]++; }
+  uint32_t counter(MetricCounter counter) const { return counters[counter]; }
+
+  // Upper edge of the bucket holding the given percentile, in cycles
+  uint32_t percentile(LoopSection section, uint16_t permille) const {
+    const Histogram &h = sections[section];
+    if (!h.count) return 0;
+    uint32_t rank = (uint32_t)(((uint64_t)h.count * permille + 999) / 1000);
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++) {
+      seen += h.buckets[b];
+      if (seen >= rank) return min(bucketTop(b), h.max);
+    }
+    return h.max;
+  }
+
+  uint32_t samples(LoopSection section) const { return sections[section].count; }
+  uint32_t maxCycles(LoopSection section) const { return sections[section].max; }
+
+  // Appends "loop":{"ws":{"n":..,"p50":..,"p99":..,"max":..},...} with times
+  // in microseconds. Returns the length written, clamped to len - 1.
+  size_t writeJson(char *out, size_t len) const {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    size_t n = append(out, len, 0, "\"loop\":{");
+    for (uint8_t s = 0; s < LOOP_SECTIONS; s++) {
+      LoopSection section = (LoopSection)s;
+      n = append(out, len, n, "%s\"%s\":{\"n\":%lu,\"p50\":%lu,\"p99\":%lu,\"max\":%lu}",
+                 s ? "," : "", LOOP_SECTION_NAMES[s], (unsigned long)samples(section),
+                 (unsigned long)(percentile(section, 500) / mhz),
+                 (unsigned long)(percentile(section, 990) / mhz),
+                 (unsigned long)(maxCycles(section) / mhz));
+    }
+    return append(out, len, n, "}");
+  }
+
+  void reset() {
+    memset(sections, 0, sizeof(sections));
+  }
+
+  // snprintf at out + n that never runs past len: returns the new length,
+  // clamped to len - 1, and does nothing once the buffer is full
+  static size_t append(char *out, size_t len, size_t n, const char *fmt, ...)
+      __attribute__((format(printf, 4, 5))) {
+    if (n >= len - 1) return n;
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(out + n, len - n, fmt, ap);
+    va_end(ap);
+    if (w < 0) return n;
+    return (size_t)w < len - n ? n + w : len - 1;
+  }
+
+private:
+  struct Histogram {
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[BUCKETS];
+  };
+
+  Histogram sections[LOOP_SECTIONS] = {};
+  uint32_t counters[METRIC_COUNTERS] = {};
+
+  static uint8_t bucketOf(uint32_t cycles) {
+    if (cycles < 8) return cycles;
+    uint8_t octave = 31 - __builtin_clz(cycles);
+    return (octave - 1) * 4 + ((cycles >> (octave - 2)) & 3);
+  }
+
+  static uint32_t bucketTop(uint8_t b) {
+    if (b < 8) return b;
+    uint8_t octave = (b >> 2) + 1;
+    uint32_t step = 1UL << (octave - 2);
+    return ((uint32_t)(4 + (b & 3)) << (octave - 2)) + (step - 1);
+  }
+
+};
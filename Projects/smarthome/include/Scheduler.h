@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cooperative timer scheduler driven by millis().
+// loop() calls tick(); due callbacks run inline on the loop task, so they
+// must be short and must never delay(). Timers live in a fixed slot table
+// (no heap), and tick() returns after one compare when nothing is due.
+
+typedef void (*TimerCallback)(uint32_t arg);
+
+// Handle returned by after()/every(). 0 is never a live timer, so a
+// TimerId can be zero-initialised and cancelled unconditionally.
+typedef uint16_t TimerId;
+
+class Scheduler {
+public:
+  static const uint8_t MAX_TIMERS = 16;
+
+  // Run cb once, delayMs from now.
+  TimerId after(uint32_t delayMs, TimerCallback cb, uint32_t arg = 0) {
+    return add(delayMs, 0, cb, arg);
+  }
+
+  // Run cb every periodMs, first run periodMs from now.
+  TimerId every(uint32_t periodMs, TimerCallback cb, uint32_t arg = 0) {
+    return add(periodMs, periodMs, cb, arg);
+  }
+
+  // Cancel a pending timer and clear the handle. Safe on stale or 0 ids,
+  // and safe to call from inside the timer's own callback.
+  void cancel(TimerId &id) {
+    Timer *t = lookup(id);
+    if (t) t->cb = nullptr;
+    id = 0;
+  }
+
+  bool pending(TimerId id) const {
+    return const_cast<Scheduler *>(this)->lookup(id) != nullptr;
+  }
+
+  // Milliseconds until the earliest pending timer (0 if one is overdue).
+  uint32_t untilNext() const {
+    if (!anyActive) return UINT32_MAX;
+    int32_t d = (int32_t)(nextDue - millis());
+    return d > 0 ? (uint32_t)d : 0;
+  }
+
+  void tick() {
+    uint32_t now = millis();
+    if (!anyActive || (int32_t)(now - nextDue) < 0) return;
+
+    for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+      Timer &t = timers[i];
+      if (!t.cb || (int32_t)(now - t.due) < 0) continue;
+
+      TimerCallback cb = t.cb;
+      uint32_t arg = t.arg;
+      if (t.period) {
+        t.due += t.period;
+        // Don't try to catch up on missed periods after a long stall
+        if ((int32_t)(now - t.due) >= 0) t.due = now + t.period;
+      } else {
+        t.cb = nullptr;
+      }
+      cb(arg);
+    }
+    recomputeNextDue();
+  }
+
+private:
+  struct Timer {
+    uint32_t due;
+    uint32_t period;
+    TimerCallback cb;
+    uint32_t arg;
+    uint8_t generation;
+  };
+
+  Timer timers[MAX_TIMERS] = {};
+  uint32_t nextDue = 0;
+  bool anyActive = false;
+
+  TimerId add(uint32_t delayMs, uint32_t periodMs, TimerCallback cb, uint32_t arg) {
+    for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+      Timer &t = timers[i];
+      if (t.cb) continue;
+      t.due = millis() + delayMs;
+      t.period = periodMs;
+      t.cb = cb;
+      t.arg = arg;
+      if (++t.generation == 0) t.generation = 1;
+      if (!anyActive || (int32_t)(t.due - nextDue) < 0) nextDue = t.due;
+      anyActive = true;
+      return ((TimerId)t.generation << 8) | i;
+    }
+    Serial.println("[SCHED] Timer table full");
+    return 0;
+  }
+
+  Timer *lookup(TimerId id) {
+    uint8_t slot = id & 0xFF;
+    uint8_t generation = id >> 8;
+    if (generation == 0 || slot >= MAX_TIMERS) return nullptr;
+    Timer &t = timers[slot];
+    return (t.cb && t.generation == generation) ? &t : nullptr;
+  }
+
+  void recomputeNextDue() {
+    anyActive = false;
+    for (uint8_t i = 0; i < MAX_TIMERS; i++) {
+      if (!timers[i].cb) continue;
+      if (!anyActive || (int32_t)(timers[i].due - nextDue) < 0) nextDue = timers[i].due;
+      anyActive = true;
+    }
+  }
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// DHT sampling on its own task.
+// A DHT read is an ~20 ms start pulse followed by ~4 ms of bit-banging
+// with interrupts off. Here that happens on a separate task every
+// SAMPLE_MS (the DHT11 can't be read faster than once a second), where
+// the start pulse is a vTaskDelay instead of a busy wait in loop(). A
+// failed read is retried after RETRY_MS. Consumers only ever copy the
+// last good reading, so STATUS, HTTP posts and the Mega forward cost a
+// critical section, not a sensor read.
+
+enum SensorQuality : uint8_t {
+  SENSOR_NONE,   // no good read since boot
+  SENSOR_OK,
+  SENSOR_STALE,  // last good read is older than STALE_MS
+};
+
+struct SensorReading {
+  uint32_t seq;         // bumped for every good read
+  uint32_t millisAt;    // millis() of the good read
+  float temperature;
+  float humidity;
+  uint16_t failures;    // failed reads since the last good one
+  SensorQuality quality;
+};
+
+struct SensorStats {
+  uint32_t reads;
+  uint32_t failures;
+};
+
+class SensorService {
+public:
+  static const uint32_t SAMPLE_MS = 2000;
+  static const uint32_t RETRY_MS = 1100;
+  static const uint32_t STALE_MS = 10000;
+
+  explicit SensorService(DHT &dht) : dht(dht) {}
+
+  // On the app core, just above the loop task: loop() never blocks, so a
+  // lower priority would starve, and the interrupts-off window stays off
+  // the WiFi core. The task sleeps through the start pulse, so loop()
+  // only loses the ~4 ms transfer.
+  bool begin(BaseType_t core = 1) {
+    dht.begin();
+    return xTaskCreatePinnedToCore(samplerTask, "dht", 3072, this, 2, &task, core) == pdPASS;
+  }
+
+  SensorReading latest() {
+    portENTER_CRITICAL(&mux);
+    SensorReading r = reading;
+    portEXIT_CRITICAL(&mux);
+    if (r.quality == SENSOR_OK && millis() - r.millisAt > STALE_MS) r.quality = SENSOR_STALE;
+    return r;
+  }
+
+  SensorStats stats() {
+    portENTER_CRITICAL(&mux);
+    SensorStats s = counters;
+    portEXIT_CRITICAL(&mux);
+    return s;
+  }
+
+private:
+  DHT &dht;
+  TaskHandle_t task = nullptr;
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+  SensorReading reading = {};
+  SensorStats counters = {};
+
+  // One forced read; both values come from the same transfer
+  bool sample() {
+    bool ok = dht.read(true);
+    float t = ok ? dht.readTemperature() : NAN;
+    float h = ok ? dht.readHumidity() : NAN;
+    ok = !isnan(t) && !isnan(h);
+
+    portENTER_CRITICAL(&mux);
+    counters.reads++;
+    if (ok) {
+      reading.seq++;
+      reading.millisAt = millis();
+      reading.temperature = t;
+      reading.humidity = h;
+      reading.failures = 0;
+      reading.quality = SENSOR_OK;
+    } else {
+      counters.failures++;
+      if (reading.failures < 0xFFFF) reading.failures++;
+    }
+    portEXIT_CRITICAL(&mux);
+    return ok;
+  }
+
+  static void samplerTask(void *arg) {
+    SensorService *self = static_cast<SensorService *>(arg);
+    for (;;) {
+      bool ok = self->sample();
+      vTaskDelay(pdMS_TO_TICKS(ok ? SAMPLE_MS : RETRY_MS));
+    }
+  }
+};
@@ -9,11 +9,27 @@
 #define TINY_GSM_MODEM_SIM900
 #include <TinyGsmClient.h>  // GSM library
 #include <HardwareSerial.h>
+#include "Scheduler.h"
+#include "DjangoClient.h"
+#include "CredentialCache.h"
+#include <SensorBuffer.h>
+#include <SensorAggregator.h>
+#include <MegaLink.h>
+#include <CardReader.h>
+#include "AtParser.h"
+#include "CommandRegistry.h"
+#include "LoopMetrics.h"
+#include "SensorService.h"
+#include <WifiLink.h>
+#ifdef USE_MQTT
+#include <MqttLink.h>
+#endif
 
 // DHT setup
 #define DHTPIN 4
 #define DHTTYPE DHT11
 DHT dht(DHTPIN, DHTTYPE);
+SensorService sensorService(dht);  // samples in the background, see SensorService.h
 
 
 #define RX1 26
@@ -23,6 +39,11 @@ DHT dht(DHTPIN, DHTTYPE);
 
 HardwareSerial SerialMega(1);
 
+// Framed link to the Mega; starts at 9600 and negotiates up to this
+const uint32_t MEGA_LINK_BAUD = 115200;
+void setMegaBaud(uint32_t baud) { SerialMega.updateBaudRate(baud); }
+MegaLink megaLink(SerialMega, setMegaBaud);
+
 // Relay (bulb)
 #define RELAY_PIN 21
 bool bulbState = false;
@@ -34,13 +55,21 @@ Servo doorServo;  // Create servo object
 // RFID (RC522)
 #define RST_PIN 22
 #define SS_PIN 5
+#define RFID_IRQ_PIN 34  // input-only; the RC522 drives it push-pull
 MFRC522 mfrc522(SS_PIN, RST_PIN);
+CardReader cardReader(mfrc522, RFID_IRQ_PIN);
 
 #define PWR_PIN 4      // For power management
 
+// Build with -DENABLE_GSM to bring the SIM900 up at boot (see gsmTask())
+#if defined(ENABLE_GSM) && PWR_PIN == DHTPIN
+#error "PWR_PIN and DHTPIN are both GPIO 4; move the modem power line before enabling GSM"
+#endif
+
 // WiFi credentials
 const char* ssid = "sysCall";
 const char* password = "00000000";
+WifiLink wifiLink(ssid, password);  // reconnects in the background (see WifiLink.h)
 
 const int buzzerPin = 14;
 const int grantedBeepDuration = 300; // ms for access granted
@@ -50,19 +79,117 @@ const int deniedBeepDuration = 1000; // ms for access denied
 #define DENIED_LED 33
 TinyGsm modem(Serial2);
 
-bool gsmInitialized = false;
+bool gsmInitialized = false;      // loop() side: modem may be used
+volatile bool gsmReady = false;   // set by the GSM task once registered
+
+// Staged boot: setup() brings up the door (servo, RFID, Mega link,
+// credential cache) and returns; WiFi, the WebSocket server and GSM come up
+// behind it and flag when they're ready.
+bool webSocketStarted = false;
+bool firstCardLogged = false;
+
+// Modem output is parsed incrementally; see AtParser.h
+void onModemEvent(const AtEvent &ev);
+AtParser modemParser(onModemEvent);
+unsigned long lastModemByteTime = 0;
+
+// SMS intake is driven by +CMTI/+CMT URCs. The modem handles one AT command
+// at a time, so reads, deletes, sends and the occasional full listing queue
+// up as jobs and run one after another without blocking loop().
+enum ModemJobType : uint8_t { MODEM_JOB_READ, MODEM_JOB_DELETE, MODEM_JOB_LIST, MODEM_JOB_SEND };
+struct ModemJob {
+  ModemJobType type;
+  int16_t index;
+};
+const uint8_t MODEM_JOB_QUEUE_SIZE = 8;
+ModemJob modemJobs[MODEM_JOB_QUEUE_SIZE];
+uint8_t modemJobHead = 0;
+uint8_t modemJobCount = 0;
+bool modemBusy = false;        // AT command sent, waiting for OK/ERROR
+bool modemJobRunning = false;  // modemJobs[modemJobHead] has been started
+bool modemJobFailed = false;   // the running job got ERROR or timed out
+unsigned long modemCommandDeadline = 0;
+const unsigned long MODEM_COMMAND_TIMEOUT = 5000;
+const unsigned long SMS_SEND_TIMEOUT = 60000;  // network submit after the text is in
+const uint32_t SMS_RECONCILE_INTERVAL = 600000;  // full +CMGL sweep every 10 min
+
+// Admin commands waiting to run once the modem is idle again
+const uint8_t SMS_INBOX_SIZE = 4;
+struct InboxMessage {
+  int16_t index;  // SIM storage slot to delete afterwards, -1 if not stored
+  char body[161];
+};
+InboxMessage smsInbox[SMS_INBOX_SIZE];
+uint8_t smsInboxCount = 0;
+
+// Outgoing SMS wait here for their MODEM_JOB_SEND; the job's index is the slot
+const uint8_t SMS_OUTBOX_SIZE = 4;
+struct OutboxMessage {
+  bool used;
+  char number[20];
+  char text[161];
+};
+OutboxMessage smsOutbox[SMS_OUTBOX_SIZE];
 
 const char* ADMIN_NUMBER = "+260970846745";
 
-// Django URLs
-const char* djangoSensorUrl = "http://192.168.137.230:8000/api/sensor-data/";
-const char* djangoAuthUrl = "http://192.168.137.230:8000/api/check-auth/";
-const char* djangoRfidUrl = "http://192.168.137.230:8000/api/check-auth/";
-
-unsigned long postInterval = 10000;
+// Django server and endpoints
+const char* djangoHost = "192.168.137.230";
+const uint16_t djangoPort = 8000;
+const char* djangoSensorPath = "/api/sensor-data/";
+const char* djangoAuthPath = "/api/check-auth/";
+const char* djangoRfidPath = "/api/check-auth/";
+const char* djangoAlertPath = "/api/alerts/";
+
+// HTTP runs on a worker task on core 0 over one keep-alive socket
+DjangoClient djangoClient(djangoHost, djangoPort);
+const uint32_t AUTH_TIMEOUT = 4000;         // ms, someone is waiting at the door
+const uint32_t SENSOR_POST_TIMEOUT = 8000;  // ms
+const uint32_t HTTP_STATS_INTERVAL = 300000;  // log HTTP, RFID and WiFi counters every 5 min
+const uint32_t ALERT_TIMEOUT = 10000;       // ms
+
+#ifdef USE_MQTT
+// Build with -DUSE_MQTT to send everything above over one broker session
+// (see MqttLink.h); the broker runs next to Django. Commands pushed on
+// home/<id>/cmd/<n> arrive on the worker task and are handed to loop().
+const uint16_t mqttPort = 1883;
+const char* mqttDeviceId = "smarthome_001";
+// With credentials (and a broker that only lets the backend publish on
+// home/<id>/cmd/) MQTT may run the admin commands; left empty it gets what
+// the WebSocket gets.
+const char* mqttUser = "";
+const char* mqttPassword = "";
+MqttLink mqttLink(djangoHost, mqttPort, mqttDeviceId);
+
+struct MqttCommand {
+  char id[12];
+  char line[MqttLink::MAX_COMMAND];
+  uint8_t len;
+};
+QueueHandle_t mqttCommands = nullptr;
+const uint8_t MQTT_COMMAND_QUEUE = 4;
+#endif
+
+// DHT samples are buffered (RAM, then LittleFS) and uploaded in batches
+SensorBuffer sensorBuffer;
+bool sensorBatchInFlight = false;
+const uint32_t UPLOAD_MAX_AGE = 60000;   // ms, oldest sample waits at most this long
+const size_t UPLOAD_BYTE_BUDGET = 900;   // bytes of JSON per batch
+const time_t CLOCK_VALID_AFTER = 1600000000;  // NTP has set the clock
+
+// Recent access decisions, persisted in NVS
+CredentialCache credentialCache;
+const uint32_t CACHE_MAINTAIN_INTERVAL = 60000;
+
+// Per-handler loop() timings, read with the METRICS command
+LoopMetrics loopMetrics;
+
+// Every new reading is aggregated; only summary records are uploaded
+SensorAggregator sensorAggregator;
+uint32_t lastSensorSeq = 0;
+
+unsigned long postInterval = 10000;  // Mega display refresh
 unsigned long lastPostTime = 0;
-unsigned long lastSmsCheck = 0;
-const long smsCheckInterval = 30000;  // Check for SMS every 30 seconds
 bool systemEnabled = true;  // Controls overall system state
 
 
@@ -74,110 +201,193 @@ const int SERVO_LOCKED_POS = 0;    // 0 degrees (locked position)
 const int SERVO_UNLOCKED_POS = 90; // 90 degrees (unlocked position)
 const int UNLOCK_DURATION = 3000;  // 3 seconds unlocked
 
+// Timers (door relock, LED/buzzer pulses) run from loop()
+Scheduler scheduler;
+TimerId relockTimer = 0;
+TimerId grantedLedTimer = 0;
+TimerId deniedLedTimer = 0;
+TimerId buzzerTimer = 0;
+TimerId restartLightTimer = 0;
+
 // --- Function Prototypes ---
-void connectWiFi();
+void onWifiChange(bool connected);
 void onWebSocketEvent(uint8_t client_num, WStype_t type, uint8_t *payload, size_t length);
 void handleSerialFromMega();
+void onMegaMessage(uint8_t type, const uint8_t *payload, uint8_t len);
+void sendAuthResultToMega(MegaAuthStatus status);
 void handleRFID();
 void postDataToDjango(float t, float h);
+void closeSensorWindow();
+void flushSensorBuffer();
+void onSensorBatchResponse(const DjangoResponse &res);
 void checkPasswordWithDjango(String pass);
 void checkRFIDWithDjango(String uid);
+void onKeypadAuthResponse(const DjangoResponse &res);
+void onRfidAuthResponse(const DjangoResponse &res);
+void applyKeypadDecision(bool granted);
+void applyRfidDecision(String uid, bool granted);
 void unlockDoor();
+void unlockDoorFor(uint32_t durationMs);
 void lockDoor();
-void initGSM();
+void pulsePin(uint8_t pin, uint32_t durationMs, TimerId &timer);
+bool initGSM();
+void gsmTask(void *arg);
+void serviceBoot();
 void sendSMS(String number, String message);
-void processSMSCommands();
+void serviceModem();
+bool queueModemJob(ModemJobType type, int16_t index, bool first = false);
+bool isAdminNumber(const char* sender);
 void handleSystemShutdown();
 void handleSystemRestart();
 void sendAccessAlert(String method, String identifier, bool granted);
-void processCommand(String cmd);
+void dispatchCommand(CommandTransport transport, const char* text, size_t len, uint8_t client = 0,
+                     const char* replyTo = nullptr);
+void sendCommandReply(const char* id, const char* text);
+void handleMqttCommands();
 
 void setup() {
   Serial.begin(115200);       // PC
 
-   
-    // Initialize GSM
-  Serial2.begin(9600, SERIAL_8N1,  RXD2, TXD2);  // Initialize Serial1
-  SerialMega.begin(9600, SERIAL_8N1, 26, 27);
-   delay(1000);  // Wait for serial port to initialize
-  
-  // Test serial communication
-  Serial.println("Testing GSM serial connection...");
-  Serial2.println("AT");
-  delay(1000);
-  while (Serial2.available()) {
-    Serial.write(Serial2.read());                                                                                                                              
-  }
-  
-
+  // Stage 1: door control. Nothing here waits on the network or the modem.
   pinMode(RELAY_PIN, OUTPUT);
   digitalWrite(RELAY_PIN, LOW);
-   pinMode(GRANTED_LED, OUTPUT);
+  pinMode(GRANTED_LED, OUTPUT);
   pinMode(DENIED_LED, OUTPUT);
+  pinMode(buzzerPin, OUTPUT);
+  digitalWrite(buzzerPin, LOW);
 
-  // Initialize servo
   doorServo.attach(SERVO_PIN);
   lockDoor(); // Start with door locked
 
-  dht.begin();
-  connectWiFi();
+  SerialMega.begin(MegaLink::BASE_BAUD, SERIAL_8N1, RX1, TX1);
+  megaLink.begin(onMegaMessage, MEGA_LINK_BAUD);
 
   SPI.begin(18,19,23,SS_PIN);
   mfrc522.PCD_Init();
-  Serial.println("RFID Reader Ready!");
-
-  pinMode(buzzerPin, OUTPUT);
-  digitalWrite(buzzerPin, LOW);
-
-  webSocket.begin();
-  webSocket.onEvent(onWebSocketEvent);
- 
+  cardReader.begin();
+  credentialCache.begin();  // door decisions while the server is unreachable
+  Serial.printf("[BOOT] Door ready at %lu ms\n", millis());
+
+  // Stage 2: everything else starts in the background
+  sensorService.begin();
+#ifdef USE_MQTT
+  mqttCommands = xQueueCreate(MQTT_COMMAND_QUEUE, sizeof(MqttCommand));
+  mqttLink.onCommand([](const char* id, const char* line, size_t len) {
+    MqttCommand cmd;
+    strlcpy(cmd.id, id, sizeof(cmd.id));
+    memcpy(cmd.line, line, len + 1);
+    cmd.len = len;
+    if (xQueueSend(mqttCommands, &cmd, 0) != pdTRUE) Serial.println("[MQTT] Command queue full, dropped");
+  });
+  mqttLink.setCredentials(mqttUser, mqttPassword);
+  djangoClient.setTransport(mqttLink);
+#endif
+  djangoClient.begin();
+  sensorBuffer.begin();
+  scheduler.every(CACHE_MAINTAIN_INTERVAL, [](uint32_t) { credentialCache.maintain(); });
+  scheduler.every(HTTP_STATS_INTERVAL, [](uint32_t) {
+    djangoClient.printStats(Serial);
+    cardReader.printStats(Serial);
+    wifiLink.printStats(Serial);
+  });
+  // URCs can be missed while a command times out or the modem restarts
+  scheduler.every(SMS_RECONCILE_INTERVAL, [](uint32_t) { queueModemJob(MODEM_JOB_LIST, -1); });
+  wifiLink.begin(onWifiChange);  // the WebSocket server starts once it's up
+
+  Serial2.setTxBufferSize(256);  // an SMS text goes out without waiting on the UART
+  Serial2.begin(9600, SERIAL_8N1, RXD2, TXD2);
+#ifdef ENABLE_GSM
+  // Power pulse, modem boot and registration: 10 s to several minutes
+  xTaskCreatePinnedToCore(gsmTask, "gsm", 6144, nullptr, 1, nullptr, 0);
+#endif
 }
 
 void loop() {
-  webSocket.loop();
+  uint32_t loopStart = LoopMetrics::now();
+  uint32_t t = loopStart;
+  scheduler.tick();
+  wifiLink.loop();
+  serviceBoot();
+  t = loopMetrics.lap(LOOP_SCHEDULER, t);
+  djangoClient.poll();
+  handleMqttCommands();
+  t = loopMetrics.lap(LOOP_HTTP_CALLBACKS, t);
+  if (webSocketStarted) webSocket.loop();
+  t = loopMetrics.lap(LOOP_WEBSOCKET, t);
   handleSerialFromMega();
+  t = loopMetrics.lap(LOOP_MEGA, t);
   handleRFID();
+  t = loopMetrics.lap(LOOP_RFID, t);
+  serviceModem();
+  t = loopMetrics.lap(LOOP_MODEM, t);
 
-  // Check for SMS commands periodically
   unsigned long currentMillis = millis();
-  if (currentMillis - lastSmsCheck > smsCheckInterval) {
-    lastSmsCheck = currentMillis;
-    processSMSCommands();
+
+  // Last good reading from the sampler task; never touches the sensor
+  SensorReading reading = sensorService.latest();
+  if (reading.seq != lastSensorSeq) {
+    lastSensorSeq = reading.seq;
+    postDataToDjango(reading.temperature, reading.humidity);
   }
 
-  // Regular sensor data posting
   if (currentMillis - lastPostTime >= postInterval) {
     lastPostTime = currentMillis;
-
-    float t = dht.readTemperature();
-    float h = dht.readHumidity();
-
-    if (!isnan(t) && !isnan(h)) {
-      postDataToDjango(t, h);
-
-      // Send to Arduino Mega
-      SerialMega.print("TEMP:");
-      SerialMega.print(t);
-      SerialMega.print(",HUM:");
-      SerialMega.println(h);
-                               }
+    if (reading.quality == SENSOR_OK) {
+      // Send to Arduino Mega; only the latest reading matters, no ACK
+      int16_t tenths[2] = { (int16_t)lroundf(reading.temperature * 10),
+                            (int16_t)lroundf(reading.humidity * 10) };
+      megaLink.send(MEGA_MSG_SENSOR, tenths, sizeof(tenths), false);
+    }
   }
+  t = loopMetrics.lap(LOOP_SENSORS, t);
+  loopMetrics.record(LOOP_TOTAL, t - loopStart);
 }
+// Queues the SMS and returns; a modem job sends it once the modem is free
+// and finishSMS() counts it as sent or failed when the modem answers.
 void sendSMS(String number, String message) {
   if (!gsmInitialized) {
     Serial.println("GSM not initialized. SMS not sent.");
     return;
   }
 
-  modem.sendSMS(number, message);
-  Serial.print("SMS sent to ");
-  Serial.print(number);
-  Serial.print(": ");
-  Serial.println(message);
+  uint8_t slot = 0;
+  while (slot < SMS_OUTBOX_SIZE && smsOutbox[slot].used) slot++;
+  if (slot == SMS_OUTBOX_SIZE || !queueModemJob(MODEM_JOB_SEND, slot)) {
+    loopMetrics.count(METRIC_SMS_FAILED);
+    Serial.println("[SMS] Outbox full, SMS dropped");
+    return;
+  }
+  OutboxMessage &m = smsOutbox[slot];
+  m.used = true;
+  strlcpy(m.number, number.c_str(), sizeof(m.number));
+  strlcpy(m.text, message.c_str(), sizeof(m.text));
+}
+
+// The modem took the SMS text after "> ": Ctrl-Z submits it
+void writeSMSText(const OutboxMessage &m) {
+  Serial2.write((const uint8_t*)m.text, strlen(m.text));
+  Serial2.write(0x1A);
+  modemCommandDeadline = millis() + SMS_SEND_TIMEOUT;
 }
 
-void initGSM() {
+void finishSMS(OutboxMessage &m, bool sent) {
+  if (sent) {
+    loopMetrics.count(METRIC_SMS_SENT);
+    Serial.print("SMS sent to ");
+    Serial.print(m.number);
+    Serial.print(": ");
+    Serial.println(m.text);
+  } else {
+    loopMetrics.count(METRIC_SMS_FAILED);
+    Serial.println("[SMS] Send failed");
+  }
+  m.used = false;
+}
+
+// Runs on the GSM task; blocks for as long as the modem needs. Only
+// Serial2 and the modem are touched here, loop() leaves both alone until
+// gsmReady is set.
+bool initGSM() {
   Serial.println("Initializing GSM module...");
   Serial2.begin(9600, SERIAL_8N1, RXD2, TXD2);
   modem.init();
@@ -203,11 +413,11 @@ void initGSM() {
       Serial.println("Modem is responding");
     } else {
       Serial.println("No valid response from modem");
-      return;
+      return false;
     }
   } else {
     Serial.println("No response from modem - check wiring");
-    return;
+    return false;
   }
 
   // 3. Configure module settings
@@ -228,166 +438,386 @@ void initGSM() {
   Serial.println("Waiting for network...");
   if (!modem.waitForNetwork(180000L)) {  // 3 minute timeout
     Serial.println("Failed to register on network");
-    return;
+    return false;
   }
 
   // 5. Final checks
   Serial.print("Signal quality: ");
   Serial.println(modem.getSignalQuality());
   
-  gsmInitialized = true;
-  Serial.println("GSM initialized successfully");
-  sendSMS(ADMIN_NUMBER, "System initialized and ready");
+  return true;
 }
-void processSMSCommands() {
-  if (!gsmInitialized) {
-    Serial.println("[SMS] GSM not initialized");
-    return;
+
+void gsmTask(void *arg) {
+  gsmReady = initGSM();
+  vTaskDelete(nullptr);
+}
+
+// Follow-ups on the loop task once a background stage reports ready
+void serviceBoot() {
+  if (gsmReady && !gsmInitialized) {
+    gsmInitialized = true;
+    Serial.printf("[BOOT] GSM ready at %lu ms\n", millis());
+    queueModemJob(MODEM_JOB_LIST, -1);  // pick up anything that came in while we were off
+    sendSMS(ADMIN_NUMBER, "System initialized and ready");
   }
+}
+bool isAdminNumber(const char* sender) {
+  // Accept the number as configured, or with the country code written out again
+  return strcmp(sender, ADMIN_NUMBER) == 0 ||
+         (strncmp(sender, "+26", 3) == 0 && strcmp(sender + 3, ADMIN_NUMBER + 1) == 0);
+}
 
-  // First check for new messages in real-time
-  while (Serial2.available()) {
-    String line = Serial2.readStringUntil('\n');
-    line.trim();
-    
-    if (line.startsWith("+CMT:")) {
-      // Parse sender number
-      int numStart = line.indexOf('"') + 1;
-      int numEnd = line.indexOf('"', numStart);
-      String sender = line.substring(numStart, numEnd);
-      
-      // Read message content (next line)
-      String content = Serial2.readStringUntil('\n');
-      content.trim();
-      content.toUpperCase();
-           
-      Serial.print("[SMS] New message from ");
-      Serial.print(sender);
+// Modem events are parsed as they stream in; admin messages are parked in
+// the inbox and acted on once the current AT command has finished, since
+// replying means sending AT commands of our own.
+void onModemEvent(const AtEvent &ev) {
+  switch (ev.type) {
+    case AT_EVENT_OK:
+      modemBusy = false;
+      break;
+    case AT_EVENT_ERROR:
+      modemBusy = false;
+      modemJobFailed = true;
+      break;
+    case AT_EVENT_PROMPT:
+      if (modemJobRunning && modemJobs[modemJobHead].type == MODEM_JOB_SEND) {
+        writeSMSText(smsOutbox[modemJobs[modemJobHead].index]);
+      }
+      break;
+    case AT_EVENT_CMTI:
+      // New message stored on the SIM, read just that one
+      if (ev.index >= 0) queueModemJob(MODEM_JOB_READ, ev.index);
+      break;
+    case AT_EVENT_CMT:
+    case AT_EVENT_CMGR:
+    case AT_EVENT_CMGL: {
+      // +CMGR doesn't repeat the index, it's the one we asked for
+      int16_t index = ev.type == AT_EVENT_CMGL ? ev.index
+                    : ev.type == AT_EVENT_CMGR ? modemJobs[modemJobHead].index : -1;
+      Serial.print("[SMS] Message #");
+      Serial.print(index);
+      Serial.print(" from ");
+      Serial.print(ev.sender);
       Serial.print(": ");
-      Serial.println(content);
-
-      // Process if from admin
-      if (sender == ADMIN_NUMBER || sender == ("+26" + String(ADMIN_NUMBER).substring(1)) ){
-        processCommand(content);
+      Serial.println(ev.body);
+      if (isAdminNumber(ev.sender) && smsInboxCount < SMS_INBOX_SIZE) {
+        smsInbox[smsInboxCount].index = index;
+        strlcpy(smsInbox[smsInboxCount].body, ev.body, sizeof(smsInbox[0].body));
+        smsInboxCount++;
       }
+      break;
     }
   }
+}
 
-  // Then check stored messages
-  modem.sendAT("+CMGL=\"ALL\"");
-  String response = "";
-  unsigned long startTime = millis();
-  
-  while (millis() - startTime < 5000) {
-    while (Serial2.available()) {
-      char c = Serial2.read();
-      response += c;
-    }
-    if (response.endsWith("OK\r\n")) break;
+// first puts the job ahead of everything queued; only valid while no job
+// is running
+bool queueModemJob(ModemJobType type, int16_t index, bool first) {
+  if (modemJobCount == MODEM_JOB_QUEUE_SIZE) {
+    Serial.println("[SMS] Modem job queue full");  // the next sweep picks it up
+    return false;
   }
+  if (first) {
+    modemJobHead = (modemJobHead + MODEM_JOB_QUEUE_SIZE - 1) % MODEM_JOB_QUEUE_SIZE;
+    modemJobs[modemJobHead] = { type, index };
+  } else {
+    modemJobs[(modemJobHead + modemJobCount) % MODEM_JOB_QUEUE_SIZE] = { type, index };
+  }
+  modemJobCount++;
+  return true;
+}
 
-  // Improved SMS parsing
-  int index = 0;
-  while ((index = response.indexOf("+CMGL:", index)) != -1) {
-    // Parse message index
-    int msgIndex = response.substring(index + 6, response.indexOf(',', index)).toInt();
-    
-    // Parse status (READ/UNREAD)
-    int statusStart = response.indexOf(',', index) + 1;
-    int statusEnd = response.indexOf(',', statusStart);
-    String status = response.substring(statusStart, statusEnd);
-    status.replace("\"", "");
-    
-    // Parse sender number
-    int numStart = response.indexOf('"', statusEnd) + 1;
-    int numEnd = response.indexOf('"', numStart);
-    String sender = response.substring(numStart, numEnd);
-    
-    // Parse timestamp (skip)
-    int timeStart = response.indexOf('"', numEnd) + 1;
-    int timeEnd = response.indexOf('"', timeStart);
-    
-    // Parse message content
-    int contentStart = response.indexOf('\n', timeEnd) + 1;
-    int nextMsg = response.indexOf("+CMGL:", contentStart);
-    int contentEnd = (nextMsg == -1) ? response.indexOf("OK\r\n") : nextMsg;
-    String content = response.substring(contentStart, contentEnd);
-    content.trim();
-    content.toUpperCase();
-
-    Serial.print("[SMS] Stored message #");
-    Serial.print(msgIndex);
-    Serial.print(" Status: ");
-    Serial.print(status);
-    Serial.print(" From: ");
-    Serial.print(sender);
-    Serial.print(" Content: ");
-    Serial.println(content);
-
-    // Process if from admin
-    if (sender == ADMIN_NUMBER || sender == ("+26" + String(ADMIN_NUMBER).substring(1))) {
-      processCommand(content);
-      
-      // Delete processed message
-      modem.sendAT("+CMGD=" + String(msgIndex));
-      modem.waitResponse(1000);
+void startModemJob(const ModemJob &job) {
+  switch (job.type) {
+    case MODEM_JOB_READ:   modem.sendAT("+CMGR=" + String(job.index)); break;
+    case MODEM_JOB_DELETE: modem.sendAT("+CMGD=" + String(job.index)); break;
+    case MODEM_JOB_LIST:   modem.sendAT("+CMGL=\"ALL\""); break;
+    case MODEM_JOB_SEND:   modem.sendAT("+CMGS=\"" + String(smsOutbox[job.index].number) + "\""); break;
+  }
+  modemBusy = true;
+  modemJobFailed = false;
+  modemCommandDeadline = millis() + MODEM_COMMAND_TIMEOUT;
+}
+
+// Called from every loop(): feed modem bytes to the parser, finish the
+// running job, then dispatch parked messages or start the next job.
+void serviceModem() {
+  if (!gsmInitialized) return;
+
+  unsigned long now = millis();
+  if (Serial2.available()) {
+    while (Serial2.available()) modemParser.feed(Serial2.read());
+    lastModemByteTime = now;
+  } else if (now - lastModemByteTime > 50) {
+    modemParser.flush();  // a +CMT body ends when the UART goes quiet
+  }
+
+  if (modemBusy) {
+    if ((long)(now - modemCommandDeadline) < 0) return;
+    Serial.println("[SMS] Modem command timed out");
+    modemParser.reset();
+    modemBusy = false;
+    modemJobFailed = true;
+    // ESC abandons an SMS text the modem may still be waiting for
+    if (modemJobRunning && modemJobs[modemJobHead].type == MODEM_JOB_SEND) Serial2.write(0x1B);
+  }
+
+  // The job that just finished (or timed out)
+  if (modemJobRunning) {
+    const ModemJob &job = modemJobs[modemJobHead];
+    if (job.type == MODEM_JOB_SEND) finishSMS(smsOutbox[job.index], !modemJobFailed);
+    modemJobHead = (modemJobHead + 1) % MODEM_JOB_QUEUE_SIZE;
+    modemJobCount--;
+    modemJobRunning = false;
+  }
+
+  if (smsInboxCount) {
+    for (uint8_t i = 0; i < smsInboxCount; i++) {
+      dispatchCommand(TRANSPORT_SMS, smsInbox[i].body, strlen(smsInbox[i].body));
+      // Delete before any queued sweep can list it and run it again
+      if (smsInbox[i].index >= 0) queueModemJob(MODEM_JOB_DELETE, smsInbox[i].index, true);
     }
+    smsInboxCount = 0;
+  }
 
-    index = contentEnd;
+  if (modemJobCount) {
+    startModemJob(modemJobs[modemJobHead]);
+    modemJobRunning = true;
   }
 }
-// Helper function to process commands (add this if not existing)
-void processCommand(String cmd) {
- cmd.trim();
-  cmd.toUpperCase(); // Force uppercase
-  cmd.replace("\r", "");
-  cmd.replace("\n", "");
 
-  Serial.print("Processing command: ");
-  Serial.println(cmd);
+// ========== Commands ==========
+// One table for SMS, WebSocket and Mega commands, see CommandRegistry.h.
+// Handlers answer in plain text, plus the JSON/token form the web UI
+// expects where it differs.
 
-  if (cmd == "OPEN") {
-    unlockDoor();
-    sendSMS(ADMIN_NUMBER, "Door opened via SMS");
-  } 
-  else if (cmd == "CLOSE") {
-    lockDoor();
-    sendSMS(ADMIN_NUMBER, "Door closed via SMS");
+void setBulb(bool on) {
+  bulbState = on;
+  digitalWrite(RELAY_PIN, on ? HIGH : LOW);
+}
+
+void cmdOpen(CommandContext &ctx) {
+  unlockDoor();
+  ctx.respond("Door opened", "DOOR_OPEN_OK");
+}
+
+void cmdClose(CommandContext &ctx) {
+  lockDoor();
+  ctx.respond("Door closed", "DOOR_CLOSE_OK");
+}
+
+void cmdGranted(CommandContext &ctx) {
+  unlockDoorFor(UNLOCK_DURATION);
+  ctx.respond("Door opened", "DOOR_OPEN_OK");
+}
+
+void cmdOn(CommandContext &ctx) {
+  setBulb(true);
+  ctx.respond("Light turned ON", "{\"bulb\":\"on\"}");
+}
+
+void cmdOff(CommandContext &ctx) {
+  setBulb(false);
+  ctx.respond("Light turned OFF", "{\"bulb\":\"off\"}");
+}
+
+void cmdBulbOn(CommandContext &ctx) {
+  setBulb(true);
+  ctx.respond("Light turned ON", "BULB_ON_OK");
+}
+
+void cmdBulbOff(CommandContext &ctx) {
+  setBulb(false);
+  ctx.respond("Light turned OFF", "BULB_OFF_OK");
+}
+
+void cmdToggle(CommandContext &ctx) {
+  setBulb(!bulbState);
+  if (bulbState) ctx.respond("Light turned ON", "{\"bulb\":\"on\"}");
+  else ctx.respond("Light turned OFF", "{\"bulb\":\"off\"}");
+}
+
+void cmdShutdown(CommandContext &ctx) {
+  systemEnabled = false;
+  handleSystemShutdown();
+  ctx.respond("System SHUTDOWN activated", "SHUTDOWN_STARTED");
+}
+
+void cmdRestart(CommandContext &ctx) {
+  systemEnabled = true;
+  handleSystemRestart();
+  ctx.respond("System RESTARTED", "RESTARTING");
+}
+
+// Reports the cached reading and how old it is; no sensor access
+void cmdStatus(CommandContext &ctx) {
+  static const char *const QUALITY[] = { "none", "ok", "stale" };
+  SensorReading r = sensorService.latest();
+  unsigned long age = r.quality == SENSOR_NONE ? 0 : (millis() - r.millisAt) / 1000;
+  bool locked = doorServo.read() == SERVO_LOCKED_POS;
+  if (ctx.machineReply()) {
+    char t[8] = "null", h[8] = "null";
+    if (r.quality != SENSOR_NONE) {
+      snprintf(t, sizeof(t), "%.1f", r.temperature);
+      snprintf(h, sizeof(h), "%.1f", r.humidity);
+    }
+    ctx.printf("{\"temperature\":%s,\"humidity\":%s,\"sensor\":\"%s\",\"sensor_age\":%lu,"
+               "\"bulb\":\"%s\",\"door\":\"%s\"}",
+               t, h, QUALITY[r.quality], age, bulbState ? "on" : "off", locked ? "locked" : "unlocked");
+  } else if (r.quality == SENSOR_NONE) {
+    ctx.printf("System Status:\nTemp: n/a\nHumidity: n/a\nLight: %s\nDoor: %s",
+               bulbState ? "ON" : "OFF", locked ? "LOCKED" : "UNLOCKED");
+  } else {
+    ctx.printf("System Status:\nTemp: %.2fC\nHumidity: %.2f%%%s\nLight: %s\nDoor: %s",
+               r.temperature, r.humidity, r.quality == SENSOR_STALE ? " (stale)" : "",
+               bulbState ? "ON" : "OFF", locked ? "LOCKED" : "UNLOCKED");
   }
-  else if (cmd == "ON") {
-    digitalWrite(RELAY_PIN, HIGH);
-    bulbState = true;
-    sendSMS(ADMIN_NUMBER, "Light turned ON");
+}
+
+// METRICS returns JSON to WebSocket clients and a one-line summary
+// elsewhere; "METRICS RESET" clears the histograms afterwards. The backend
+// counters are those of the transport in use: DjangoLink's, or MqttLink's
+// with -DUSE_MQTT.
+void cmdMetrics(CommandContext &ctx) {
+#ifdef USE_MQTT
+  const MqttLinkStats &link = mqttLink.stats();
+  const char* linkName = "MQTT";
+  uint32_t linkRequests = link.requests + link.published;
+#else
+  const DjangoLinkStats &link = djangoClient.linkStats();
+  const char* linkName = "HTTP";
+  uint32_t linkRequests = link.requests;
+#endif
+  const WifiLinkStats &wifi = wifiLink.stats();
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  if (ctx.machineReply()) {
+    char json[DjangoClient::MAX_BODY];
+    size_t n = LoopMetrics::append(json, sizeof(json), 0, "{\"uptime\":%lu,", millis() / 1000);
+    n += loopMetrics.writeJson(json + n, sizeof(json) - n);
+#ifdef USE_MQTT
+    n = LoopMetrics::append(json, sizeof(json), n,
+                            ",\"mqtt\":{\"req\":%lu,\"pub\":%lu,\"fail\":%lu,\"retries\":%lu,\"late\":%lu,"
+                            "\"connects\":%lu,\"dropped\":%lu,\"max_ms\":%lu}",
+                            (unsigned long)link.requests, (unsigned long)link.published,
+                            (unsigned long)link.failures, (unsigned long)link.retries,
+                            (unsigned long)link.lateReplies, (unsigned long)link.connects,
+                            (unsigned long)djangoClient.dropped(), (unsigned long)(link.maxLatencyUs / 1000));
+#else
+    n = LoopMetrics::append(json, sizeof(json), n,
+                            ",\"http\":{\"req\":%lu,\"fail\":%lu,\"reused\":%lu,\"dropped\":%lu,\"max_ms\":%lu}",
+                            (unsigned long)link.requests, (unsigned long)link.failures, (unsigned long)link.reused,
+                            (unsigned long)djangoClient.dropped(), (unsigned long)(link.maxLatencyUs / 1000));
+#endif
+    LoopMetrics::append(json, sizeof(json), n,
+                        ",\"sms\":{\"sent\":%lu,\"fail\":%lu},\"wifi\":{\"connects\":%lu,\"last_ms\":%lu,"
+                        "\"offline_ms\":%lu},\"heap\":%lu}",
+                        (unsigned long)loopMetrics.counter(METRIC_SMS_SENT),
+                        (unsigned long)loopMetrics.counter(METRIC_SMS_FAILED), (unsigned long)wifi.connects,
+                        (unsigned long)wifi.lastConnectMs, (unsigned long)wifi.lastOfflineMs,
+                        (unsigned long)ESP.getFreeHeap());
+    // Too big for ctx.reply
+    if (ctx.transport == TRANSPORT_MQTT) sendCommandReply(ctx.replyTo, json);
+    else webSocket.sendTXT(ctx.client, json);
+  } else {
+    ctx.printf("Loop p99 %luus max %luus, %s %lu req %lu fail, SMS %lu sent",
+               (unsigned long)(loopMetrics.percentile(LOOP_TOTAL, 990) / mhz),
+               (unsigned long)(loopMetrics.maxCycles(LOOP_TOTAL) / mhz), linkName,
+               (unsigned long)linkRequests, (unsigned long)link.failures,
+               (unsigned long)loopMetrics.counter(METRIC_SMS_SENT));
   }
-  else if (cmd == "OFF") {
-    digitalWrite(RELAY_PIN, LOW);
-    bulbState = false;
-    sendSMS(ADMIN_NUMBER, "Light turned OFF");
-  }
-  else if(cmd == "SHUTDOWN"){
-    systemEnabled = false;
-    handleSystemShutdown();
-    sendSMS(ADMIN_NUMBER, "System SHUTDOWN activated");
-}else if (cmd == "RESTART") {
-    systemEnabled = true; 
-    handleSystemRestart();
-    sendSMS(ADMIN_NUMBER, "System RESTARTED");
-  }else if (!systemEnabled) {
-    sendSMS(ADMIN_NUMBER, "System is currently SHUTDOWN");
-    return; 
-  }
-  else if (cmd == "STATUS") {
-    String status = "System Status:\n";
-    status += "Temp: " + String(dht.readTemperature()) + "C\n";
-    status += "Humidity: " + String(dht.readHumidity()) + "%\n";
-    status += "Light: " + String(bulbState ? "ON" : "OFF") + "\n";
-    status += "Door: " + String(doorServo.read() == SERVO_LOCKED_POS ? "LOCKED" : "UNLOCKED");
-    sendSMS(ADMIN_NUMBER, status);
-  }
-  else {
-    sendSMS(ADMIN_NUMBER, "Unknown command. Try: OPEN, CLOSE, ON, OFF, STATUS");
+  if (strcmp(ctx.args, "RESET") == 0 || strcmp(ctx.args, "reset") == 0) loopMetrics.reset();
+}
+
+// OPEN, CLOSE, SHUTDOWN and RESTART stay with the admin sources, as when
+// they were SMS-only; GRANTED/DENIED are the web app's timed unlock.
+constexpr CommandEntry COMMANDS[] = {
+  COMMAND("OPEN", cmdOpen, false, COMMAND_VIA_ADMIN),
+  COMMAND("CLOSE", cmdClose, false, COMMAND_VIA_ADMIN),
+  COMMAND("GRANTED", cmdGranted, false, COMMAND_VIA_ADMIN | COMMAND_VIA_WEBSOCKET),
+  COMMAND("DENIED", cmdClose, false, COMMAND_VIA_ADMIN | COMMAND_VIA_WEBSOCKET),
+  COMMAND("ON", cmdOn, false, COMMAND_VIA_ANY),
+  COMMAND("OFF", cmdOff, false, COMMAND_VIA_ANY),
+  COMMAND("BULB_ON", cmdBulbOn, false, COMMAND_VIA_ANY),
+  COMMAND("BULB_OFF", cmdBulbOff, false, COMMAND_VIA_ANY),
+  COMMAND("TOGGLE", cmdToggle, false, COMMAND_VIA_ANY),
+  COMMAND("SHUTDOWN", cmdShutdown, true, COMMAND_VIA_ADMIN),
+  COMMAND("RESTART", cmdRestart, true, COMMAND_VIA_ADMIN),
+  COMMAND("STATUS", cmdStatus, false, COMMAND_VIA_ANY),
+  COMMAND("METRICS", cmdMetrics, false, COMMAND_VIA_ANY),
+};
+static_assert(commandSlotsUnique(COMMANDS, COMMAND_COUNT(COMMANDS)),
+              "Command names collide, pick another COMMAND_HASH_SEED");
+constexpr uint8_t COMMAND_SLOT_INDEX[COMMAND_SLOTS] = COMMAND_SLOT_TABLE(COMMANDS);
+
+// Runs one command line and answers on the transport it came from, if that
+// transport may run it (see CommandRegistry.h). While the system is shut
+// down only SHUTDOWN/RESTART are accepted.
+void dispatchCommand(CommandTransport transport, const char* text, size_t len, uint8_t client,
+                     const char* replyTo) {
+  CommandContext ctx;
+  ctx.transport = transport;
+  ctx.client = client;
+  ctx.replyTo = replyTo;
+  ctx.reply[0] = '\0';
+
+#ifdef USE_MQTT
+  bool mqttAuthenticated = mqttLink.authenticated();
+#else
+  bool mqttAuthenticated = false;
+#endif
+  const CommandEntry* cmd = lookupCommand(COMMANDS, COMMAND_SLOT_INDEX, text, len, ctx);
+  if (!cmd) {
+    ctx.respond("Unknown command. Try: OPEN, CLOSE, ON, OFF, STATUS", "ERROR: Unknown command");
+  } else if (!(cmd->via & commandSource(transport, mqttAuthenticated))) {
+    Serial.print("Command not allowed from this source: ");
+    Serial.println(cmd->name);
+    ctx.respond("Command not allowed from here", "ERROR: Not allowed");
+  } else if (!systemEnabled && !cmd->alwaysAllowed) {
+    ctx.respond("System is currently SHUTDOWN", "ERROR: System is shut down");
+  } else {
+    Serial.print("Processing command: ");
+    Serial.println(cmd->name);
+    cmd->handler(ctx);
+  }
+  if (!ctx.reply[0]) return;
+
+  switch (transport) {
+    case TRANSPORT_SMS:
+      sendSMS(ADMIN_NUMBER, ctx.reply);
+      break;
+    case TRANSPORT_WEBSOCKET:
+      webSocket.sendTXT(client, ctx.reply);
+      break;
+    case TRANSPORT_MEGA: {
+      size_t n = strlen(ctx.reply);
+      if (n > MegaLink::MAX_PAYLOAD) n = MegaLink::MAX_PAYLOAD;  // the console prints what fits
+      megaLink.send(MEGA_MSG_COMMAND_REPLY, (const uint8_t*)ctx.reply, n, true);
+      break;
+    }
+    case TRANSPORT_MQTT:
+      sendCommandReply(replyTo, ctx.reply);
+      break;
   }
 }
+
+// Answer to an MQTT command, published on home/<id>/up/cmd-reply/<n>
+void sendCommandReply(const char* id, const char* text) {
+  char path[DjangoClient::MAX_PATH];
+  snprintf(path, sizeof(path), "/api/cmd-reply/%s/", id);
+  djangoClient.post(path, text, DJANGO_PRIO_AUTH, AUTH_TIMEOUT, nullptr);
+}
+
+// Commands the server pushed over MQTT, queued by the worker task
+void handleMqttCommands() {
+#ifdef USE_MQTT
+  MqttCommand cmd;
+  while (xQueueReceive(mqttCommands, &cmd, 0) == pdTRUE) {
+    dispatchCommand(TRANSPORT_MQTT, cmd.line, cmd.len, 0, cmd.id);
+  }
+#endif
+}
+
 void sendAccessAlert(String method, String identifier, bool granted) {
   Serial.println("[ALERT] Attempting to send access alert...");
   String message = method + " access ";
@@ -395,6 +825,14 @@ void sendAccessAlert(String method, String identifier, bool granted) {
   message += " for ";
   message += identifier;
   sendSMS(ADMIN_NUMBER, message);
+
+#ifdef USE_MQTT
+  // Acknowledged by the server, retried until then (see MqttLink.h)
+  char json[128];
+  snprintf(json, sizeof(json), "{\"method\":\"%s\",\"identifier\":\"%s\",\"granted\":%s}",
+           method.c_str(), identifier.c_str(), granted ? "true" : "false");
+  djangoClient.post(djangoAlertPath, json, DJANGO_PRIO_AUTH, ALERT_TIMEOUT, nullptr);
+#endif
 }
 
 // ========== System Control Functions ==========
@@ -407,6 +845,7 @@ void handleSystemShutdown() {
   // Lock door
   lockDoor();
   
+  cardReader.end();
   mfrc522.PCD_AntennaOff();  // Turn off RFID antenna
   mfrc522.PCD_SoftPowerDown(); // Put RFID in low power mode
   
@@ -415,7 +854,7 @@ void handleSystemShutdown() {
   digitalWrite(DENIED_LED, HIGH);  // Red LED indicates shutdown
   
   // 4. Optional: Disable WiFi to prevent remote access
-  WiFi.disconnect(true);
+  wifiLink.disconnect();
   
   String message = "System shutdown complete";
   Serial.println(message);
@@ -425,22 +864,21 @@ void handleSystemShutdown() {
 void handleSystemRestart() {
   mfrc522.PCD_Init();  // Restart RFID
   mfrc522.PCD_AntennaOn();
+  cardReader.begin();
 
   // 2. Reconnect WiFi if needed
-  if (WiFi.status() != WL_CONNECTED) {
-    connectWiFi();
-  }
+  wifiLink.reconnect();
 
-  // Turn on light temporarily
+  // Turn on light and cycle the door lock; both revert from timers
   bulbState = true;
   digitalWrite(RELAY_PIN, HIGH);
-  
-  // Cycle door lock
-  unlockDoor();
-  
-  // Turn off light
-  bulbState = false;
-  digitalWrite(RELAY_PIN, LOW);
+  unlockDoorFor(UNLOCK_DURATION);
+  scheduler.cancel(restartLightTimer);
+  restartLightTimer = scheduler.after(UNLOCK_DURATION, [](uint32_t) {
+    restartLightTimer = 0;
+    bulbState = false;
+    digitalWrite(RELAY_PIN, LOW);
+  });
 
   String message = "System restart complete";
   Serial.println(message);
@@ -450,205 +888,276 @@ void handleSystemRestart() {
 
 // ========== Helper Functions ==========
 
-void connectWiFi() {
-  WiFi.begin(ssid, password);
-  Serial.print("Connecting to WiFi");
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(1000);
-    Serial.print(".");
+// WifiLink reconnects on its own; RFID, keypad and the Mega keep working
+// offline and sensor records wait in the buffer.
+void onWifiChange(bool connected) {
+  if (!connected) {
+    closeSensorWindow();
+    return;
+  }
+  if (!webSocketStarted) {
+    webSocket.begin();
+    webSocket.onEvent(onWebSocketEvent);
+    webSocketStarted = true;
+    Serial.printf("[BOOT] WiFi and WebSocket up at %lu ms\n", millis());
   }
-  Serial.println("\nWiFi Connected! IP: " + WiFi.localIP().toString());
+  configTime(0, 0, "pool.ntp.org");  // UTC timestamps for buffered samples
+  flushSensorBuffer();
 }
 
 void onWebSocketEvent(uint8_t client_num, WStype_t type, uint8_t *payload, size_t length) {
   if (type == WStype_TEXT) {
-    String msg = (char*)payload;
-    msg.trim();
-    msg.toUpperCase();
-
     Serial.print("Received from WebSocket: ");
-    Serial.println(msg);
-
-
-    // Handle simple ON/OFF/TOGGLE commands
-    if (msg == "ON" || msg == "BULB_ON") {
-      bulbState = true;
-      digitalWrite(RELAY_PIN, HIGH);
-      webSocket.sendTXT(client_num, msg == "ON" ? "{\"bulb\":\"on\"}" : "BULB_ON_OK");
-    } 
-    else if (msg == "OFF" || msg == "BULB_OFF") {
-      bulbState = false;
-      digitalWrite(RELAY_PIN, LOW);
-      webSocket.sendTXT(client_num, msg == "OFF" ? "{\"bulb\":\"off\"}" : "BULB_OFF_OK");
-    } 
-    else if (msg == "TOGGLE") {
-      bulbState = !bulbState;
-      digitalWrite(RELAY_PIN, bulbState ? HIGH : LOW);
-      webSocket.sendTXT(client_num, String("{\"bulb\":\"") + (bulbState ? "on" : "off") + "\"}");
-    }
-    // Handle door commands
-    else if (msg == "GRANTED") {
-      unlockDoor();
-      lockDoor();
-      webSocket.sendTXT(client_num, "DOOR_OPEN_OK");
-    }
-    else if (msg == "DENIED") {
-      unlockDoor(); 
-      lockDoor();
-      webSocket.sendTXT(client_num, "DOOR_CLOSE_OK");
-    }
-    // Handle system commands
-    else if (msg == "BULB_ON") {
-      bulbState = false;
-      digitalWrite(RELAY_PIN, HIGH);
-      webSocket.sendTXT(client_num, "SHUTDOWN_STARTED");
-    }
-    else if (msg == "BULB_OFF") {
-      webSocket.sendTXT(client_num, "RESTARTING");
-      bulbState = false;
-      digitalWrite(RELAY_PIN,LOW);
-    }
-    // Unknown command
-    else {
-      webSocket.sendTXT(client_num, "ERROR: Unknown command");
-    }
+    Serial.write(payload, length);
+    Serial.println();
+    dispatchCommand(TRANSPORT_WEBSOCKET, (const char*)payload, length, client_num);
   }
 }
 
+// Readings go through the aggregator; the records it emits are buffered
+// and sent as one JSON array per upload, so nothing is lost while WiFi or
+// the server is down.
 void postDataToDjango(float t, float h) {
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    http.begin(djangoSensorUrl);
-    http.addHeader("Content-Type", "application/json");
+  time_t now = time(nullptr);
+  SensorSample record;
+  if (sensorAggregator.add(t, h, now > CLOCK_VALID_AFTER ? (uint32_t)now : 0, millis(), record)) {
+    sensorBuffer.push(record);
+  }
+  flushSensorBuffer();
+}
 
-    StaticJsonDocument<200> doc;
-    doc["temperature"] = t;
-    doc["humidity"] = h;
-    doc["device_id"] = WiFi.macAddress();
-    String body;
-    serializeJson(doc, body);
+// When the link drops, the readings since the last record become one, so
+// the server's data runs right up to the gap instead of stopping up to a
+// window earlier.
+void closeSensorWindow() {
+  time_t now = time(nullptr);
+  SensorSample record;
+  if (sensorAggregator.flush(now > CLOCK_VALID_AFTER ? (uint32_t)now : 0, record)) {
+    sensorBuffer.push(record);
+  }
+}
 
-    http.POST(body);
-    http.end();
+void flushSensorBuffer() {
+  if (sensorBatchInFlight || !wifiLink.connected()) return;
+  if (!sensorBuffer.due(UPLOAD_MAX_AGE, UPLOAD_BYTE_BUDGET)) return;
+
+  static char body[DjangoClient::MAX_BODY];
+  if (!sensorBuffer.buildBatch(body, sizeof(body), UPLOAD_BYTE_BUDGET, WiFi.macAddress().c_str())) return;
+  sensorBatchInFlight = djangoClient.post(djangoSensorPath, body, DJANGO_PRIO_SENSOR, SENSOR_POST_TIMEOUT,
+                                          onSensorBatchResponse);
+}
+
+void onSensorBatchResponse(const DjangoResponse &res) {
+  sensorBatchInFlight = false;
+  if (res.code < 200 || res.code >= 300) {
+    Serial.print("[BUFFER] Batch upload failed, keeping samples: ");
+    Serial.println(res.code);
+    return;
   }
+  sensorBuffer.commit();
+  flushSensorBuffer();  // keep draining a backlog after an outage
 }
 
+// Cached credentials are decided locally right away; the server is still
+// asked and its answer refreshes the cache (and wins if they disagree).
+// The POST context carries the local decision ('0' + state) then the value.
 void checkPasswordWithDjango(String pass) {
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    http.begin(djangoAuthUrl);
-    http.addHeader("Content-Type", "application/json");
-
-    StaticJsonDocument<200> doc;
-    doc["type"] = "keypad";
-    doc["value"] = pass;
-    doc["device_id"] = WiFi.macAddress();
-    
-    String body;
-    serializeJson(doc, body);
-
-    int code = http.POST(body);
-    String res = http.getString();
-
-    Serial.println("Keypad check response: " + res);
-    Serial2.println(res);
-    Serial.println("Sent to Mega: " + res);
-
-    // Parse response
-    DeserializationError error = deserializeJson(doc, res);
-    if (!error) {
-      const char* status = doc["status"];
-      if (String(status) == "GRANTED") {
-        unlockDoor();
-        webSocket.broadcastTXT("{\"access\":\"granted\", \"method\":\"keypad\"}");
-      } else {
-        webSocket.broadcastTXT("{\"access\":\"denied\", \"method\":\"keypad\"}");
-      }
-    }
+  CredentialState cached = credentialCache.lookup(CRED_KEYPAD, pass.c_str());
+  if (cached != CRED_UNKNOWN) {
+    bool granted = cached == CRED_GRANTED;
+    sendAuthResultToMega(granted ? MEGA_AUTH_GRANTED : MEGA_AUTH_DENIED);
+    applyKeypadDecision(granted);
+  }
+
+  StaticJsonDocument<200> doc;
+  doc["type"] = "keypad";
+  doc["value"] = pass;
+  doc["device_id"] = WiFi.macAddress();
+  char body[160];
+  serializeJson(doc, body, sizeof(body));
+
+  char context[32];
+  context[0] = '0' + cached;
+  strlcpy(context + 1, pass.c_str(), sizeof(context) - 1);
+
+  if (!djangoClient.post(djangoAuthPath, body, DJANGO_PRIO_AUTH, AUTH_TIMEOUT, onKeypadAuthResponse, context) &&
+      cached == CRED_UNKNOWN) {
+    sendAuthResultToMega(MEGA_AUTH_ERROR);
+  }
+}
+
+void onKeypadAuthResponse(const DjangoResponse &res) {
+  CredentialState local = (CredentialState)(res.context[0] - '0');
+  const char* pass = res.context + 1;
+
+  if (res.code <= 0) {
+    Serial.print("Keypad check failed: ");
+    Serial.println(res.code);
+    // Don't leave the Mega waiting on "Checking..."
+    if (local == CRED_UNKNOWN) sendAuthResultToMega(MEGA_AUTH_ERROR);
+    return;
+  }
+
+  Serial.print("Keypad check response: ");
+  Serial.println(res.body);
 
-    http.end();
+  StaticJsonDocument<200> doc;
+  DeserializationError error = deserializeJson(doc, res.body);
+  if (error) {
+    if (local == CRED_UNKNOWN) sendAuthResultToMega(MEGA_AUTH_ERROR);
+    return;
+  }
+  const char* status = doc["status"];
+  bool granted = String(status) == "GRANTED";
+  credentialCache.store(CRED_KEYPAD, pass, granted);
+
+  if (local == CRED_UNKNOWN) {
+    sendAuthResultToMega(granted ? MEGA_AUTH_GRANTED : MEGA_AUTH_DENIED);
+    applyKeypadDecision(granted);
+  } else if ((local == CRED_GRANTED) != granted) {
+    Serial.println("[CACHE] Server overruled cached keypad decision");
+    if (!granted) lockDoor();
+    applyKeypadDecision(granted);
+  }
+}
+
+void applyKeypadDecision(bool granted) {
+  if (granted) {
+    unlockDoorFor(UNLOCK_DURATION);
+    webSocket.broadcastTXT("{\"access\":\"granted\", \"method\":\"keypad\"}");
+  } else {
+    webSocket.broadcastTXT("{\"access\":\"denied\", \"method\":\"keypad\"}");
   }
 }
 
 void checkRFIDWithDjango(String uid) {
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    http.begin(djangoRfidUrl);
-    http.addHeader("Content-Type", "application/json");
-
-    StaticJsonDocument<200> doc;
-    doc["type"] = "rfid";
-    doc["value"] = uid;
-    doc["device_id"] = WiFi.macAddress();
-    String body;
-    serializeJson(doc, body);
-
-    int code = http.POST(body);
-    String res = http.getString();
-    Serial.println("RFID check response: " + res);
-
-    DeserializationError error = deserializeJson(doc, res);
-    if (!error) {
-      const char* status = doc["status"];
-      if (String(status) == "GRANTED") {
-           webSocket.broadcastTXT("{\"rfid\":\"access_granted\", \"rfid_id\":\"" + uid + "\"}");
-             unlockDoor();
-         digitalWrite(GRANTED_LED,HIGH);
-         delay(3000);
-         lockDoor();
-         digitalWrite(GRANTED_LED,LOW);
-         sendAccessAlert("RFID", uid, true);
-         
-      } else {
-        unlockDoor();
-        digitalWrite(DENIED_LED,HIGH);
-         lockDoor();
-        delay(3000);
-        digitalWrite(DENIED_LED,LOW);
-        sendAccessAlert("RFID", uid, false);
-        webSocket.broadcastTXT("{\"rfid\":\"access_denied\", \"rfid_id\":\"" + uid + "\"}");
-      }
-    }
+  CredentialState cached = credentialCache.lookup(CRED_RFID, uid.c_str());
+  if (cached != CRED_UNKNOWN) applyRfidDecision(uid, cached == CRED_GRANTED);
+
+  StaticJsonDocument<200> doc;
+  doc["type"] = "rfid";
+  doc["value"] = uid;
+  doc["device_id"] = WiFi.macAddress();
+  char body[160];
+  serializeJson(doc, body, sizeof(body));
+
+  char context[32];
+  context[0] = '0' + cached;
+  strlcpy(context + 1, uid.c_str(), sizeof(context) - 1);
+
+  if (!djangoClient.post(djangoRfidPath, body, DJANGO_PRIO_AUTH, AUTH_TIMEOUT, onRfidAuthResponse, context)) {
+    Serial.println("[DJANGO] RFID check dropped");
+  }
+}
+
+void onRfidAuthResponse(const DjangoResponse &res) {
+  CredentialState local = (CredentialState)(res.context[0] - '0');
+  String uid = res.context + 1;
+
+  if (res.code <= 0) {
+    Serial.print("RFID check failed: ");
+    Serial.println(res.code);
+    return;
+  }
 
-    http.end();
+  Serial.print("RFID check response: ");
+  Serial.println(res.body);
+
+  StaticJsonDocument<200> doc;
+  DeserializationError error = deserializeJson(doc, res.body);
+  if (error) return;
+  const char* status = doc["status"];
+  bool granted = String(status) == "GRANTED";
+  credentialCache.store(CRED_RFID, uid.c_str(), granted);
+
+  if (local == CRED_UNKNOWN) {
+    applyRfidDecision(uid, granted);
+  } else if ((local == CRED_GRANTED) != granted) {
+    Serial.println("[CACHE] Server overruled cached RFID decision");
+    applyRfidDecision(uid, granted);
+  }
+}
+
+void applyRfidDecision(String uid, bool granted) {
+  if (granted) {
+    webSocket.broadcastTXT("{\"rfid\":\"access_granted\", \"rfid_id\":\"" + uid + "\"}");
+    unlockDoorFor(UNLOCK_DURATION);
+    pulsePin(GRANTED_LED, UNLOCK_DURATION, grantedLedTimer);
+    pulsePin(buzzerPin, grantedBeepDuration, buzzerTimer);
+    sendAccessAlert("RFID", uid, true);
+  } else {
+    lockDoor();
+    pulsePin(DENIED_LED, UNLOCK_DURATION, deniedLedTimer);
+    pulsePin(buzzerPin, deniedBeepDuration, buzzerTimer);
+    sendAccessAlert("RFID", uid, false);
+    webSocket.broadcastTXT("{\"rfid\":\"access_denied\", \"rfid_id\":\"" + uid + "\"}");
   }
 }
 
 void handleSerialFromMega() {
-  if (SerialMega.available()) {
-    String line = SerialMega.readStringUntil('\n');
-    line.trim();
-    Serial.print("ESP32 received: ");
-    if (line.startsWith("KEYPAD:")) {
-      String pass = line.substring(7);
-      checkPasswordWithDjango(pass);
-    }
+  megaLink.poll();
+}
+
+void onMegaMessage(uint8_t type, const uint8_t *payload, uint8_t len) {
+  if (type == MEGA_MSG_KEYPAD) {
+    char pass[MegaLink::MAX_PAYLOAD + 1];
+    memcpy(pass, payload, len);
+    pass[len] = '\0';
+    Serial.println("ESP32 received keypad entry");
+    checkPasswordWithDjango(pass);
+  } else if (type == MEGA_MSG_COMMAND) {
+    dispatchCommand(TRANSPORT_MEGA, (const char*)payload, len);
+  }
+}
+
+void sendAuthResultToMega(MegaAuthStatus status) {
+  uint8_t b = status;
+  if (!megaLink.send(MEGA_MSG_AUTH_RESULT, &b, 1, true)) {
+    Serial.println("[MEGA] Link busy, auth result not sent");
   }
 }
 
+// One event per tap; the reader halts the card and drops repeats
 void handleRFID() {
-  if (mfrc522.PICC_IsNewCardPresent() && mfrc522.PICC_ReadCardSerial()) {
-    String rfidUid = "";
-    for (byte i = 0; i < mfrc522.uid.size; i++) {
-      rfidUid += (mfrc522.uid.uidByte[i] < 0x10 ? "0" : "");
-      rfidUid += String(mfrc522.uid.uidByte[i], HEX);
+  cardReader.poll();
+  CardEvent card;
+  while (cardReader.read(card)) {
+    char rfidUid[CardEvent::MAX_UID * 2 + 1];
+    card.toHex(rfidUid, sizeof(rfidUid));
+    if (!firstCardLogged) {
+      firstCardLogged = true;
+      Serial.printf("[BOOT] First card read at %lu ms\n", (unsigned long)card.at);
     }
-    Serial.println("RFID Scanned: " + rfidUid);
+    Serial.print("RFID Scanned: ");
+    Serial.println(rfidUid);
     checkRFIDWithDjango(rfidUid);
-    mfrc522.PICC_HaltA();
   }
 }
 
+// Unlock and stay unlocked until lockDoor() (SMS "OPEN")
 void unlockDoor() {
   Serial.println("Unlocking door...");
+  scheduler.cancel(relockTimer);
   doorServo.write(SERVO_UNLOCKED_POS);
-  delay(UNLOCK_DURATION);
-  
+}
+
+// Unlock and relock from a timer; a repeat grant restarts the window
+void unlockDoorFor(uint32_t durationMs) {
+  unlockDoor();
+  relockTimer = scheduler.after(durationMs, [](uint32_t) { lockDoor(); });
 }
 
 void lockDoor() {
   Serial.println("Locking door...");
+  scheduler.cancel(relockTimer);
   doorServo.write(SERVO_LOCKED_POS);
 }
 
+// Drive pin HIGH for durationMs without blocking; re-pulsing extends it
+void pulsePin(uint8_t pin, uint32_t durationMs, TimerId &timer) {
+  scheduler.cancel(timer);
+  digitalWrite(pin, HIGH);
+  timer = scheduler.after(durationMs, [](uint32_t p) { digitalWrite(p, LOW); }, pin);
+}
+
  
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+// Local stand-in for the Django API: HTTP/1.1 with keep-alive on 127.0.0.1,
+// one thread per connection. Every POST goes to the handler, which fills in
+// the response body and returns the status (201 with {"ok":true} without a
+// handler). The handler runs on the connection's thread.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+class StandInServer {
+public:
+  typedef std::function<int(const std::string &path, const std::string &body, std::string &response)> Handler;
+
+  std::atomic<uint32_t> connections{0};
+  std::atomic<uint32_t> requests{0};
+
+  // Binds a free port; false if the socket couldn't be opened
+  bool start(Handler h = Handler()) {
+    handler = h;
+    signal(SIGPIPE, SIG_IGN);  // a client that hung up is not a reason to die
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 64) < 0 ||
+        getsockname(listenFd, (sockaddr *)&addr, &len) < 0) {
+      close(listenFd);
+      return false;
+    }
+    boundPort = ntohs(addr.sin_port);
+    std::thread([this]() { acceptLoop(); }).detach();
+    return true;
+  }
+
+  uint16_t port() const { return boundPort; }
+
+  // Close every open connection, like a server restart or an idle timeout
+  void dropConnections() {
+    std::lock_guard<std::mutex> lock(m);
+    for (int fd : open) shutdown(fd, SHUT_RDWR);
+  }
+
+private:
+  Handler handler;
+  int listenFd = -1;
+  uint16_t boundPort = 0;
+  std::mutex m;
+  std::set<int> open;
+
+  void acceptLoop() {
+    for (;;) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) return;
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      connections++;
+      {
+        std::lock_guard<std::mutex> lock(m);
+        open.insert(fd);
+      }
+      std::thread([this, fd]() { serve(fd); }).detach();
+    }
+  }
+
+  void serve(int fd) {
+    std::string in;
+    char buf[4096];
+    for (;;) {
+      size_t end = in.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        in.append(buf, n);
+        continue;
+      }
+      std::string head = in.substr(0, end);
+      size_t length = 0;
+      size_t at = head.find("Content-Length:");
+      if (at != std::string::npos) length = strtoul(head.c_str() + at + 15, nullptr, 10);
+      while (in.size() < end + 4 + length) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        in.append(buf, n);
+      }
+      if (in.size() < end + 4 + length) break;
+
+      size_t pathStart = head.find(' ') + 1;
+      std::string path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+      std::string body = in.substr(end + 4, length);
+      in.erase(0, end + 4 + length);
+      bool closeAfter = head.find("Connection: close") != std::string::npos;
+
+      requests++;
+      std::string response = "{\"ok\":true}";
+      int status = handler ? handler(path, body, response) : 201;
+      if (status <= 0) break;  // handler asked to drop the connection
+
+      char reply[256];
+      int n = snprintf(reply, sizeof(reply), "HTTP/1.1 %d X\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %u\r\nConnection: %s\r\n\r\n",
+                       status, (unsigned)response.size(), closeAfter ? "close" : "keep-alive");
+      std::string out(reply, n);
+      out += response;
+      if (send(fd, out.data(), out.size(), 0) != (ssize_t)out.size() || closeAfter) break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m);
+      open.erase(fd);
+    }
+    close(fd);
+  }
+};
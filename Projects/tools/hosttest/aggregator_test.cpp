@@ -0,0 +1,199 @@
+// SensorAggregator: when records come out, what their window summary holds,
+// and flush(), which closes the open window when WiFi drops so the last
+// record before an outage covers every reading up to it. A simulated day
+// of DHT11 readings shows how many records reach SensorBuffer.
+
+#include <LittleFS.h>
+#include <SensorAggregator.h>
+#include <SensorBuffer.h>
+
+#include <random>
+
+#include "hosttest.h"
+
+static const uint32_t PERIOD_MS = 15000;  // web's sensor interval
+
+static void testFirstReading() {
+  SensorAggregator agg;
+  SensorSample s;
+  CHECK(agg.add(22.0f, 50.0f, 1000, 0, s));
+  CHECK_EQ(s.count, 1);
+  CHECK_EQ(s.timestamp, 1000u);
+  CHECK_EQ(s.tempMean, 220);
+  CHECK_EQ(s.humMean, 500);
+  CHECK(!agg.add(22.0f, 50.0f, 1015, PERIOD_MS, s));
+}
+
+static void testTriggers() {
+  AggregatorConfig config;
+  SensorAggregator agg(config);
+  SensorSample s;
+  uint32_t t = 0;
+  agg.add(22.0f, 50.0f, 0, t, s);
+
+  // A step of 2 C: the EWMA crosses 1 C on the third reading (2 * (1 - 0.75^3))
+  int readings = 0;
+  bool emitted = false;
+  while (!emitted && readings < 10) {
+    t += PERIOD_MS;
+    emitted = agg.add(24.0f, 50.0f, 0, t, s);
+    readings++;
+  }
+  CHECK_EQ(readings, 3);
+  CHECK_EQ(s.count, 3);
+  CHECK_EQ(s.tempMin, 240);
+  CHECK(s.temperature > 23.0f && s.temperature < 24.0f);
+
+  // Humidity needs 3 %RH
+  readings = 0;
+  emitted = false;
+  while (!emitted && readings < 10) {
+    t += PERIOD_MS;
+    emitted = agg.add(24.0f, 58.0f, 0, t, s);
+    readings++;
+  }
+  CHECK(emitted);
+  CHECK(readings <= 2);
+
+  // Nothing moves: a record once the window is windowMs old
+  uint32_t since = t + PERIOD_MS;
+  readings = 0;
+  emitted = false;
+  while (!emitted && readings < 100) {
+    t += PERIOD_MS;
+    emitted = agg.add(s.temperature, s.humidity, 0, t, s);
+    readings++;
+  }
+  CHECK(emitted);
+  CHECK_EQ(t - since, config.windowMs);
+  CHECK_EQ(s.count, config.windowMs / PERIOD_MS + 1);
+}
+
+// One reading 3 C up moves the EWMA less than tempDelta, but the window's
+// max keeps it
+static void testShortExcursion() {
+  SensorAggregator agg;
+  SensorSample s;
+  uint32_t t = 0;
+  agg.add(22.0f, 50.0f, 0, t, s);
+  bool early = false;
+  for (int i = 1; i <= 9; i++) {
+    t += PERIOD_MS;
+    early |= agg.add(i == 4 ? 25.0f : 22.0f, 50.0f, 0, t, s);
+  }
+  CHECK(!early);
+  CHECK(agg.flush(0, s));
+  CHECK_EQ(s.count, 9);
+  CHECK_EQ(s.tempMax, 250);
+  CHECK_EQ(s.tempMin, 220);
+  CHECK_EQ(s.tempMean, 223);
+}
+
+static void testFlush() {
+  SensorAggregator agg;
+  SensorSample s;
+  CHECK(!agg.flush(500, s));  // nothing read yet
+
+  uint32_t t = 0;
+  agg.add(22.0f, 50.0f, 1000, t, s);
+  CHECK(!agg.flush(1000, s));  // the first reading went out on its own
+  CHECK_EQ(agg.records(), 1);
+
+  const float temps[] = { 22.2f, 21.8f, 22.4f };
+  for (float v : temps) {
+    t += PERIOD_MS;
+    CHECK(!agg.add(v, 51.0f, 1000 + t / 1000, t, s));
+  }
+  CHECK(agg.flush(1045, s));
+  CHECK_EQ(agg.records(), 2);
+  CHECK_EQ(s.timestamp, 1045u);
+  CHECK_EQ(s.count, 3);
+  CHECK_EQ(s.tempMin, 218);
+  CHECK_EQ(s.tempMax, 224);
+  CHECK_EQ(s.tempMean, 221);
+  CHECK_EQ(s.humMean, 510);
+  float ewma = s.temperature;
+  CHECK(!agg.flush(1045, s));
+
+  // A fresh window; the EWMA carries on rather than being reseeded, so
+  // the next reading isn't a record of its own
+  t += PERIOD_MS;
+  CHECK(!agg.add(22.0f, 51.0f, 1060, t, s));
+  CHECK(agg.flush(1060, s));
+  CHECK_EQ(s.count, 1);
+  CHECK(fabsf(s.temperature - (ewma + 0.25f * (22.0f - ewma))) < 1e-4f);
+
+  // The window timer restarts after a flush too
+  AggregatorConfig config;
+  uint32_t start = t + PERIOD_MS;
+  bool emitted = false;
+  while (!emitted) {
+    t += PERIOD_MS;
+    emitted = agg.add(22.0f, 51.0f, 0, t, s);
+  }
+  CHECK_EQ(t - start, config.windowMs);
+}
+
+// What the firmware does when WiFi drops: the flushed record is buffered
+// with its window like any other
+static void testOfflineRecord() {
+  hostFiles().clear();
+  SensorAggregator agg;
+  SensorBuffer buffer;
+  buffer.begin();
+  SensorSample s;
+  uint32_t t = 0;
+  if (agg.add(22.0f, 50.0f, 1710484200, t, s)) buffer.push(s);
+  for (int i = 0; i < 4; i++) {
+    t += PERIOD_MS;
+    if (agg.add(22.5f, 50.0f, 1710484200 + t / 1000, t, s)) buffer.push(s);
+  }
+  CHECK_EQ(buffer.pending(), 1);
+  if (agg.flush(1710484260, s)) buffer.push(s);
+  CHECK_EQ(buffer.pending(), 2);
+
+  char json[1024];
+  CHECK_EQ(buffer.buildBatch(json, sizeof(json), sizeof(json)), 2);
+  CHECK(strstr(json, "\"timestamp\":\"2024-03-15 06:31:00\",\"window\":{\"n\":4,") != nullptr);
+}
+
+// A day of whole-degree DHT11 readings with a slow sine and one reading
+// 8 C too high
+static void testDay() {
+  const uint32_t DAY = 86400000;
+  for (uint32_t period : { 2000u, PERIOD_MS }) {
+    SensorAggregator agg;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-0.6f, 0.6f);
+    SensorSample s;
+    uint32_t records = 0;
+    bool spikeKept = false;
+    for (uint32_t t = 0; t < DAY; t += period) {
+      float base = 22 + 4 * sinf(t * 2 * M_PI / DAY);
+      float temp = roundf(base + noise(rng));
+      float hum = roundf(50 + 10 * sinf(t * 2 * M_PI / DAY + 1) + noise(rng) * 3);
+      if (t >= 40000000 && t < 40000000 + period) temp += 8;
+      if (agg.add(temp, hum, t / 1000, t, s)) {
+        records++;
+        spikeKept |= s.tempMax >= (int16_t)((base + 7) * 10);
+      }
+    }
+    printf("one reading every %2u s: %5u readings, %3u records (%.0fx fewer)\n", period / 1000, agg.readings(),
+           records, (double)agg.readings() / records);
+    CHECK(spikeKept);
+    CHECK(records * 5 < agg.readings());
+    // A window closes on the first reading windowMs after it opened
+    CHECK(records >= DAY / (AggregatorConfig().windowMs + period));
+  }
+}
+
+int main() {
+  hostSerialQuiet = true;
+  testFirstReading();
+  testTriggers();
+  testShortExcursion();
+  testFlush();
+  testOfflineRecord();
+  testDay();
+  return hostTestDone("aggregator_test");
+}
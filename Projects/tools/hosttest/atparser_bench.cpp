@@ -0,0 +1,79 @@
+// AtParser throughput: every transcript in corpus/at, CRLF on the wire,
+// fed byte by byte over and over, plus one full-SIM +CMGL listing (30
+// messages of 160 characters) as a worst case for the modem task.
+//
+// Usage: atparser_bench [corpus dir]   (default corpus/at)
+
+#include <AtParser.h>
+
+#include <dirent.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "hosttest.h"
+
+static uint32_t events = 0;
+static uint32_t listed = 0;
+
+static void onEvent(const AtEvent &ev) {
+  events++;
+  if (ev.type == AT_EVENT_CMGL) listed++;
+}
+
+static double run(AtParser &parser, const std::string &wire, int rounds) {
+  double start = hostSeconds();
+  for (int r = 0; r < rounds; r++) {
+    for (char c : wire) parser.feed(c);
+    parser.flush();
+  }
+  return hostSeconds() - start;
+}
+
+int main(int argc, char **argv) {
+  std::string dir = argc > 1 ? argv[1] : "corpus/at";
+  std::string wire;
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    perror(dir.c_str());
+    return 1;
+  }
+  while (dirent *e = readdir(d)) {
+    std::string n = e->d_name;
+    if (n.size() < 3 || n.compare(n.size() - 3, 3, ".at") != 0) continue;
+    std::ifstream f((dir + "/" + n).c_str(), std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    for (char c : ss.str()) {
+      if (c == '\n') wire += '\r';
+      wire += c;
+    }
+    wire += "\r\nOK\r\n";  // close any message left open between transcripts
+  }
+  closedir(d);
+
+  AtParser parser(onEvent);
+  const int ROUNDS = 20000;
+  double t = run(parser, wire, ROUNDS);
+  double bytes = (double)wire.size() * ROUNDS;
+  printf("corpus:  %.1f MB/s, %.2f M events/s (%zu bytes a round)\n", bytes / t / 1e6, events / t / 1e6,
+         wire.size());
+
+  std::string listing = "AT+CMGL=\"ALL\"\r\r\n";
+  for (int i = 1; i <= 30; i++) {
+    char head[96];
+    snprintf(head, sizeof(head), "+CMGL: %d,\"REC READ\",\"+260970846745\",\"\",\"24/01/01,10:00:%02d+08\"\r\n", i,
+             i);
+    listing += head;
+    listing += std::string(160, 'a' + i % 26) + "\r\n";
+  }
+  listing += "\r\nOK\r\n";
+  events = listed = 0;
+  const int LISTINGS = 20000;
+  t = run(parser, listing, LISTINGS);
+  printf("listing: %.2f us per 30-message +CMGL (%zu bytes), %.1f MB/s\n", t / LISTINGS * 1e6, listing.size(),
+         listing.size() * (double)LISTINGS / t / 1e6);
+  CHECK_EQ(listed, 30 * LISTINGS);
+  return hostTestDone("atparser_bench");
+}
@@ -0,0 +1,110 @@
+// AtParser against the recorded modem transcripts in corpus/at.
+// Each NAME.at is what the SIM900 sent (LF in the file, CRLF on the wire)
+// and NAME.expected lists the events it must produce, one per line. The
+// parser is fed one byte at a time and flushed at the end, as the modem
+// task does when the UART goes quiet.
+//
+// Usage: atparser_test [corpus dir]   (default corpus/at)
+
+#include <AtParser.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hosttest.h"
+
+static std::vector<std::string> events;
+
+static std::string quoted(const char *s) {
+  std::string out = "\"";
+  for (; *s; s++) {
+    if (*s == '\n') out += "\\n";
+    else out += *s;
+  }
+  return out + "\"";
+}
+
+static void onEvent(const AtEvent &ev) {
+  std::string line;
+  switch (ev.type) {
+  case AT_EVENT_OK: line = "OK"; break;
+  case AT_EVENT_ERROR: line = "ERROR"; break;
+  case AT_EVENT_CMTI: line = "CMTI index=" + std::to_string(ev.index); break;
+  case AT_EVENT_CMT: line = "CMT sender=" + quoted(ev.sender) + " body=" + quoted(ev.body); break;
+  case AT_EVENT_CMGL:
+    line = "CMGL index=" + std::to_string(ev.index) + " status=" + quoted(ev.status) +
+           " sender=" + quoted(ev.sender) + " body=" + quoted(ev.body);
+    break;
+  case AT_EVENT_CMGR:
+    line = "CMGR status=" + quoted(ev.status) + " sender=" + quoted(ev.sender) + " body=" + quoted(ev.body);
+    break;
+  case AT_EVENT_PROMPT: line = "PROMPT"; break;
+  }
+  events.push_back(line);
+}
+
+static bool readFile(const std::string &path, std::string &out) {
+  std::ifstream f(path.c_str(), std::ios::binary);
+  if (!f) return false;
+  std::stringstream ss;
+  ss << f.rdbuf();
+  out = ss.str();
+  return true;
+}
+
+static std::vector<std::string> lines(const std::string &text) {
+  std::vector<std::string> out;
+  std::stringstream ss(text);
+  std::string line;
+  while (std::getline(ss, line)) out.push_back(line);
+  return out;
+}
+
+int main(int argc, char **argv) {
+  std::string dir = argc > 1 ? argv[1] : "corpus/at";
+  std::vector<std::string> names;
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    perror(dir.c_str());
+    return 1;
+  }
+  while (dirent *e = readdir(d)) {
+    std::string n = e->d_name;
+    if (n.size() > 3 && n.compare(n.size() - 3, 3, ".at") == 0) names.push_back(n.substr(0, n.size() - 3));
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  CHECK(!names.empty());
+
+  for (const std::string &name : names) {
+    std::string transcript, expectedText;
+    if (!readFile(dir + "/" + name + ".at", transcript) || !readFile(dir + "/" + name + ".expected", expectedText)) {
+      fprintf(stderr, "%s: missing .at or .expected\n", name.c_str());
+      hostFailures++;
+      continue;
+    }
+    events.clear();
+    AtParser parser(onEvent);
+    for (char c : transcript) {
+      if (c == '\n') parser.feed('\r');
+      parser.feed(c);
+    }
+    parser.flush();
+
+    std::vector<std::string> expected = lines(expectedText);
+    if (events != expected) {
+      hostFailures++;
+      fprintf(stderr, "%s: events differ\n  expected:\n", name.c_str());
+      for (const std::string &l : expected) fprintf(stderr, "    %s\n", l.c_str());
+      fprintf(stderr, "  got:\n");
+      for (const std::string &l : events) fprintf(stderr, "    %s\n", l.c_str());
+    }
+  }
+  printf("%zu transcripts\n", names.size());
+  return hostTestDone("atparser_test");
+}
@@ -0,0 +1,206 @@
+// CardReader against the RC522 model in stubs/MFRC522.h, on the manual
+// clock with loop() passes every 10 ms: a tap is one event, a card held on
+// the reader stays silent (it is halted and nothing is read back while no
+// card answers), a card put back within DEDUPE_MS is suppressed and one
+// put back after it is a new tap. The IRQ-driven path and the polling
+// fallback must produce the same events.
+
+#include <CardReader.h>
+
+#include <vector>
+
+#include "hosttest.h"
+
+static const int8_t IRQ_PIN = 34;
+static const uint8_t CARD_A[] = { 0x04, 0xA1, 0xB2, 0xC3 };
+static const uint8_t CARD_B[] = { 0x5E, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+static const uint8_t CARD_C[] = { 0x04, 0xC0, 0xFF, 0xEE };
+
+// Run loop() for ms, collecting events; polling mode's scans take time too
+static void run(CardReader &reader, uint32_t ms, std::vector<CardEvent> &events) {
+  for (uint32_t start = millis(); millis() - start < ms;) {
+    reader.poll();
+    CardEvent e;
+    while (reader.read(e)) events.push_back(e);
+    hostAdvanceMillis(10);
+  }
+}
+
+static bool isCard(const CardEvent &e, const uint8_t *uid, uint8_t size) {
+  return e.size == size && memcmp(e.uid, uid, size) == 0;
+}
+
+// The same taps in both modes; returns the reader's counters
+static CardReaderStats taps(MFRC522 &rc522, CardReader &reader) {
+  std::vector<CardEvent> events;
+  rc522.PCD_Init();
+  reader.begin();
+
+  // Nobody there: probes only
+  run(reader, 1000, events);
+  CHECK(events.empty());
+  CHECK_EQ(reader.stats().probes, 10);
+
+  // Tapped and held for 10 s: one event, read within one probe period
+  uint32_t placed = millis();
+  rc522.hostPlace(CARD_A, sizeof(CARD_A));
+  run(reader, 10000, events);
+  CHECK_EQ(events.size(), 1);
+  if (events.size() == 1) {
+    CHECK(isCard(events[0], CARD_A, sizeof(CARD_A)));
+    CHECK(events[0].at - placed <= CardReader::PROBE_MS + 10);
+    char hex[2 * CardEvent::MAX_UID + 1];
+    events[0].toHex(hex, sizeof(hex));
+    CHECK(strcmp(hex, "04a1b2c3") == 0);
+  }
+  CHECK_EQ(reader.stats().reads, 1);
+  CHECK_EQ(rc522.reqaAnswered, 1);
+
+  // Lifted after the hold and tapped again: the window counts from the
+  // read, so that's a new tap
+  rc522.hostRemove();
+  run(reader, 500, events);
+  rc522.hostPlace(CARD_A, sizeof(CARD_A));
+  run(reader, 500, events);
+  CHECK_EQ(events.size(), 2);
+
+  // Lifted and put back within DEDUPE_MS of that: read, but not an event
+  rc522.hostRemove();
+  run(reader, 500, events);
+  rc522.hostPlace(CARD_A, sizeof(CARD_A));
+  run(reader, 500, events);
+  CHECK_EQ(events.size(), 2);
+  CHECK_EQ(reader.stats().reads, 3);
+  CHECK_EQ(reader.stats().duplicates, 1);
+  CHECK_EQ(rc522.reqaAnswered, 3);
+
+  // Another card right after is its own tap
+  rc522.hostRemove();
+  rc522.hostPlace(CARD_B, sizeof(CARD_B));
+  run(reader, 500, events);
+  CHECK_EQ(events.size(), 3);
+  if (events.size() == 3) CHECK(isCard(events[2], CARD_B, sizeof(CARD_B)));
+
+  // And card A once the window has run out
+  rc522.hostRemove();
+  run(reader, CardReader::DEDUPE_MS, events);
+  rc522.hostPlace(CARD_A, sizeof(CARD_A));
+  run(reader, 500, events);
+  CHECK_EQ(events.size(), 4);
+
+  // The select fails once: counted, and the next probe reads the card
+  rc522.hostRemove();
+  run(reader, 500, events);
+  rc522.hostFailSelects = 1;
+  rc522.hostPlace(CARD_C, sizeof(CARD_C));
+  run(reader, 500, events);
+  CHECK_EQ(reader.stats().readErrors, 1);
+  CHECK_EQ(events.size(), 5);
+  CHECK_EQ(reader.stats().dropped, 0);
+  rc522.hostRemove();
+  return reader.stats();
+}
+
+static void testIrq() {
+  hostSetMillis(1000);
+  MFRC522 rc522;
+  rc522.hostIrqPin = IRQ_PIN;
+  CardReader reader(rc522, IRQ_PIN);
+  CardReaderStats s = taps(rc522, reader);
+  CHECK_EQ(s.interrupts, s.reads + s.readErrors);
+
+  // Idle: five register writes a probe, never a read
+  std::vector<CardEvent> events;
+  uint32_t writes = rc522.spiWrites, reads = rc522.spiReads, probes = reader.stats().probes;
+  run(reader, 10000, events);
+  CHECK_EQ(reader.stats().probes - probes, 100);
+  CHECK_EQ(rc522.spiWrites - writes, 5 * 100);
+  CHECK_EQ(rc522.spiReads - reads, 0);
+
+  // Held: no interrupt either once the card is halted
+  rc522.hostPlace(CARD_B, sizeof(CARD_B));
+  run(reader, 500, events);
+  uint32_t interrupts = reader.stats().interrupts;
+  reads = rc522.spiReads;
+  run(reader, 10000, events);
+  CHECK_EQ(reader.stats().interrupts, interrupts);
+  CHECK_EQ(rc522.spiReads, reads);
+  CHECK_EQ(events.size(), 1);
+
+  // end(): no probes, and a new card raises nothing
+  rc522.hostRemove();
+  reader.end();
+  probes = reader.stats().probes;
+  rc522.hostPlace(CARD_A, sizeof(CARD_A));
+  run(reader, 1000, events);
+  CHECK_EQ(reader.stats().probes, probes);
+  CHECK_EQ(events.size(), 1);
+
+  // begin() again re-arms it
+  reader.begin();
+  run(reader, 500, events);
+  CHECK_EQ(events.size(), 2);
+}
+
+static void testPolling() {
+  hostSetMillis(1000);
+  MFRC522 rc522;
+  rc522.hostRxTimeoutMs = 25;
+  CardReader reader(rc522);
+  CardReaderStats s = taps(rc522, reader);
+  CHECK_EQ(s.interrupts, 0);
+}
+
+// A card at the edge of the field, in and out every 200 ms for 10 s: one
+// event, since every read restarts the window
+static void testBouncing() {
+  hostSetMillis(1000);
+  MFRC522 rc522;
+  rc522.hostIrqPin = IRQ_PIN;
+  CardReader reader(rc522, IRQ_PIN);
+  rc522.PCD_Init();
+  reader.begin();
+  std::vector<CardEvent> events;
+  for (int i = 0; i < 25; i++) {
+    rc522.hostPlace(CARD_A, sizeof(CARD_A));
+    run(reader, 200, events);
+    rc522.hostRemove();
+    run(reader, 200, events);
+  }
+  CHECK_EQ(events.size(), 1);
+  CHECK_EQ(reader.stats().reads, 25);
+  CHECK_EQ(reader.stats().duplicates, 24);
+}
+
+// Taps faster than the consumer drains: the fifth is dropped and counted
+static void testQueueFull() {
+  hostSetMillis(1000);
+  MFRC522 rc522;
+  rc522.hostIrqPin = IRQ_PIN;
+  CardReader reader(rc522, IRQ_PIN);
+  rc522.PCD_Init();
+  reader.begin();
+  for (uint8_t i = 0; i < CardReader::QUEUE + 1; i++) {
+    uint8_t uid[4] = { 0x04, 0x00, 0x00, i };
+    rc522.hostPlace(uid, sizeof(uid));
+    for (int t = 0; t < 20; t++) {
+      reader.poll();
+      hostAdvanceMillis(10);
+    }
+    rc522.hostRemove();
+  }
+  CHECK_EQ(reader.stats().dropped, 1);
+  CardEvent e;
+  uint8_t n = 0;
+  while (reader.read(e)) CHECK_EQ(e.uid[3], n++);
+  CHECK_EQ(n, CardReader::QUEUE);
+}
+
+int main() {
+  hostSerialQuiet = true;
+  testIrq();
+  testPolling();
+  testBouncing();
+  testQueueFull();
+  return hostTestDone("cardreader_test");
+}
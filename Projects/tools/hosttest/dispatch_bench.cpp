@@ -0,0 +1,133 @@
+// Command dispatch cost: the hashed CommandRegistry table against the
+// if/else ladder it replaced, which copied each message into a heap String,
+// uppercased it and compared it with every name in turn. Both see the same
+// mix of messages as SMS, WebSocket and console lines send them. Only the
+// lookup is timed; handlers are empty. The table is checked too, including
+// which sources may run the door and power commands.
+
+#include <CommandRegistry.h>
+
+#include <string>
+
+#include "hosttest.h"
+
+#define HANDLER(n) \
+  static void handler##n(CommandContext &) {}
+HANDLER(0) HANDLER(1) HANDLER(2) HANDLER(3) HANDLER(4) HANDLER(5) HANDLER(6)
+HANDLER(7) HANDLER(8) HANDLER(9) HANDLER(10) HANDLER(11) HANDLER(12)
+
+// Same names as the smarthome firmware's table
+constexpr CommandEntry COMMANDS[] = {
+  COMMAND("OPEN", handler0, false, COMMAND_VIA_ADMIN),
+  COMMAND("CLOSE", handler1, false, COMMAND_VIA_ADMIN),
+  COMMAND("GRANTED", handler2, false, COMMAND_VIA_ADMIN | COMMAND_VIA_WEBSOCKET),
+  COMMAND("DENIED", handler3, false, COMMAND_VIA_ADMIN | COMMAND_VIA_WEBSOCKET),
+  COMMAND("ON", handler4, false, COMMAND_VIA_ANY),
+  COMMAND("OFF", handler5, false, COMMAND_VIA_ANY),
+  COMMAND("BULB_ON", handler6, false, COMMAND_VIA_ANY),
+  COMMAND("BULB_OFF", handler7, false, COMMAND_VIA_ANY),
+  COMMAND("TOGGLE", handler8, false, COMMAND_VIA_ANY),
+  COMMAND("SHUTDOWN", handler9, true, COMMAND_VIA_ADMIN),
+  COMMAND("RESTART", handler10, true, COMMAND_VIA_ADMIN),
+  COMMAND("STATUS", handler11, false, COMMAND_VIA_ANY),
+  COMMAND("METRICS", handler12, false, COMMAND_VIA_ANY),
+};
+static_assert(commandSlotsUnique(COMMANDS, COMMAND_COUNT(COMMANDS)), "Command names collide");
+constexpr uint8_t SLOTS[COMMAND_SLOTS] = COMMAND_SLOT_TABLE(COMMANDS);
+
+static const uint8_t COUNT = COMMAND_COUNT(COMMANDS);
+
+// The old processCommand(): String copy, trim, toUpperCase, ladder
+static int ladder(const char *text, size_t len) {
+  char *s = (char *)malloc(len + 1);
+  memcpy(s, text, len);
+  s[len] = '\0';
+  char *b = s, *e = s + len;
+  while (b < e && isspace((uint8_t)*b)) b++;
+  while (e > b && isspace((uint8_t)e[-1])) e--;
+  *e = '\0';
+  for (char *p = b; *p; p++) *p = toupper((uint8_t)*p);
+  int found = -1;
+  for (uint8_t i = 0; i < COUNT && found < 0; i++) {
+    if (strcmp(b, COMMANDS[i].name) == 0) found = i;
+  }
+  free(s);
+  return found;
+}
+
+static int registry(const char *text, size_t len, CommandContext &ctx) {
+  const CommandEntry *e = lookupCommand(COMMANDS, SLOTS, text, len, ctx);
+  return e ? (int)(e - COMMANDS) : -1;
+}
+
+static void testLookup() {
+  CommandContext ctx;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    std::string lower = COMMANDS[i].name;
+    for (char &c : lower) c = tolower(c);
+    CHECK_EQ(registry(COMMANDS[i].name, strlen(COMMANDS[i].name), ctx), i);
+    CHECK_EQ(registry(lower.c_str(), lower.size(), ctx), i);
+  }
+  const char *args = "  Metrics   reset \r\n";
+  CHECK_EQ(registry(args, strlen(args), ctx), 12);
+  CHECK(strcmp(ctx.args, "reset") == 0);
+  // Only len bytes count, as with a MegaLink payload
+  CHECK_EQ(registry("OPENED", 4, ctx), 0);
+  CHECK_EQ(registry("OPENED", 6, ctx), -1);
+  CHECK_EQ(registry("", 0, ctx), -1);
+  CHECK_EQ(registry("AVERYVERYLONGCOMMANDWORD", 24, ctx), -1);
+}
+
+// Door and power commands only from an admin SMS or an authenticated
+// broker session
+static void testSources() {
+  const char *admin[] = { "OPEN", "CLOSE", "SHUTDOWN", "RESTART" };
+  CommandContext ctx;
+  for (const char *name : admin) {
+    const CommandEntry *e = lookupCommand(COMMANDS, SLOTS, name, strlen(name), ctx);
+    CHECK(e != nullptr);
+    if (!e) continue;
+    CHECK(e->via & commandSource(TRANSPORT_SMS, false));
+    CHECK(e->via & commandSource(TRANSPORT_MQTT, true));
+    CHECK(!(e->via & commandSource(TRANSPORT_MQTT, false)));
+    CHECK(!(e->via & commandSource(TRANSPORT_WEBSOCKET, false)));
+    CHECK(!(e->via & commandSource(TRANSPORT_MEGA, false)));
+  }
+  const CommandEntry *status = lookupCommand(COMMANDS, SLOTS, "STATUS", 6, ctx);
+  CHECK(status && (status->via & commandSource(TRANSPORT_MEGA, false)) &&
+        (status->via & commandSource(TRANSPORT_MQTT, false)));
+}
+
+int main() {
+  testLookup();
+  testSources();
+
+  const char *mix[] = { "open", "STATUS", " bulb_off\r\n", "METRICS reset", "Toggle", "shutdown", "nope" };
+  const size_t MIX = sizeof(mix) / sizeof(mix[0]);
+  size_t lens[MIX];
+  for (size_t i = 0; i < MIX; i++) lens[i] = strlen(mix[i]);
+
+  const uint32_t ROUNDS = 2000000;
+  CommandContext ctx;
+  long sum = 0;
+  double start = hostSeconds();
+  for (uint32_t r = 0; r < ROUNDS; r++) {
+    for (size_t i = 0; i < MIX; i++) sum += registry(mix[i], lens[i], ctx);
+  }
+  double tRegistry = hostSeconds() - start;
+
+  long sumLadder = 0;
+  start = hostSeconds();
+  for (uint32_t r = 0; r < ROUNDS; r++) {
+    for (size_t i = 0; i < MIX; i++) sumLadder += ladder(mix[i], lens[i]);
+  }
+  double tLadder = hostSeconds() - start;
+
+  double n = (double)ROUNDS * MIX;
+  printf("registry: %6.1f ns/dispatch\n", tRegistry / n * 1e9);
+  printf("ladder:   %6.1f ns/dispatch (heap copy + uppercase + %u compares)\n", tLadder / n * 1e9,
+         (unsigned)COUNT);
+  // The ladder doesn't split off arguments, so "METRICS reset" misses there
+  CHECK_EQ(sum - sumLadder, (long)ROUNDS * (12 - -1));
+  return hostTestDone("dispatch_bench");
+}
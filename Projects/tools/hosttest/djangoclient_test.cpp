@@ -0,0 +1,187 @@
+// DjangoClient against the local stand-in server: completions, priorities,
+// the bounded queue's drop and eviction rules, expiry and offline handling.
+// The worker is a real thread talking HTTP to the stand-in through the
+// host HTTPClient, so this is the firmware's code path end to end.
+
+#include <DjangoClient.h>
+
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StandInServer.h"
+#include "hosttest.h"
+
+struct Completion {
+  int code;
+  std::string context;
+  std::string body;
+};
+
+static std::vector<Completion> completions;
+static StandInServer server;
+static DjangoClient *client;
+
+// /api/hold/ parks the worker until release(), so the tests can fill the
+// queue behind it
+static std::mutex gateLock;
+static std::condition_variable gateCv;
+static bool gateOpen = true;
+static std::atomic<bool> held(false);
+
+static int handle(const std::string &path, const std::string &body, std::string &response) {
+  if (path == "/api/hold/") {
+    std::unique_lock<std::mutex> lock(gateLock);
+    held = true;
+    gateCv.wait(lock, []() { return gateOpen; });
+    return 200;
+  }
+  response = body;
+  return 201;
+}
+
+static void record(const DjangoResponse &res) {
+  Completion c = { res.code, res.context, res.body };
+  completions.push_back(c);
+}
+
+static void hold() {
+  {
+    std::lock_guard<std::mutex> lock(gateLock);
+    gateOpen = false;
+  }
+  held = false;
+  client->post("/api/hold/", "{}", DJANGO_PRIO_SENSOR, 5000, record, "hold");
+  while (!held) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static void release() {
+  std::lock_guard<std::mutex> lock(gateLock);
+  gateOpen = true;
+  gateCv.notify_all();
+}
+
+// Run callbacks until n have arrived in total, or give up after 3 s
+static bool pumpUntil(size_t n) {
+  for (int i = 0; i < 3000 && completions.size() < n; i++) {
+    client->poll();
+    if (completions.size() < n) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return completions.size() >= n;
+}
+
+static void testRoundTrip() {
+  completions.clear();
+  CHECK(client->post("/api/check-auth/", "{\"uid\":\"A1\"}", DJANGO_PRIO_AUTH, 2000, record, "card"));
+  CHECK(pumpUntil(1));
+  CHECK_EQ(completions[0].code, 201);
+  CHECK(completions[0].context == "card");
+  CHECK(completions[0].body == "{\"uid\":\"A1\"}");
+}
+
+static void testPriority() {
+  completions.clear();
+  hold();
+  CHECK(client->post("/api/sensor-data/", "[1]", DJANGO_PRIO_SENSOR, 5000, record, "s1"));
+  CHECK(client->post("/api/sensor-data/", "[2]", DJANGO_PRIO_SENSOR, 5000, record, "s2"));
+  CHECK(client->post("/api/check-auth/", "{}", DJANGO_PRIO_AUTH, 5000, record, "a1"));
+  release();
+  CHECK(pumpUntil(4));
+  const char *order[] = { "hold", "a1", "s1", "s2" };
+  for (size_t i = 0; i < 4 && i < completions.size(); i++) CHECK(completions[i].context == order[i]);
+}
+
+static void testEviction() {
+  completions.clear();
+  uint32_t droppedBefore = client->dropped();
+  hold();
+  char context[8];
+  for (uint8_t i = 0; i < DjangoClient::QUEUE_DEPTH; i++) {
+    snprintf(context, sizeof(context), "s%u", i);
+    CHECK(client->post("/api/sensor-data/", "[]", DJANGO_PRIO_SENSOR, 5000, record, context));
+  }
+  // Full: another sensor post is refused, an auth check pushes out s0
+  CHECK(!client->post("/api/sensor-data/", "[]", DJANGO_PRIO_SENSOR, 5000, record, "late"));
+  CHECK(client->post("/api/check-auth/", "{}", DJANGO_PRIO_AUTH, 5000, record, "auth"));
+
+  // The evicted request completes right away, while the worker is still stuck
+  CHECK(pumpUntil(1));
+  CHECK_EQ(completions.size(), 1);
+  CHECK(completions[0].context == "s0");
+  CHECK_EQ(completions[0].code, DJANGO_ERR_EVICTED);
+
+  release();
+  CHECK(pumpUntil(1 + 1 + DjangoClient::QUEUE_DEPTH));
+  CHECK_EQ(completions.size(), 1 + 1 + DjangoClient::QUEUE_DEPTH);
+  if (completions.size() > 2) {
+    CHECK(completions[1].context == "hold");
+    CHECK(completions[2].context == "auth");
+  }
+  // Every accepted request got exactly one completion
+  for (uint8_t i = 0; i < DjangoClient::QUEUE_DEPTH; i++) {
+    snprintf(context, sizeof(context), "s%u", i);
+    int seen = 0;
+    for (const Completion &c : completions) seen += c.context == context;
+    CHECK_EQ(seen, 1);
+  }
+  CHECK_EQ(client->dropped() - droppedBefore, 2);
+}
+
+static void testFullOfAuth() {
+  completions.clear();
+  hold();
+  for (uint8_t i = 0; i < DjangoClient::QUEUE_DEPTH; i++) {
+    CHECK(client->post("/api/check-auth/", "{}", DJANGO_PRIO_AUTH, 5000, record, "a"));
+  }
+  // Nothing left to evict
+  CHECK(!client->post("/api/check-auth/", "{}", DJANGO_PRIO_AUTH, 5000, record, "extra"));
+  CHECK(!client->post("/api/sensor-data/", "[]", DJANGO_PRIO_SENSOR, 5000, record, "extra"));
+  release();
+  CHECK(pumpUntil(1 + DjangoClient::QUEUE_DEPTH));
+  for (const Completion &c : completions) CHECK(c.context != "extra");
+}
+
+static void testExpired() {
+  completions.clear();
+  hold();
+  CHECK(client->post("/api/sensor-data/", "[]", DJANGO_PRIO_SENSOR, 20, record, "stale"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  release();
+  CHECK(pumpUntil(2));
+  CHECK(completions.size() == 2 && completions[1].code == DJANGO_ERR_EXPIRED);
+}
+
+static void testOffline() {
+  completions.clear();
+  WiFi.hostStatus = WL_DISCONNECTED;
+  CHECK(client->post("/api/check-auth/", "{}", DJANGO_PRIO_AUTH, 2000, record, "off"));
+  CHECK(pumpUntil(1));
+  CHECK_EQ(completions[0].code, DJANGO_ERR_OFFLINE);
+  WiFi.hostStatus = WL_CONNECTED;
+}
+
+int main() {
+  hostSerialQuiet = true;
+  if (!server.start(handle)) {
+    perror("stand-in server");
+    return 1;
+  }
+  client = new DjangoClient("127.0.0.1", server.port());
+  if (!client->begin()) {
+    fprintf(stderr, "worker didn't start\n");
+    return 1;
+  }
+
+  testRoundTrip();
+  testPriority();
+  testEviction();
+  testFullOfAuth();
+  testExpired();
+  testOffline();
+
+  // All of it over one keep-alive socket
+  CHECK_EQ(client->linkStats().connects, 1);
+  CHECK_EQ(server.connections, 1);
+  return hostTestDone("djangoclient_test");
+}
@@ -0,0 +1,265 @@
+// Geofence with 1000 zones around Lusaka (half circles of 200-1000 m, half
+// hexagons about 900 m across), loaded from a zone file on the host LittleFS.
+// Random fixes over the whole area go through the grid index, and the same
+// fixes through a linear scan that bbox-checks every zone in doubles, which
+// is also the reference the index must agree with: great circle distance
+// for circles, a flat frame around each hexagon for those. Fixes within 2 m
+// of a border are not compared.
+//
+// Then the borders themselves: zones spread over 2 degrees (~220 km) with
+// the first one in a corner, near Lusaka and at 60 N. Points are put on
+// each border along great circles, and the engine's border is found by
+// bisecting along the outward normal; how far it lies from the true one is
+// the error the Geofence.h header bounds.
+//
+// Usage: geofence_bench [--zones N] [--fixes N]
+
+#include <Geofence.h>
+#include <LittleFS.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "hosttest.h"
+
+struct RefZone {
+  bool circle;
+  double lat, lon, radius;          // circle centre, or the hexagon's
+  std::vector<double> vlat, vlon;   // polygon
+  std::vector<double> vx, vy;       // polygon, meters around lat/lon
+  double minLat, minLon, maxLat, maxLon;  // a little wider than the zone
+};
+
+static const double R = 6372795;  // TinyGPSPlus::distanceBetween's sphere
+static const double RAD = M_PI / 180;
+
+static double haversine(double lat1, double lon1, double lat2, double lon2) {
+  double a = sin((lat2 - lat1) * RAD / 2), b = sin((lon2 - lon1) * RAD / 2);
+  return 2 * R * asin(sqrt(a * a + cos(lat1 * RAD) * cos(lat2 * RAD) * b * b));
+}
+
+static double bearing(double lat1, double lon1, double lat2, double lon2) {
+  double dl = (lon2 - lon1) * RAD;
+  return atan2(sin(dl) * cos(lat2 * RAD),
+               cos(lat1 * RAD) * sin(lat2 * RAD) - sin(lat1 * RAD) * cos(lat2 * RAD) * cos(dl)) / RAD;
+}
+
+// The point d meters from lat/lon along the great circle leaving at brg
+static void destination(double lat, double lon, double brg, double d, double &outLat, double &outLon) {
+  double p = lat * RAD, t = brg * RAD, a = d / R;
+  double q = asin(sin(p) * cos(a) + cos(p) * sin(a) * cos(t));
+  outLat = q / RAD;
+  outLon = lon + atan2(sin(t) * sin(a) * cos(p), cos(a) - sin(p) * sin(q)) / RAD;
+}
+
+static void toFrame(const RefZone &z, double lat, double lon, double &x, double &y) {
+  x = (lon - z.lon) * RAD * R * cos(z.lat * RAD);
+  y = (lat - z.lat) * RAD * R;
+}
+
+static double segmentDistance(double px, double py, double ax, double ay, double bx, double by) {
+  double dx = bx - ax, dy = by - ay;
+  double t = ((px - ax) * dx + (py - ay) * dy) / (dx * dx + dy * dy);
+  t = std::max(0.0, std::min(1.0, t));
+  return hypot(px - (ax + t * dx), py - (ay + t * dy));
+}
+
+// 1 inside, 0 outside, -1 too close to the border to say
+static int refInside(const RefZone &z, double lat, double lon) {
+  if (lat < z.minLat || lat > z.maxLat || lon < z.minLon || lon > z.maxLon) return 0;
+  if (z.circle) {
+    double d = haversine(lat, lon, z.lat, z.lon) - z.radius;
+    return fabs(d) < 2 ? -1 : d < 0;
+  }
+  double x, y;
+  toFrame(z, lat, lon, x, y);
+  bool in = false;
+  size_t n = z.vx.size();
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    if (segmentDistance(x, y, z.vx[i], z.vy[i], z.vx[j], z.vy[j]) < 2) return -1;
+    if ((z.vy[i] > y) != (z.vy[j] > y) &&
+        x < (z.vx[j] - z.vx[i]) * (y - z.vy[i]) / (z.vy[j] - z.vy[i]) + z.vx[i]) {
+      in = !in;
+    }
+  }
+  return in;
+}
+
+static double round6(double v) { return round(v * 1e6) / 1e6; }
+
+// Half circles of 200-1000 m, half hexagons about 900 m across, spread
+// +-spread degrees around lat/lon; the first zone is at first
+static std::string makeZones(std::mt19937 &rng, uint32_t zones, double lat0, double lon0, double spread,
+                             double firstLat, double firstLon, std::vector<RefZone> &ref) {
+  std::uniform_real_distribution<double> around(-spread, spread);
+  std::string text = "# generated by geofence_bench\n";
+  char line[96];
+  for (uint32_t i = 0; i < zones; i++) {
+    RefZone z;
+    z.lat = round6(i ? lat0 + around(rng) : firstLat);
+    z.lon = round6(i ? lon0 + around(rng) : firstLon);
+    z.circle = i % 2 == 0;
+    double margin = 10 / (R * RAD);  // 10 m of latitude, in degrees
+    if (z.circle) {
+      z.radius = 200 + rng() % 800;
+      snprintf(line, sizeof(line), "circle z%u %.6f %.6f %u\n", i, z.lat, z.lon, (unsigned)z.radius);
+      text += line;
+      double dLat = z.radius / (R * RAD) + margin, dLon = dLat / cos(z.lat * RAD);
+      z.minLat = z.lat - dLat;
+      z.maxLat = z.lat + dLat;
+      z.minLon = z.lon - dLon;
+      z.maxLon = z.lon + dLon;
+    } else {
+      snprintf(line, sizeof(line), "poly z%u 6\n", i);
+      text += line;
+      for (int k = 0; k < 6; k++) {
+        double a = k * M_PI / 3;  // counterclockwise: the inside is on the left of each edge
+        double vlat = round6(z.lat + 0.004 * sin(a)), vlon = round6(z.lon + 0.004 * cos(a));
+        snprintf(line, sizeof(line), "%.6f %.6f\n", vlat, vlon);
+        text += line;
+        z.vlat.push_back(vlat);
+        z.vlon.push_back(vlon);
+      }
+      z.minLat = *std::min_element(z.vlat.begin(), z.vlat.end()) - margin;
+      z.maxLat = *std::max_element(z.vlat.begin(), z.vlat.end()) + margin;
+      z.minLon = *std::min_element(z.vlon.begin(), z.vlon.end()) - margin;
+      z.maxLon = *std::max_element(z.vlon.begin(), z.vlon.end()) + margin;
+      for (int k = 0; k < 6; k++) {
+        double x, y;
+        toFrame(z, z.vlat[k], z.vlon[k], x, y);
+        z.vx.push_back(x);
+        z.vy.push_back(y);
+      }
+    }
+    ref.push_back(z);
+  }
+  return text;
+}
+
+static std::set<uint16_t> insideNow;
+
+static void track(const GeofenceEvent &ev) {
+  if (ev.type == GEOFENCE_ENTER) insideNow.insert(ev.zone);
+  else if (ev.type == GEOFENCE_EXIT) insideNow.erase(ev.zone);
+}
+
+// Distance from the true border at lat/lon to where the engine puts it,
+// along the outward bearing
+static double borderError(Geofence &fence, uint16_t zone, double lat, double lon, double outward) {
+  static uint32_t t = 0;
+  auto inside = [&](double offset) {
+    double plat, plon;
+    destination(lat, lon, outward, offset, plat, plon);
+    fence.update(plat, plon, t++, track);
+    return insideNow.count(zone) != 0;
+  };
+  double lo = -8, hi = 8;  // meters: inside, outside
+  if (!inside(lo) || inside(hi)) return hi;
+  for (int i = 0; i < 24; i++) {
+    double mid = (lo + hi) / 2;
+    (inside(mid) ? lo : hi) = mid;
+  }
+  return fabs(lo);
+}
+
+static void checkBorders(const char *where, double lat0, double lon0) {
+  std::mt19937 rng(2);
+  std::vector<RefZone> ref;
+  hostFiles()["/zones.txt"] = makeZones(rng, 200, lat0, lon0, 1.0, lat0 - 1, lon0 - 1, ref);
+  Geofence fence;
+  CHECK(fence.load(LittleFS, "/zones.txt"));
+  insideNow.clear();
+
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::vector<double> errors;
+  for (uint16_t i = 0; i < ref.size(); i++) {
+    const RefZone &z = ref[i];
+    for (int k = 0; k < 20; k++) {
+      double lat, lon, outward;
+      if (z.circle) {
+        outward = unit(rng) * 360;
+        destination(z.lat, z.lon, outward, z.radius, lat, lon);
+      } else {
+        size_t a = rng() % 6, b = (a + 1) % 6;
+        double along = bearing(z.vlat[a], z.vlon[a], z.vlat[b], z.vlon[b]);
+        double d = haversine(z.vlat[a], z.vlon[a], z.vlat[b], z.vlon[b]) * (0.15 + 0.7 * unit(rng));
+        destination(z.vlat[a], z.vlon[a], along, d, lat, lon);
+        outward = along + 90;
+      }
+      errors.push_back(borderError(fence, i, lat, lon, outward));
+    }
+  }
+  std::sort(errors.begin(), errors.end());
+  double maxError = errors.back();
+  printf("borders near %s: %zu points, error p50 %.2f m, p99 %.2f m, max %.2f m\n", where, errors.size(),
+         errors[errors.size() / 2], errors[errors.size() * 99 / 100], maxError);
+  CHECK(maxError < 1.0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t zones = 1000, fixes = 1000000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--zones")) zones = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--fixes")) fixes = atoi(argv[i + 1]);
+  }
+  if (!zones) zones = 1;
+  if (!fixes) fixes = 1;
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> around(-0.2, 0.2);
+  std::vector<RefZone> ref;
+  double firstLat = round6(-15.4 + around(rng)), firstLon = round6(28.3 + around(rng));
+  std::string text = makeZones(rng, zones, -15.4, 28.3, 0.2, firstLat, firstLon, ref);
+  hostFiles()["/zones.txt"] = text;
+
+  Geofence fence;
+  double start = hostSeconds();
+  CHECK(fence.load(LittleFS, "/zones.txt"));
+  double loadMs = (hostSeconds() - start) * 1000;
+  CHECK_EQ(fence.zones(), zones);
+
+  std::vector<std::pair<double, double> > points(fixes);
+  for (auto &p : points) p = std::make_pair(-15.4 + around(rng), 28.3 + around(rng));
+
+  long insideIndexed = 0;
+  std::vector<uint8_t> counts(fixes);
+  start = hostSeconds();
+  for (uint32_t i = 0; i < fixes; i++) {
+    counts[i] = fence.update(points[i].first, points[i].second, i * 100, nullptr);
+    insideIndexed += counts[i];
+  }
+  double tIndexed = hostSeconds() - start;
+
+  uint32_t compared = 0, mismatches = 0;
+  long insideScan = 0;
+  start = hostSeconds();
+  for (uint32_t i = 0; i < fixes; i++) {
+    int n = 0;
+    bool borderline = false;
+    for (const RefZone &z : ref) {
+      int in = refInside(z, points[i].first, points[i].second);
+      borderline |= in < 0;
+      n += in > 0;
+    }
+    insideScan += n;
+    if (borderline) continue;
+    compared++;
+    if (n != counts[i]) mismatches++;
+  }
+  double tScan = hostSeconds() - start;
+
+  printf("%u zones, %zu bytes of zone file, loaded in %.2f ms\n", zones, text.size(), loadMs);
+  printf("indexed:     %9.0f fixes/s, %.2f exact tests/fix\n", fixes / tIndexed,
+         (double)fence.exactTests() / fixes);
+  printf("linear scan: %9.0f fixes/s\n", fixes / tScan);
+  printf("%ld / %ld zone hits, %u of %u fixes compared, %u mismatches\n", insideIndexed, insideScan, compared,
+         fixes, mismatches);
+  CHECK(compared > fixes * 9 / 10);
+  CHECK_EQ(mismatches, 0);
+
+  checkBorders("Lusaka", -15.4, 28.3);
+  checkBorders("60 N", 60.2, 24.9);
+  return hostTestDone("geofence_bench");
+}
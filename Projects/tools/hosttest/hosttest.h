@@ -0,0 +1,43 @@
+#pragma once
+
+// Shared bits for the host tests: CHECK() records a failure and carries on,
+// so one run reports every broken expectation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+
+static int hostFailures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      hostFailures++;                                                 \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    }                                                                 \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                \
+  do {                                                                \
+    long long va = (long long)(a), vb = (long long)(b);               \
+    if (va != vb) {                                                   \
+      hostFailures++;                                                 \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, va, vb); \
+    }                                                                 \
+  } while (0)
+
+// Report and exit. _exit skips static destructors, which matters when a
+// worker task (a detached thread) may still be using them.
+static inline int hostTestDone(const char *name) {
+  if (hostFailures) fprintf(stderr, "%s: %d check(s) failed\n", name, hostFailures);
+  else printf("%s: ok\n", name);
+  fflush(stdout);
+  fflush(stderr);
+  _exit(hostFailures ? 1 : 0);
+}
+
+static inline double hostSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
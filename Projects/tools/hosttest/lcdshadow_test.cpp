@@ -0,0 +1,202 @@
+// LcdShadow against a mock HD44780 that counts every bus operation: what
+// single edits cost, that unchanged redraws cost nothing, that a budgeted
+// render converges, and that random drawing always ends up on the glass.
+// Finally the Security keypad UI's screens are replayed twice, once drawn
+// straight to the LCD as the firmware used to do, once through the shadow.
+
+#include <LcdShadow.h>
+
+#include <random>
+#include <string>
+
+#include "hosttest.h"
+
+static bool shows(const LiquidCrystal &lcd, const char *top, const char *bottom) {
+  std::string t(top), b(bottom);
+  t.resize(16, ' ');
+  b.resize(16, ' ');
+  return lcd.shown(0) == t && lcd.shown(1) == b;
+}
+
+static void testSingleEdits() {
+  LiquidCrystal lcd(2, 3, 13, 12, 11, 10);
+  LcdShadow screen(lcd);
+  lcd.begin(16, 2);
+  screen.begin();
+  CHECK_EQ(lcd.clears, 2);
+
+  screen.print("Temp: 23.4C");
+  screen.setCursor(0, 1);
+  screen.print("Hum: 51.0%");
+  uint32_t before = lcd.operations();
+  CHECK(screen.render());
+  CHECK(shows(lcd, "Temp: 23.4C", "Hum: 51.0%"));
+  // Every non-blank character once, plus a move past each blank and one
+  // onto row 1; row 0 starts where begin() left the counter
+  CHECK_EQ(lcd.operations() - before, (10 + 1) + (9 + 2));
+
+  // The same screen drawn again, clear() included: nothing on the bus
+  before = lcd.operations();
+  screen.clear();
+  screen.print("Temp: 23.4C");
+  screen.setCursor(0, 1);
+  screen.print("Hum: 51.0%");
+  CHECK(!screen.dirty());
+  CHECK(screen.render());
+  CHECK_EQ(lcd.operations() - before, 0);
+
+  // One digit: a cursor move and a character
+  before = lcd.operations();
+  screen.setCursor(9, 0);
+  screen.print('5');
+  CHECK(screen.render());
+  CHECK_EQ(lcd.operations() - before, 2);
+  CHECK(shows(lcd, "Temp: 23.5C", "Hum: 51.0%"));
+
+  // Adjacent changes ride the auto-increment: one move for two cells
+  before = lcd.operations();
+  screen.setCursor(5, 1);
+  screen.print("62.0");
+  CHECK(screen.render());
+  CHECK_EQ(lcd.operations() - before, 1 + 2);
+  CHECK(shows(lcd, "Temp: 23.5C", "Hum: 62.0%"));
+
+  // Text past column 16 is dropped, not wrapped onto the hidden DDRAM
+  screen.setCursor(12, 0);
+  screen.print("xxxxxxxx");
+  CHECK(screen.render());
+  CHECK(shows(lcd, "Temp: 23.5C xxxx", "Hum: 62.0%"));
+  CHECK_EQ(lcd.clears, 2);
+}
+
+static void testBudget() {
+  LiquidCrystal lcd(2, 3, 13, 12, 11, 10);
+  LcdShadow screen(lcd);
+  screen.begin();
+  screen.print("Enter Password:");
+  screen.setCursor(0, 1);
+  screen.print("PWD: ****");
+
+  int passes = 0;
+  uint32_t last = lcd.operations();
+  bool done = false;
+  while (!done && passes < 100) {
+    done = screen.render(3);
+    CHECK(lcd.operations() - last <= 3);
+    last = lcd.operations();
+    passes++;
+  }
+  CHECK(done);
+  CHECK(shows(lcd, "Enter Password:", "PWD: ****"));
+  // 24 characters and a move to row 1, three a pass, with a move to resume
+  // after most cut-offs
+  CHECK(passes >= 9 && passes <= 17);
+}
+
+static void testRandomDrawing() {
+  std::mt19937 rng(5);
+  LiquidCrystal lcd(2, 3, 13, 12, 11, 10);
+  LcdShadow screen(lcd);
+  screen.begin();
+  std::string expect[2] = { std::string(16, ' '), std::string(16, ' ') };
+  int mismatches = 0;
+  for (int round = 0; round < 5000; round++) {
+    if (rng() % 10 == 0) {
+      screen.clear();
+      expect[0] = expect[1] = std::string(16, ' ');
+    }
+    for (int edits = rng() % 4; edits >= 0; edits--) {
+      uint8_t c = rng() % 18, r = rng() % 2;
+      screen.setCursor(c, r);
+      for (int n = rng() % 6; n > 0; n--, c++) {
+        char ch = 'A' + rng() % 4;
+        screen.print(ch);
+        if (c < 16) expect[r][c] = ch;
+      }
+    }
+    while (!screen.render(1 + rng() % 8)) {
+    }
+    mismatches += lcd.shown(0) != expect[0] || lcd.shown(1) != expect[1];
+  }
+  CHECK_EQ(mismatches, 0);
+  CHECK_EQ(lcd.clears, 1);
+}
+
+// The keypad UI's screens over one visit: sensor updates while idle, a
+// PIN, the server check and the result, then idle again
+template <typename Screen, typename Pass>
+static void visit(Screen &s, Pass pass) {
+  for (int i = 0; i < 30; i++) {
+    char line[17];
+    s.clear();
+    snprintf(line, sizeof(line), "Temp: %d.%dC", 23 + i / 20, (4 + i / 3) % 10);
+    s.print(line);
+    s.setCursor(0, 1);
+    snprintf(line, sizeof(line), "Hum: %d.%d%%", 51 - i / 10, (i * 7) % 10);
+    s.print(line);
+    pass();
+  }
+  s.clear();
+  s.print("Enter Password:");
+  s.setCursor(0, 1);
+  s.print("PWD: ");
+  pass();
+  for (int k = 1; k <= 4; k++) {
+    s.setCursor(0, 1);
+    s.print("PWD: ");
+    for (int i = 0; i < k; i++) s.print('*');
+    pass();
+  }
+  s.clear();
+  s.print("Checking...");
+  pass();
+  s.clear();
+  s.print("Access Granted");
+  pass();
+  s.clear();
+  s.print("Temp: 24.4C");
+  s.setCursor(0, 1);
+  s.print("Hum: 48.9%");
+  pass();
+}
+
+static void testKeypadVisit() {
+  LiquidCrystal direct(2, 3, 13, 12, 11, 10);
+  direct.begin(16, 2);
+  uint32_t directStart = direct.operations();
+  uint64_t directUsStart = direct.busUs;
+  visit(direct, []() {});
+
+  LiquidCrystal lcd(2, 3, 13, 12, 11, 10);
+  lcd.begin(16, 2);
+  LcdShadow screen(lcd);
+  screen.begin();
+  uint32_t start = lcd.operations();
+  uint64_t usStart = lcd.busUs;
+  uint32_t loopPasses = 0;
+  visit(screen, [&]() {
+    // loop() renders with Security's budget of 8 every pass
+    while (!screen.render(8)) loopPasses++;
+    loopPasses++;
+  });
+
+  uint32_t directOps = direct.operations() - directStart, shadowOps = lcd.operations() - start;
+  printf("keypad visit: direct %u bus ops (%u clears, %.1f ms), shadow %u bus ops (0 clears, %.1f ms) "
+         "over %u loop passes\n",
+         directOps, direct.clears - 1, (direct.busUs - directUsStart) / 1000.0, shadowOps,
+         (lcd.busUs - usStart) / 1000.0, loopPasses);
+  CHECK(shows(lcd, "Temp: 24.4C", "Hum: 48.9%"));
+  CHECK(lcd.shown(0) == direct.shown(0) && lcd.shown(1) == direct.shown(1));
+  CHECK_EQ(lcd.clears, 2);
+  CHECK(shadowOps * 3 < directOps);
+  CHECK((lcd.busUs - usStart) * 5 < direct.busUs - directUsStart);
+  CHECK_EQ(screen.busWrites(), shadowOps + 1);  // + begin()'s clear
+}
+
+int main() {
+  testSingleEdits();
+  testBudget();
+  testRandomDrawing();
+  testKeypadVisit();
+  return hostTestDone("lcdshadow_test");
+}
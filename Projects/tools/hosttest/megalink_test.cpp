@@ -0,0 +1,274 @@
+// MegaLink over a simulated serial line: baud negotiation, throughput,
+// recovery from corrupted and lost bytes, sequence wrap with unreliable
+// traffic in between, and a Mega reset. Time is simulated and every byte
+// takes its ten bit times on the line, so messages/sec are what the real
+// link would do; the wall-clock rate is the parser's own cost.
+
+#include <MegaLink.h>
+
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "hosttest.h"
+
+static std::mt19937 rng(7);
+
+static bool chance(double p) { return p > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+
+// One direction of the line. Each byte takes ten bit times at the sender's
+// baud and becomes readable once it has fully arrived. A byte sent at the
+// wrong baud arrives garbled; any byte can also be flipped or lost.
+struct Wire {
+  std::deque<std::pair<uint8_t, uint64_t> > bytes;  // byte, arrival time in us
+  uint64_t busyUntilUs = 0;
+  double corrupt = 0;
+  double drop = 0;
+};
+
+static uint64_t nowUs = 0;
+
+class Port : public Stream {
+public:
+  Port(Wire &out, Wire &in, uint32_t &baud, uint32_t &peerBaud)
+      : out(out), in(in), baud(baud), peerBaud(peerBaud) {}
+
+  size_t write(uint8_t c) override {
+    uint64_t done = std::max(nowUs, out.busyUntilUs) + 10000000ULL / baud;
+    out.busyUntilUs = done;
+    if (chance(out.drop)) return 1;
+    if (baud != peerBaud) c ^= 0x5A;
+    if (chance(out.corrupt)) c ^= 1 << (rng() % 8);
+    out.bytes.push_back(std::make_pair(c, done));
+    return 1;
+  }
+
+  int available() override { return !in.bytes.empty() && in.bytes.front().second <= nowUs; }
+
+  int read() override {
+    if (!available()) return -1;
+    int c = in.bytes.front().first;
+    in.bytes.pop_front();
+    return c;
+  }
+
+  using Print::write;
+
+private:
+  Wire &out;
+  Wire &in;
+  uint32_t &baud;
+  uint32_t &peerBaud;
+};
+
+static Wire toMega, toEsp;
+static uint32_t espBaud = MegaLink::BASE_BAUD, megaBaud = MegaLink::BASE_BAUD;
+static Port espPort(toMega, toEsp, espBaud, megaBaud);
+static Port megaPort(toEsp, toMega, megaBaud, espBaud);
+
+static std::vector<uint32_t> keypadAtEsp, authAtMega;
+static uint32_t sensorAtMega = 0;
+
+static uint32_t counterOf(const uint8_t *p, uint8_t len) {
+  return len == 4 ? p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24 : 0xFFFFFFFF;
+}
+
+static void onEsp(uint8_t type, const uint8_t *p, uint8_t len) {
+  if (type == MEGA_MSG_KEYPAD) keypadAtEsp.push_back(counterOf(p, len));
+}
+
+static void onMega(uint8_t type, const uint8_t *p, uint8_t len) {
+  if (type == MEGA_MSG_AUTH_RESULT) authAtMega.push_back(counterOf(p, len));
+  if (type == MEGA_MSG_SENSOR) sensorAtMega++;
+}
+
+static MegaLink *megaSide;
+static uint32_t megaReliableSent = 0;  // so the test knows the Mega's last seq
+
+static bool send(MegaLink &link, uint8_t type, uint32_t counter, bool reliable) {
+  uint8_t p[4] = { (uint8_t)counter, (uint8_t)(counter >> 8), (uint8_t)(counter >> 16), (uint8_t)(counter >> 24) };
+  bool ok = link.send(type, p, sizeof(p), reliable);
+  if (ok && reliable && &link == megaSide) megaReliableSent++;
+  return ok;
+}
+
+// Advance simulated time in 100 us ticks, polling both ends every tick
+static void tick() {
+  nowUs += 100;
+  hostSetMicros(nowUs);
+}
+
+static void step(MegaLink &esp, MegaLink &mega, uint32_t ms = 1) {
+  for (uint32_t i = 0; i < ms * 10; i++) {
+    tick();
+    esp.poll();
+    mega.poll();
+  }
+}
+
+// Strictly increasing: nothing delivered twice or out of order
+static bool ordered(const std::vector<uint32_t> &v) {
+  for (size_t i = 1; i < v.size(); i++) {
+    if (v[i] <= v[i - 1]) return false;
+  }
+  return true;
+}
+
+static void testFraming() {
+  for (int n = 0; n <= MegaLink::MAX_PAYLOAD + 4; n++) {
+    uint8_t in[40], enc[42], dec[42];
+    for (int i = 0; i < n; i++) in[i] = rng() % 3 ? rng() : 0;
+    uint8_t e = MegaLink::cobsEncode(in, n, enc);
+    bool noZero = true;
+    for (int i = 0; i < e; i++) noZero &= enc[i] != 0;
+    CHECK(noZero);
+    CHECK_EQ(MegaLink::cobsDecode(enc, e, dec), n);
+    CHECK(!memcmp(in, dec, n));
+  }
+  CHECK_EQ(MegaLink::crc16((const uint8_t *)"123456789", 9), 0x29B1);
+}
+
+static void testNegotiation(MegaLink &esp, MegaLink &mega) {
+  step(esp, mega, 200);
+  CHECK_EQ(espBaud, 115200);
+  CHECK_EQ(megaBaud, 115200);
+  CHECK(esp.linkUp() && mega.linkUp());
+}
+
+static void testThroughput(MegaLink &esp, MegaLink &mega) {
+  keypadAtEsp.clear();
+  const uint32_t N = 2000;
+  uint32_t next = 0;
+  uint64_t startUs = nowUs;
+  double start = hostSeconds();
+  while (keypadAtEsp.size() < N && nowUs - startUs < 60000000) {
+    while (next < N && send(mega, MEGA_MSG_KEYPAD, next, true)) next++;
+    tick();
+    esp.poll();
+    mega.poll();
+  }
+  double wall = hostSeconds() - start;
+  CHECK_EQ(keypadAtEsp.size(), N);
+  CHECK(ordered(keypadAtEsp));
+  printf("reliable, clean line at %u baud: %.0f msgs/s (one frame in flight); host %.0f msgs/s wall clock\n",
+         (unsigned)espBaud, N * 1e6 / (nowUs - startUs), N / wall);
+
+  uint32_t sensorBefore = sensorAtMega;
+  for (uint32_t i = 0; i < 1000; i++) {
+    send(esp, MEGA_MSG_SENSOR, i, false);
+    step(esp, mega);
+  }
+  step(esp, mega, 100);
+  CHECK_EQ(sensorAtMega - sensorBefore, 1000);
+}
+
+// Reliable frames between bursts of 255 unreliable ones. With one shared
+// seq counter every reliable frame got the previous one's seq and was
+// dropped as a duplicate.
+static void testSeqWrap(MegaLink &esp, MegaLink &mega) {
+  authAtMega.clear();
+  for (uint32_t round = 0; round < 20; round++) {
+    CHECK(send(esp, MEGA_MSG_AUTH_RESULT, round, true));
+    step(esp, mega, 5);
+    for (int i = 0; i < 255; i++) {
+      send(esp, MEGA_MSG_SENSOR, i, false);
+      if (i % 8 == 0) step(esp, mega);
+    }
+    step(esp, mega, 300);
+  }
+  CHECK_EQ(authAtMega.size(), 20);
+  CHECK(ordered(authAtMega));
+}
+
+static void testLossyLine(MegaLink &esp, MegaLink &mega) {
+  keypadAtEsp.clear();
+  authAtMega.clear();
+  toMega.corrupt = toEsp.corrupt = 0.01;
+  toMega.drop = toEsp.drop = 0.005;
+  MegaLinkStats espBefore = esp.stats(), megaBefore = mega.stats();
+
+  uint32_t keypadSent = 0, authSent = 0;
+  for (uint32_t ms = 0; ms < 20000; ms++) {
+    if (send(mega, MEGA_MSG_KEYPAD, keypadSent, true)) keypadSent++;
+    if (ms % 7 == 0 && send(esp, MEGA_MSG_AUTH_RESULT, authSent, true)) authSent++;
+    if (ms % 10 == 0) send(esp, MEGA_MSG_SENSOR, ms, false);
+    step(esp, mega);
+  }
+  toMega.corrupt = toEsp.corrupt = 0;
+  toMega.drop = toEsp.drop = 0;
+  step(esp, mega, 10000);  // drain, and let a baud fallback renegotiate
+
+  const MegaLinkStats &e = esp.stats(), &m = mega.stats();
+  uint32_t keypadFailed = m.txFailures - megaBefore.txFailures;
+  uint32_t authFailed = e.txFailures - espBefore.txFailures;
+  printf("lossy line, 20 s: keypad %zu/%u delivered (%u given up), auth %zu/%u (%u given up)\n",
+         keypadAtEsp.size(), keypadSent, keypadFailed, authAtMega.size(), authSent, authFailed);
+  printf("  crc errors %u/%u, framing %u/%u, duplicates dropped %u/%u, retries %u/%u, fallbacks %u\n",
+         e.rxCrcErrors - espBefore.rxCrcErrors, m.rxCrcErrors - megaBefore.rxCrcErrors,
+         e.rxFramingErrors - espBefore.rxFramingErrors, m.rxFramingErrors - megaBefore.rxFramingErrors,
+         e.rxDuplicates - espBefore.rxDuplicates, m.rxDuplicates - megaBefore.rxDuplicates,
+         e.txRetries - espBefore.txRetries, m.txRetries - megaBefore.txRetries,
+         e.baudFallbacks - espBefore.baudFallbacks);
+
+  CHECK(ordered(keypadAtEsp));
+  CHECK(ordered(authAtMega));
+  // A frame is given up on only after its retries; a given-up frame may
+  // still have arrived with all its ACKs lost
+  CHECK(keypadAtEsp.size() <= keypadSent && keypadAtEsp.size() + keypadFailed >= keypadSent);
+  CHECK(authAtMega.size() <= authSent && authAtMega.size() + authFailed >= authSent);
+  CHECK(e.rxCrcErrors > espBefore.rxCrcErrors);
+  CHECK(keypadAtEsp.size() > keypadSent * 9 / 10);
+  CHECK_EQ(espBaud, 115200);
+  CHECK_EQ(megaBaud, 115200);
+  CHECK(esp.linkUp() && mega.linkUp());
+}
+
+// The Mega reboots at the base rate, and its new random start seq happens
+// to equal the last seq the ESP32 delivered. That frame must not be taken
+// for a retransmit.
+static void testMegaReset(MegaLink &esp, MegaLink &mega) {
+  keypadAtEsp.clear();
+  CHECK(send(mega, MEGA_MSG_KEYPAD, 1, true));
+  step(esp, mega, 50);
+  CHECK_EQ(keypadAtEsp.size(), 1);
+  uint8_t lastSeq = (uint8_t)(megaReliableSent - 1);
+
+  // Reboot: the ESP32 keeps polling, the Mega's UART comes back at 9600
+  megaBaud = MegaLink::BASE_BAUD;
+  for (int i = 0; i < 15000; i++) {
+    tick();
+    esp.poll();
+  }
+  toMega.bytes.clear();
+  nowUs = (nowUs | 0xFF) + 1 + lastSeq;
+  hostSetMicros(nowUs);
+  MegaLink rebooted(megaPort, [](uint32_t b) { megaBaud = b; });
+  rebooted.begin(onMega);
+
+  step(esp, rebooted, 12000);  // keepalive fails, ESP32 falls back and renegotiates
+  CHECK_EQ(espBaud, 115200);
+  CHECK_EQ(megaBaud, 115200);
+  CHECK(send(rebooted, MEGA_MSG_KEYPAD, 2, true));
+  step(esp, rebooted, 50);
+  CHECK_EQ(keypadAtEsp.size(), 2);
+}
+
+int main() {
+  hostSerialQuiet = true;
+  testFraming();
+
+  MegaLink esp(espPort, [](uint32_t b) { espBaud = b; });
+  nowUs = 256 * 4000;  // the Mega's reliable seqs start at 0
+  hostSetMicros(nowUs);
+  MegaLink mega(megaPort, [](uint32_t b) { megaBaud = b; });
+  megaSide = &mega;
+  mega.begin(onMega);
+  esp.begin(onEsp, 115200);
+
+  testNegotiation(esp, mega);
+  testThroughput(esp, mega);
+  testSeqWrap(esp, mega);
+  testLossyLine(esp, mega);
+  testMegaReset(esp, mega);
+  return hostTestDone("megalink_test");
+}
@@ -0,0 +1,160 @@
+// MqttLink against a scripted broker (stubs/PubSubClient.h): sensor and GPS
+// batches go out as req/reply exchanges, so a 2xx means the server has them
+// and SensorBuffer keeps its samples until then; replies that get lost are
+// covered by republishing under the same id; command replies stay QoS 0.
+
+#include <LittleFS.h>
+#include <MqttLink.h>
+#include <SensorBuffer.h>
+
+#include <string>
+#include <vector>
+
+#include "hosttest.h"
+
+static const char PREFIX[] = "home/dev1/";
+
+// The server side: answers req/<name>/<id> on reply/<id>/<status>, after
+// ignoring the first `ignore` publishes of each request
+struct Broker {
+  int status = 201;
+  int ignore = 0;
+  bool silent = false;
+  std::vector<std::string> requests;  // "<name>/<id>" as published
+  std::vector<std::string> telemetry; // up/<name>
+  std::string lastTopic;
+  int repeats = 0;
+
+  void attach(PubSubClient &mqtt) {
+    mqtt.hostBroker = [this, &mqtt](const PubSubClient::Message &m) {
+      if (m.topic.compare(0, strlen(PREFIX), PREFIX) != 0) return;
+      std::string rest = m.topic.substr(strlen(PREFIX));
+      if (rest.compare(0, 3, "up/") == 0) {
+        telemetry.push_back(rest.substr(3));
+        return;
+      }
+      if (rest.compare(0, 4, "req/") != 0) return;
+      repeats = m.topic == lastTopic ? repeats + 1 : 0;
+      lastTopic = m.topic;
+      if (!repeats) requests.push_back(rest.substr(4));
+      if (silent || repeats < ignore) return;
+      std::string id = rest.substr(rest.rfind('/') + 1);
+      mqtt.hostDeliver(PREFIX + std::string("reply/") + id + "/" + std::to_string(status), "{\"saved\":1}");
+    };
+  }
+};
+
+static void testBatchesAreAcknowledged() {
+  MqttLink link("broker", 1883, "dev1");
+  Broker broker;
+  broker.attach(*PubSubClient::hostClient());
+
+  char response[64];
+  CHECK_EQ(link.post("/api/sensor-data/", "[{\"temperature\":22.0}]", response, sizeof(response)), 201);
+  CHECK(strcmp(response, "{\"saved\":1}") == 0);
+  CHECK_EQ(link.post("/api/gps-data/", "[{\"latitude\":-15.4}]", response, sizeof(response)), 201);
+  CHECK_EQ(broker.requests.size(), 2);
+  if (broker.requests.size() == 2) {
+    CHECK(broker.requests[0].compare(0, 12, "sensor-data/") == 0);
+    CHECK(broker.requests[1].compare(0, 9, "gps-data/") == 0);
+  }
+  CHECK(broker.telemetry.empty());
+  CHECK_EQ(link.stats().requests, 2);
+  CHECK_EQ(link.stats().published, 0);
+
+  // Server errors come back as they are
+  broker.status = 500;
+  CHECK_EQ(link.post("/api/sensor-data/", "[]", response, sizeof(response)), 500);
+}
+
+// The first two publishes (or their replies) vanish; the third gets through
+// under the same id, so the server can tell it's one batch
+static void testLostReply() {
+  MqttLink link("broker", 1883, "dev1");
+  Broker broker;
+  broker.ignore = 2;
+  broker.attach(*PubSubClient::hostClient());
+
+  uint32_t start = millis();
+  CHECK_EQ(link.post("/api/gps-data/", "[]", nullptr, 0, 5000), 201);
+  CHECK_EQ(broker.requests.size(), 1);
+  CHECK_EQ(link.stats().retries, 2);
+  CHECK(millis() - start >= 2 * MqttLink::RETRY_MS);
+}
+
+// No reply at all: the upload fails and the buffer still has every sample.
+// With the old QoS 0 publish this was a 202 and the batch was committed.
+static void testUnansweredBatchIsKept() {
+  hostFiles().clear();
+  MqttLink link("broker", 1883, "dev1");
+  Broker broker;
+  broker.silent = true;
+  broker.attach(*PubSubClient::hostClient());
+
+  SensorBuffer buffer;
+  buffer.begin();
+  for (int i = 0; i < 5; i++) {
+    SensorSample s = {};
+    s.temperature = 22.0f + i;
+    s.humidity = 50.0f;
+    buffer.push(s);
+  }
+  static char body[1024];
+  CHECK_EQ(buffer.buildBatch(body, sizeof(body), 900), 5);
+  int code = link.post("/api/sensor-data/", body, nullptr, 0, 8000);
+  CHECK_EQ(code, MQTT_ERR_TIMEOUT);
+  if (code >= 200 && code < 300) buffer.commit();
+  CHECK_EQ(buffer.pending(), 5);
+  CHECK_EQ(link.stats().failures, 1);
+  CHECK_EQ(link.stats().retries, 7);
+
+  // The reply turns up after post() gave up
+  PubSubClient &mqtt = *PubSubClient::hostClient();
+  std::string id = broker.lastTopic.substr(broker.lastTopic.rfind('/') + 1);
+  mqtt.hostDeliver(PREFIX + std::string("reply/") + id + "/201", "");
+  link.poll();
+  CHECK_EQ(link.stats().lateReplies, 1);
+
+  // Next time the server answers and the same samples go out again
+  broker.silent = false;
+  CHECK_EQ(buffer.buildBatch(body, sizeof(body), 900), 5);
+  code = link.post("/api/sensor-data/", body, nullptr, 0, 8000);
+  CHECK_EQ(code, 201);
+  if (code >= 200 && code < 300) buffer.commit();
+  CHECK_EQ(buffer.pending(), 0);
+}
+
+// Answers to server commands are the one fire-and-forget message
+static void testCommandReply() {
+  MqttLink link("broker", 1883, "dev1");
+  Broker broker;
+  broker.silent = true;
+  broker.attach(*PubSubClient::hostClient());
+
+  uint32_t start = millis();
+  CHECK_EQ(link.post("/api/cmd-reply/7/", "Door: LOCKED"), 202);
+  CHECK_EQ(millis(), start);
+  CHECK_EQ(broker.telemetry.size(), 1);
+  if (!broker.telemetry.empty()) CHECK(broker.telemetry[0] == "cmd-reply/7");
+  CHECK(broker.requests.empty());
+  CHECK_EQ(link.stats().published, 1);
+}
+
+static void testOffline() {
+  MqttLink link("broker", 1883, "dev1");
+  PubSubClient::hostClient()->hostAccept = false;
+  CHECK_EQ(link.post("/api/sensor-data/", "[]"), MQTT_ERR_OFFLINE);
+  CHECK_EQ(link.stats().connectFailures, 1);
+  CHECK_EQ(link.stats().failures, 1);
+}
+
+int main() {
+  hostSerialQuiet = true;
+  hostSetMillis(1000);
+  testBatchesAreAcknowledged();
+  testLostReply();
+  testUnansweredBatchIsKept();
+  testCommandReply();
+  testOffline();
+  return hostTestDone("mqttlink_test");
+}
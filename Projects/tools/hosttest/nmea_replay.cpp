@@ -0,0 +1,190 @@
+// Replays NMEA logs through the tracker's GPS path: each line goes into a
+// host UART, GpsReader's task parses it, and every new fix goes through
+// TrackReporter as loop() does it. The clock follows the log's UTC time so
+// batching and heartbeats happen as they would on the road.
+//
+// For each log it reports the points uploaded against the old policy (one
+// POST per fix every 5 s), the JSON bytes sent, and how far every fix is
+// from the uploaded track. That distance is measured from the segment
+// between the uploaded points just before and just after the fix in time.
+//
+// corpus/nmea/lusaka_drive.nmea is a generated 20-minute drive: parked,
+// city streets, a traffic light, a curve, a stretch without fix, and a
+// fast road. It includes receiver noise, GSV chatter and a few corrupted
+// sentences. Drop real recordings next to it.
+//
+// Usage: nmea_replay [log ...]   (default: every .nmea in corpus/nmea)
+
+#include <TrackReporter.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hosttest.h"
+
+struct Point {
+  uint32_t sec;  // seconds into the UTC day
+  double lat, lon;
+};
+
+static const uint32_t OLD_INTERVAL_S = 5;
+static const char DEVICE_ID[] = "esp32_001";
+
+static double distanceM(double lat0, double lon0, double lat, double lon, double &dx, double &dy) {
+  dy = (lat - lat0) * 110574.0;
+  dx = (lon - lon0) * 111320.0 * cos(lat0 * M_PI / 180);
+  return hypot(dx, dy);
+}
+
+static double segmentError(const Point &a, const Point &b, const Point &p) {
+  double bx, by, px, py;
+  distanceM(a.lat, a.lon, b.lat, b.lon, bx, by);
+  distanceM(a.lat, a.lon, p.lat, p.lon, px, py);
+  double len2 = bx * bx + by * by;
+  double t = len2 > 0 ? std::max(0.0, std::min(1.0, (px * bx + py * by) / len2)) : 0;
+  return hypot(px - t * bx, py - t * by);
+}
+
+// hhmmss of a GGA/RMC line, or -1
+static long sentenceSecond(const std::string &line) {
+  if (line.size() < 14 || line[0] != '$' || line[6] != ',' || !isdigit((uint8_t)line[7])) return -1;
+  long hhmmss = atol(line.c_str() + 7);
+  return hhmmss / 10000 * 3600 + hhmmss / 100 % 100 * 60 + hhmmss % 100;
+}
+
+// Points of one uploaded JSON batch
+static void parseBatch(const char *json, std::vector<Point> &out) {
+  const char *p = json;
+  while ((p = strstr(p, "\"timestamp\":\"")) != nullptr) {
+    unsigned y, mo, d, h, mi, s;
+    Point pt;
+    if (sscanf(p, "\"timestamp\":\"%u-%u-%u %u:%u:%u\",\"latitude\":%lf,\"longitude\":%lf", &y, &mo, &d, &h, &mi,
+               &s, &pt.lat, &pt.lon) == 8) {
+      pt.sec = h * 3600 + mi * 60 + s;
+      out.push_back(pt);
+    }
+    p++;
+  }
+}
+
+static bool replay(const std::string &path) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    perror(path.c_str());
+    return false;
+  }
+
+  HardwareSerial uart(2);
+  GpsReader reader(uart);
+  if (!reader.begin(9600, 16, 17)) return false;
+  TrackConfig config;
+  TrackReporter reporter(config);
+
+  std::vector<Point> fixes, uploaded;
+  static char json[4096];  // same buffer as uploadTrack()
+  uint32_t uploads = 0, oldUploads = 0;
+  size_t bytes = 0, oldBytes = 0;
+  uint32_t lastSeq = 0, lastOldSec = 0;
+  long firstSec = -1;
+  bool haveOld = false;
+  size_t fed = 0;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    long sec = sentenceSecond(line);
+    if (sec >= 0) {
+      if (firstSec < 0) firstSec = sec;
+      hostSetMillis((uint32_t)(sec - firstSec) * 1000);
+    }
+    line += "\r\n";
+    uart.hostReceive((const uint8_t *)line.data(), line.size());
+    fed += line.size();
+    while (reader.stats().chars < fed) std::this_thread::yield();
+
+    GpsFix fix;
+    if (!reader.latest(fix) || fix.seq == lastSeq) continue;
+    lastSeq = fix.seq;
+    reporter.add(fix);
+    Point p = { (uint32_t)(fix.hour * 3600 + fix.minute * 60 + fix.second), fix.lat, fix.lon };
+    if (fixes.empty() || fixes.back().sec != p.sec) fixes.push_back(p);
+
+    // The old firmware: one single-point POST every 5 s
+    if (!haveOld || p.sec - lastOldSec >= OLD_INTERVAL_S) {
+      char item[200];
+      oldBytes += formatTrackPoint(item, sizeof(item), fix, DEVICE_ID) + 2;
+      oldUploads++;
+      lastOldSec = p.sec;
+      haveOld = true;
+    }
+
+    if (reporter.due(millis()) && reporter.buildBatch(json, sizeof(json), DEVICE_ID)) {
+      parseBatch(json, uploaded);
+      bytes += strlen(json);
+      uploads++;
+      reporter.commit();
+    }
+  }
+  // Whatever is left goes out when the tracker next uploads
+  while (reporter.buildBatch(json, sizeof(json), DEVICE_ID)) {
+    parseBatch(json, uploaded);
+    bytes += strlen(json);
+    uploads++;
+    reporter.commit();
+  }
+
+  std::vector<double> errors;
+  size_t k = 0;
+  for (size_t i = 0; i < fixes.size() && !uploaded.empty(); i++) {
+    while (k + 1 < uploaded.size() && uploaded[k + 1].sec <= fixes[i].sec) k++;
+    const Point &a = uploaded[k], &b = uploaded[std::min(k + 1, uploaded.size() - 1)];
+    errors.push_back(segmentError(a, b, fixes[i]));
+  }
+  std::sort(errors.begin(), errors.end());
+  double maxErr = errors.empty() ? 0 : errors.back();
+  double p95 = errors.empty() ? 0 : errors[errors.size() * 95 / 100];
+
+  GpsStats s = reader.stats();
+  const char *name = strrchr(path.c_str(), '/');
+  printf("%s: %u sentences ok, %u bad checksum, %zu positions over %ld s\n", name ? name + 1 : path.c_str(),
+         s.passedChecksum, s.failedChecksum, fixes.size(),
+         fixes.empty() ? 0L : (long)(fixes.back().sec - fixes.front().sec));
+  printf("  old policy: %5u points, %5u posts, %7zu bytes\n", oldUploads, oldUploads, oldBytes);
+  printf("  reporter:   %5zu points, %5u posts, %7zu bytes  (%.1fx fewer points, %.1fx fewer posts)\n",
+         uploaded.size(), uploads, bytes, (double)oldUploads / uploaded.size(), (double)oldUploads / uploads);
+  printf("  error vs uploaded track: p95 %.1f m, max %.1f m (reporter's own estimate %.1f m)\n", p95, maxErr,
+         reporter.maxError());
+
+  CHECK(!uploaded.empty());
+  CHECK_EQ(reporter.dropped(), 0);
+  // Dead-band, then simplification of what got past it
+  CHECK(maxErr <= config.minDistanceM + config.toleranceM);
+  CHECK(uploaded.size() * 2 <= oldUploads);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  hostSerialQuiet = true;
+  std::vector<std::string> logs;
+  for (int i = 1; i < argc; i++) logs.push_back(argv[i]);
+  if (logs.empty()) {
+    const char *dir = "corpus/nmea";
+    DIR *d = opendir(dir);
+    if (!d) {
+      perror(dir);
+      return 1;
+    }
+    while (dirent *e = readdir(d)) {
+      std::string n = e->d_name;
+      if (n.size() > 5 && n.compare(n.size() - 5, 5, ".nmea") == 0) logs.push_back(std::string(dir) + "/" + n);
+    }
+    closedir(d);
+    std::sort(logs.begin(), logs.end());
+  }
+  for (const std::string &log : logs) CHECK(replay(log));
+  return hostTestDone("nmea_replay");
+}
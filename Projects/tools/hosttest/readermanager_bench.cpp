@@ -0,0 +1,129 @@
+// ReaderManager over 1, 2 and 4 modelled RC522s (stubs/MFRC522.h) for a
+// simulated minute, with loop() passes 100 us apart: scans per second and
+// the longest gap between scans for each reader, in IRQ mode and in
+// polling mode, where a scan no card answers blocks for the RC522's 25 ms
+// receive timeout. A card is tapped on a random reader every 2 s; each
+// tap must come back once, tagged with that reader. Scans are staggered,
+// so no loop pass may probe two readers.
+//
+// Usage: readermanager_bench [--seconds N]
+
+#include <ReaderManager.h>
+
+#include <random>
+
+#include "hosttest.h"
+
+static const uint32_t PASS_US = 100;
+static const uint32_t RX_TIMEOUT_MS = 25;
+static const uint32_t TAP_EVERY_MS = 2000, TAP_HOLD_MS = 300;
+
+struct Run {
+  float scansPerSecond[ReaderManager::MAX_READERS];
+  uint16_t maxGap[ReaderManager::MAX_READERS];
+  uint32_t taps = 0, events = 0, wrongReader = 0, late = 0, doubleScans = 0;
+  double busy = 0;  // share of the time spent blocked inside poll()
+};
+
+static Run simulate(uint8_t readers, bool irq, uint32_t seconds) {
+  hostSetMillis(1000);
+  MFRC522 rc522[ReaderManager::MAX_READERS];
+  CardReader *reader[ReaderManager::MAX_READERS];
+  ReaderManager manager;
+  static const char *NAMES[] = { "entry", "exit", "gate", "dock" };
+  for (uint8_t i = 0; i < readers; i++) {
+    rc522[i].hostIrqPin = irq ? 30 + i : -1;
+    rc522[i].hostRxTimeoutMs = RX_TIMEOUT_MS;
+    rc522[i].PCD_Init();
+    reader[i] = new CardReader(rc522[i], irq ? 30 + i : -1);
+    manager.add(*reader[i], NAMES[i]);
+  }
+  manager.begin();
+
+  Run r;
+  std::mt19937 rng(7);
+  uint32_t start = millis(), blockedUs = 0;
+  uint32_t nextTap = start + 500, tapReader = 0, tapAt = 0;
+  bool tapping = false;
+  while (millis() - start < seconds * 1000) {
+    uint32_t now = millis();
+    if (!tapping && now >= nextTap) {
+      tapReader = rng() % readers;
+      uint8_t uid[4] = { 0x04, (uint8_t)(r.taps >> 8), (uint8_t)r.taps, (uint8_t)tapReader };
+      rc522[tapReader].hostPlace(uid, sizeof(uid));
+      tapAt = now;
+      tapping = true;
+      r.taps++;
+    } else if (tapping && now - tapAt >= TAP_HOLD_MS) {
+      rc522[tapReader].hostRemove();
+      tapping = false;
+      nextTap = tapAt + TAP_EVERY_MS;
+    }
+
+    uint32_t probes[ReaderManager::MAX_READERS];
+    for (uint8_t i = 0; i < readers; i++) probes[i] = reader[i]->stats().probes;
+    uint32_t before = micros();
+    manager.poll();
+    blockedUs += micros() - before;
+    uint8_t scanned = 0;
+    for (uint8_t i = 0; i < readers; i++) scanned += reader[i]->stats().probes != probes[i];
+    r.doubleScans += scanned > 1;
+
+    ReaderEvent e;
+    while (manager.read(e)) {
+      r.events++;
+      r.wrongReader += e.reader != e.card.uid[3];
+      r.late += e.card.at - tapAt > CardReader::PROBE_MS + RX_TIMEOUT_MS;
+    }
+    hostSetMicros((uint64_t)micros() + PASS_US);
+  }
+
+  uint32_t elapsed = millis() - start;
+  for (uint8_t i = 0; i < readers; i++) {
+    r.scansPerSecond[i] = reader[i]->stats().probes * 1000.0f / elapsed;
+    r.maxGap[i] = manager.maxGap(i);
+    delete reader[i];
+  }
+  r.busy = blockedUs / (elapsed * 1000.0);
+  return r;
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 60;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--seconds")) seconds = atoi(argv[i + 1]);
+  }
+  if (!seconds) seconds = 1;
+  hostSerialQuiet = true;
+
+  printf("%u s simulated, loop pass every %u us, %u ms receive timeout when polling\n", seconds, PASS_US,
+         RX_TIMEOUT_MS);
+  for (bool irq : { true, false }) {
+    for (uint8_t readers : { 1, 2, 4 }) {
+      Run r = simulate(readers, irq, seconds);
+      float minRate = r.scansPerSecond[0];
+      uint16_t maxGap = 0;
+      for (uint8_t i = 0; i < readers; i++) {
+        minRate = min(minRate, r.scansPerSecond[i]);
+        maxGap = max(maxGap, r.maxGap[i]);
+      }
+      printf("%-7s %u reader%s: %5.2f scans/s each (lowest), max gap %3u ms, loop blocked %4.1f%%, "
+             "%u/%u taps\n",
+             irq ? "IRQ" : "polling", readers, readers > 1 ? "s" : " ", minRate, maxGap, r.busy * 100, r.events,
+             r.taps);
+
+      CHECK_EQ(r.events, r.taps);
+      CHECK_EQ(r.wrongReader, 0);
+      CHECK_EQ(r.late, 0);
+      CHECK_EQ(r.doubleScans, 0);
+      if (irq) {
+        // A reader never waits longer than PROBE_MS plus a loop pass
+        CHECK(minRate >= 9.9f);
+        CHECK(maxGap <= CardReader::PROBE_MS + 1);
+      } else {
+        CHECK(minRate >= 9.0f);
+      }
+    }
+  }
+  return hostTestDone("readermanager_bench");
+}
@@ -0,0 +1,79 @@
+#include "Arduino.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+HostSerial Serial;
+bool hostSerialQuiet = false;
+
+static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+static std::atomic<bool> manualClock(false);
+static std::atomic<uint64_t> manualMicros(0);
+static uint8_t pins[64];
+
+struct HostIsr {
+  void (*isr)(void *);
+  void *arg;
+  int mode;
+};
+static HostIsr isrs[sizeof(pins)];
+
+size_t HostSerial::write(uint8_t c) {
+  if (!hostSerialQuiet) fputc(c, stdout);
+  return 1;
+}
+
+size_t HostSerial::write(const uint8_t *buf, size_t len) {
+  if (!hostSerialQuiet) fwrite(buf, 1, len, stdout);
+  return len;
+}
+
+static uint64_t nowMicros() {
+  if (manualClock) return manualMicros;
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+      .count();
+}
+
+uint32_t millis() { return (uint32_t)(nowMicros() / 1000); }
+uint32_t micros() { return (uint32_t)nowMicros(); }
+
+void delay(uint32_t ms) {
+  if (manualClock) manualMicros += (uint64_t)ms * 1000;
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() { std::this_thread::yield(); }
+
+uint32_t esp_random() {
+  static std::mt19937 rng(1);
+  return rng();
+}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t value) { pins[pin % sizeof(pins)] = value; }
+int digitalRead(uint8_t pin) { return pins[pin % sizeof(pins)]; }
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode) {
+  isrs[pin % sizeof(pins)] = { isr, arg, mode };
+}
+
+void detachInterrupt(uint8_t pin) { isrs[pin % sizeof(pins)] = { nullptr, nullptr, 0 }; }
+
+void hostDrivePin(uint8_t pin, uint8_t level) {
+  uint8_t &now = pins[pin % sizeof(pins)];
+  const HostIsr &h = isrs[pin % sizeof(pins)];
+  bool edge = (level && !now && h.mode != FALLING) || (!level && now && h.mode != RISING);
+  now = level;
+  if (edge && h.isr) h.isr(h.arg);
+}
+
+void hostSetMillis(uint32_t ms) { hostSetMicros((uint64_t)ms * 1000); }
+
+void hostSetMicros(uint64_t us) {
+  manualMicros = us;
+  manualClock = true;
+}
+
+void hostAdvanceMillis(uint32_t ms) { manualMicros += (uint64_t)ms * 1000; }
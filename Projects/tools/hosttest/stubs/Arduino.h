@@ -0,0 +1,165 @@
+#pragma once
+
+// Just enough of the Arduino core to build the firmware libraries on a PC.
+// millis()/micros() follow the wall clock until a test takes the clock over
+// with hostSetMillis(); after that time only moves when the test says so.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "freertos/FreeRTOS.h"  // the ESP32 core pulls it in too
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+
+#define IRAM_ATTR
+
+#define DEC 10
+#define HEX 16
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || __GLIBC_MINOR__ >= 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+class String {
+public:
+  String(const char *s = "") : s(s ? s : "") {}
+  String(const std::string &s) : s(s) {}
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  String &operator+=(const char *t) { s += t; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  bool operator==(const char *t) const { return s == t; }
+
+private:
+  std::string s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*buf++);
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(long v, int base = DEC) { return printf(base == HEX ? "%lx" : "%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return printf(base == HEX ? "%lx" : "%lu", v); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T &v) { return print(v) + println(); }
+  template <typename T> size_t println(const T &v, int fmt) { return print(v, fmt) + println(); }
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+
+  // No timeout on the host: these stop as soon as nothing is available
+  size_t readBytes(char *buf, size_t len) {
+    size_t n = 0;
+    while (n < len && available()) buf[n++] = (char)read();
+    return n;
+  }
+  size_t readBytesUntil(char terminator, char *buf, size_t len) {
+    size_t n = 0;
+    while (n < len && available()) {
+      int c = read();
+      if (c == terminator) break;
+      buf[n++] = (char)c;
+    }
+    return n;
+  }
+  using Print::write;
+};
+
+// Serial goes to stdout; tests that don't want the firmware's log lines set
+// hostSerialQuiet.
+class HostSerial : public Stream {
+public:
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  void begin(unsigned long) {}
+  using Print::write;
+};
+
+extern HostSerial Serial;
+extern bool hostSerialQuiet;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+// Deterministic, so runs repeat
+uint32_t esp_random();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+// Drive an input pin from outside, as a peripheral would; runs the handler
+// attached to it if the edge matches
+void hostDrivePin(uint8_t pin, uint8_t level);
+
+// Freeze the clock at ms; millis() and micros() then only move with
+// hostSetMillis()/hostSetMicros()/hostAdvanceMillis()
+void hostSetMillis(uint32_t ms);
+void hostSetMicros(uint64_t us);
+void hostAdvanceMillis(uint32_t ms);
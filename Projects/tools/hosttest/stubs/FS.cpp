@@ -0,0 +1,78 @@
+#include "FS.h"
+
+#include "LittleFS.h"
+
+fs::LittleFSFS LittleFS;
+uint64_t hostFsBytesWritten = 0;
+size_t hostFsSpace = SIZE_MAX;
+
+std::map<std::string, std::string> &hostFiles() {
+  static std::map<std::string, std::string> files;
+  return files;
+}
+
+namespace fs {
+
+std::string &File::data() const { return hostFiles()[path]; }
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  if (!open || !writable) return 0;
+  len = std::min(len, hostFsSpace);
+  if (hostFsSpace != SIZE_MAX) hostFsSpace -= len;
+  std::string &d = data();
+  d.replace(pos, std::min(len, d.size() - pos), (const char *)buf, len);
+  pos += len;
+  hostFsBytesWritten += len;
+  return len;
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  if (!open) return 0;
+  const std::string &d = data();
+  size_t n = std::min(len, d.size() - std::min(pos, d.size()));
+  memcpy(buf, d.data() + pos, n);
+  pos += n;
+  return n;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) ? c : -1;
+}
+
+int File::peek() {
+  if (!open || pos >= data().size()) return -1;
+  return (uint8_t)data()[pos];
+}
+
+int File::available() { return open && pos < data().size() ? (int)(data().size() - pos) : 0; }
+
+bool File::seek(uint32_t to) {
+  if (!open || to > data().size()) return false;
+  pos = to;
+  return true;
+}
+
+size_t File::size() const { return open ? data().size() : 0; }
+
+File FS::open(const char *path, const char *mode) {
+  std::map<std::string, std::string> &files = hostFiles();
+  if (mode[0] == 'r' && !files.count(path)) return File();
+  if (mode[0] == 'w') files[path].clear();
+  else files[path];
+  return File(path, mode[0] != 'r', mode[0] == 'a');
+}
+
+bool FS::exists(const char *path) { return hostFiles().count(path) != 0; }
+
+bool FS::remove(const char *path) { return hostFiles().erase(path) != 0; }
+
+bool FS::rename(const char *from, const char *to) {
+  std::map<std::string, std::string> &files = hostFiles();
+  if (!files.count(from)) return false;
+  files[to] = files[from];
+  files.erase(from);
+  return true;
+}
+
+}  // namespace fs
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+
+// The ESP32 FS API over an in-memory file table. Files are byte strings
+// keyed by path; opening for "w" truncates, "a" appends, "r" fails if the
+// file doesn't exist. Tests can inspect or damage files via hostFiles()
+// and see how much was written in hostFsBytesWritten. hostFsSpace is how
+// many more bytes fit before writes come up short, as on a full flash.
+
+namespace fs {
+
+class File : public Stream {
+public:
+  File() {}
+  File(const std::string &path, bool writable, bool append) : path(path), open(true), writable(writable) {
+    if (append) pos = data().size();
+  }
+
+  explicit operator bool() const { return open; }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t len) override;
+  size_t read(uint8_t *buf, size_t len);
+  int read() override;
+  int peek() override;
+  int available() override;
+  bool seek(uint32_t to);
+  size_t position() const { return pos; }
+  size_t size() const;
+  void close() { open = false; }
+  using Print::write;
+
+private:
+  std::string path;
+  size_t pos = 0;
+  bool open = false;
+  bool writable = false;
+
+  std::string &data() const;
+};
+
+class FS {
+public:
+  File open(const char *path, const char *mode = "r");
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+std::map<std::string, std::string> &hostFiles();
+extern uint64_t hostFsBytesWritten;
+extern size_t hostFsSpace;
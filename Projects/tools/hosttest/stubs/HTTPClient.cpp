@@ -0,0 +1,98 @@
+#include "HTTPClient.h"
+
+#include <strings.h>
+
+bool HTTPClient::begin(WiFiClient &c, const char *h, uint16_t p, const char *u, bool) {
+  client = &c;
+  host = h;
+  port = p;
+  uri = u;
+  return true;
+}
+
+void HTTPClient::end() {
+  // A connection is only reusable if its response was fully read
+  if (client && !(reuse && keepAlive && bodyRead)) client->stop();
+  headers.clear();
+  contentLength = -1;
+  bodyRead = false;
+  bufLen = bufPos = 0;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  headers += name.c_str();
+  headers += ": ";
+  headers += value.c_str();
+  headers += "\r\n";
+}
+
+int HTTPClient::readByte() {
+  if (bufPos == bufLen) {
+    int n = client->read((uint8_t *)buf, sizeof(buf));
+    if (n <= 0) return -1;
+    bufLen = n;
+    bufPos = 0;
+  }
+  return (uint8_t)buf[bufPos++];
+}
+
+int HTTPClient::readLine(std::string &line) {
+  line.clear();
+  for (;;) {
+    int c = readByte();
+    if (c < 0) return -1;
+    if (c == '\n') break;
+    if (c != '\r') line += (char)c;
+  }
+  return (int)line.size();
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t size) {
+  if (!client) return HTTPC_ERROR_NOT_CONNECTED;
+  if (!(reuse && client->connected())) {
+    if (!client->connect(host.c_str(), port, connectTimeoutMs)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  client->setTimeout(timeoutMs);
+  bufLen = bufPos = 0;
+
+  char head[256];
+  snprintf(head, sizeof(head),
+           "POST %s HTTP/1.1\r\nHost: %s:%u\r\nUser-Agent: ESP32HTTPClient\r\nConnection: %s\r\n"
+           "Content-Length: %u\r\n",
+           uri.c_str(), host.c_str(), port, reuse ? "keep-alive" : "close", (unsigned)size);
+  std::string request = head + headers + "\r\n";
+  if (client->write((const uint8_t *)request.data(), request.size()) != request.size()) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  if (size && client->write(payload, size) != size) return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+
+  std::string line;
+  if (readLine(line) < 0) return client->connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+  int code = 0;
+  if (sscanf(line.c_str(), "HTTP/1.%*d %d", &code) != 1) return HTTPC_ERROR_NO_HTTP_SERVER;
+
+  keepAlive = line.compare(0, 8, "HTTP/1.1") == 0;
+  contentLength = -1;
+  while (readLine(line) > 0) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string name = line.substr(0, colon);
+    const char *value = line.c_str() + colon + 1;
+    while (*value == ' ') value++;
+    if (!strcasecmp(name.c_str(), "Content-Length")) contentLength = atol(value);
+    else if (!strcasecmp(name.c_str(), "Connection")) keepAlive = strcasecmp(value, "close") != 0;
+  }
+  bodyRead = contentLength == 0;
+  return code;
+}
+
+String HTTPClient::getString() {
+  std::string body;
+  while (contentLength < 0 || (long)body.size() < contentLength) {
+    int c = readByte();
+    if (c < 0) break;
+    body += (char)c;
+  }
+  bodyRead = contentLength >= 0 && (long)body.size() == contentLength;
+  return String(body);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// The part of the ESP32 HTTPClient that DjangoLink uses, over a host
+// socket: HTTP/1.1, Content-Length bodies, keep-alive when setReuse(true)
+// and the server doesn't ask to close. Error codes match the ESP32 core.
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+public:
+  bool begin(WiFiClient &client, const char *host, uint16_t port, const char *uri = "/", bool https = false);
+  void end();
+
+  void setReuse(bool reuse) { this->reuse = reuse; }
+  void setConnectTimeout(int32_t ms) { connectTimeoutMs = ms; }
+  void setTimeout(uint16_t ms) { timeoutMs = ms; }
+  void addHeader(const String &name, const String &value);
+
+  int POST(uint8_t *payload, size_t size);
+  int POST(const String &payload) { return POST((uint8_t *)payload.c_str(), payload.length()); }
+
+  String getString();
+
+private:
+  WiFiClient *client = nullptr;
+  std::string host;
+  uint16_t port = 0;
+  std::string uri;
+  std::string headers;
+  bool reuse = true;
+  bool keepAlive = false;
+  int32_t connectTimeoutMs = 5000;
+  uint16_t timeoutMs = 5000;
+  long contentLength = -1;
+  bool bodyRead = false;
+
+  char buf[1024];
+  size_t bufLen = 0, bufPos = 0;
+
+  int readByte();
+  int readLine(std::string &line);
+};
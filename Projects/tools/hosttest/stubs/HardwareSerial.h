@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// A UART whose receive side is fed by the test: hostReceive() queues bytes
+// and fires onReceive() the way the ESP32 core's event task does. Anything
+// written is discarded.
+
+#define SERIAL_8N1 0x800001c
+
+typedef enum {
+  UART_NO_ERROR,
+  UART_BREAK_ERROR,
+  UART_BUFFER_FULL_ERROR,
+  UART_FIFO_OVF_ERROR,
+  UART_FRAME_ERROR,
+  UART_PARITY_ERROR,
+} hardwareSerial_error_t;
+
+typedef std::function<void(void)> OnReceiveCb;
+typedef std::function<void(hardwareSerial_error_t)> OnReceiveErrorCb;
+
+class HardwareSerial : public Stream {
+public:
+  explicit HardwareSerial(int uart = 0) { (void)uart; }
+
+  size_t setRxBufferSize(size_t size) { return rxBufferSize = size; }
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {
+    (void)baud, (void)config, (void)rxPin, (void)txPin;
+  }
+  void end() {}
+  void onReceive(OnReceiveCb cb) { receiveCb = cb; }
+  void onReceiveError(OnReceiveErrorCb cb) { errorCb = cb; }
+
+  int available() override {
+    std::lock_guard<std::mutex> lock(m);
+    return (int)rx.size();
+  }
+  int read() override {
+    uint8_t c;
+    return read(&c, 1) ? c : -1;
+  }
+  size_t read(uint8_t *buf, size_t len) {
+    std::lock_guard<std::mutex> lock(m);
+    size_t n = 0;
+    while (n < len && !rx.empty()) {
+      buf[n++] = rx.front();
+      rx.pop_front();
+    }
+    return n;
+  }
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+
+  // Bytes past the configured buffer size are lost and reported as an
+  // overrun, like the driver's ring buffer
+  void hostReceive(const uint8_t *buf, size_t len) {
+    bool overrun = false;
+    {
+      std::lock_guard<std::mutex> lock(m);
+      for (size_t i = 0; i < len; i++) {
+        if (rx.size() < rxBufferSize) rx.push_back(buf[i]);
+        else overrun = true;
+      }
+    }
+    if (overrun && errorCb) errorCb(UART_BUFFER_FULL_ERROR);
+    if (receiveCb) receiveCb();
+  }
+
+private:
+  std::mutex m;
+  std::deque<uint8_t> rx;
+  size_t rxBufferSize = 256;
+  OnReceiveCb receiveCb;
+  OnReceiveErrorCb errorCb;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+// An HD44780 in 4-bit, two-line mode, modelled down to its DDRAM and
+// address counter: line 1 is 0x00-0x27, line 2 is 0x40-0x67, and the
+// counter runs on (and wraps between lines) after every character. Counts
+// each bus operation and what it would cost in controller time.
+
+class LiquidCrystal : public Print {
+public:
+  static const uint32_t CLEAR_US = 1520;  // clear and home
+  static const uint32_t OP_US = 37;       // everything else
+
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+    (void)rs, (void)enable, (void)d0, (void)d1, (void)d2, (void)d3;
+    memset(ddram, ' ', sizeof(ddram));
+  }
+
+  void begin(uint8_t cols, uint8_t rows) {
+    (void)cols, (void)rows;
+    clear();
+  }
+
+  void clear() {
+    memset(ddram, ' ', sizeof(ddram));
+    address = 0;
+    clears++;
+    busUs += CLEAR_US;
+  }
+
+  void setCursor(uint8_t col, uint8_t row) {
+    address = (row ? 0x40 : 0x00) + col;
+    commands++;
+    busUs += OP_US;
+  }
+
+  size_t write(uint8_t c) override {
+    uint8_t line = address >= 0x40;
+    uint8_t col = address - (line ? 0x40 : 0x00);
+    if (col < 40) ddram[line][col] = c;
+    address++;
+    if (address == 0x28) address = 0x40;
+    else if (address == 0x68) address = 0x00;
+    characters++;
+    busUs += OP_US;
+    return 1;
+  }
+  using Print::write;
+
+  // The first cols characters of a line, as shown
+  std::string shown(uint8_t row, uint8_t cols = 16) const { return std::string(ddram[row], cols); }
+
+  uint32_t operations() const { return clears + commands + characters; }
+
+  uint32_t clears = 0, commands = 0, characters = 0;
+  uint64_t busUs = 0;
+
+private:
+  char ddram[2][40];
+  uint8_t address = 0;
+};
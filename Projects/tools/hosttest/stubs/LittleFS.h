@@ -0,0 +1,22 @@
+#pragma once
+
+#include <FS.h>
+
+// begin() succeeds unless a test clears LittleFS.mountable
+
+namespace fs {
+
+class LittleFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false) {
+    (void)formatOnFail;
+    return mountable;
+  }
+  void end() {}
+
+  bool mountable = true;
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
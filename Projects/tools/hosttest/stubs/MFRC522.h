@@ -0,0 +1,171 @@
+#pragma once
+
+#include <Arduino.h>
+
+// An RC522 with at most one card in its field, modelled as far as
+// CardReader drives it: the interrupt registers and the IRQ line, a REQA
+// started through the FIFO and BitFramingReg, and the library calls that
+// select, read and halt a card. A card answers REQA unless it has been
+// halted, and a halted card stays silent until it leaves the field.
+//
+// The IRQ line is wired to hostIrqPin (-1: not connected) and follows
+// ComIrqReg & ComIEnReg, inverted when ComIEnReg's IRqInv bit is set.
+// Every exchange the library would make over SPI counts in spiWrites /
+// spiReads; a presence check no card answers blocks for hostRxTimeoutMs.
+
+class MFRC522 {
+public:
+  enum PCD_Register : uint8_t {
+    CommandReg = 0x01 << 1,
+    ComIEnReg = 0x02 << 1,
+    DivIEnReg = 0x03 << 1,
+    ComIrqReg = 0x04 << 1,
+    DivIrqReg = 0x05 << 1,
+    FIFODataReg = 0x09 << 1,
+    FIFOLevelReg = 0x0A << 1,
+    BitFramingReg = 0x0D << 1,
+  };
+
+  enum PCD_Command : uint8_t {
+    PCD_Idle = 0x00,
+    PCD_Transceive = 0x0C,
+  };
+
+  enum PICC_Command : uint8_t {
+    PICC_CMD_REQA = 0x26,
+  };
+
+  struct Uid {
+    byte size;
+    byte uidByte[10];
+    byte sak;
+  };
+
+  static const uint8_t RX_IRQ = 0x20;
+
+  Uid uid = {};
+
+  int8_t hostIrqPin = -1;
+  uint32_t hostRxTimeoutMs = 0;
+  uint32_t hostFailSelects = 0;  // the next n selects fail
+  uint32_t spiWrites = 0, spiReads = 0;
+  uint32_t reqaAnswered = 0;     // by a card, either way of probing
+
+  MFRC522(byte ss = 0, byte rst = 0) { (void)ss, (void)rst; }
+
+  void PCD_Init() {
+    comIEn = divIEn = comIrq = 0;
+    command = PCD_Idle;
+    fifoLevel = 0;
+    updateIrq();
+  }
+
+  void PCD_WriteRegister(PCD_Register reg, byte value) {
+    spiWrites++;
+    switch (reg) {
+      case CommandReg:
+        command = value & 0x0F;
+        break;
+      case ComIEnReg:
+        comIEn = value;
+        break;
+      case DivIEnReg:
+        divIEn = value;
+        break;
+      case ComIrqReg:
+        // Set1: bit 7 says whether the marked bits are set or cleared
+        if (value & 0x80) comIrq |= value & 0x7F;
+        else comIrq &= ~value;
+        break;
+      case FIFOLevelReg:
+        if (value & 0x80) fifoLevel = 0;
+        break;
+      case FIFODataReg:
+        if (fifoLevel < sizeof(fifo)) fifo[fifoLevel++] = value;
+        break;
+      case BitFramingReg:
+        if ((value & 0x80) && command == PCD_Transceive && fifoLevel == 1 && fifo[0] == PICC_CMD_REQA) {
+          fifoLevel = 0;
+          if (answersReqa()) comIrq |= RX_IRQ;
+        }
+        break;
+      default:
+        break;
+    }
+    updateIrq();
+  }
+
+  bool PICC_IsNewCardPresent() {
+    exchange();
+    if (answersReqa()) return true;
+    delay(hostRxTimeoutMs);
+    return false;
+  }
+
+  // Anticollision and select; the card answers, so RxIRq goes up again
+  bool PICC_ReadCardSerial() {
+    exchange();
+    if (!present || halted) return false;
+    comIrq |= RX_IRQ;
+    updateIrq();
+    if (hostFailSelects) {
+      hostFailSelects--;
+      return false;
+    }
+    uid = card;
+    return true;
+  }
+
+  // HLTA has no answer: success is the receive timing out
+  byte PICC_HaltA() {
+    exchange();
+    if (present) halted = true;
+    return 0;
+  }
+
+  void hostPlace(const uint8_t *uidBytes, uint8_t size) {
+    memset(&card, 0, sizeof(card));
+    card.size = size;
+    memcpy(card.uidByte, uidBytes, size);
+    present = true;
+    halted = false;
+  }
+
+  void hostRemove() {
+    present = false;
+    halted = false;
+  }
+
+  bool hostIrqLine() const {
+    bool raised = (comIrq & comIEn & 0x7F) != 0;
+    return (comIEn & 0x80) ? !raised : raised;
+  }
+
+private:
+  byte comIEn = 0, divIEn = 0, comIrq = 0;
+  byte command = PCD_Idle;
+  byte fifo[16];
+  uint8_t fifoLevel = 0;
+  Uid card = {};
+  bool present = false;
+  bool halted = false;
+
+  bool answersReqa() {
+    if (!present || halted) return false;
+    reqaAnswered++;
+    return true;
+  }
+
+  // PCD_CommunicateWithPICC: clear the flags, load the FIFO, start, then
+  // read ComIrqReg until done and the answer back from the FIFO
+  void exchange() {
+    spiWrites += 5;
+    spiReads += 3;
+    comIrq = 0;
+    updateIrq();
+  }
+
+  void updateIrq() {
+    if (hostIrqPin >= 0) hostDrivePin(hostIrqPin, hostIrqLine() ? HIGH : LOW);
+  }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+
+// NVS as a map of namespaces, each a map of key to bytes. As on the ESP32,
+// opening a namespace read-only fails until something has been written to
+// it. Tests can inspect or clear it via hostNvs() and count the writes with
+// hostNvsWrites().
+
+inline std::map<std::string, std::map<std::string, std::string> > &hostNvs() {
+  static std::map<std::string, std::map<std::string, std::string> > nvs;
+  return nvs;
+}
+
+inline uint32_t &hostNvsWrites() {
+  static uint32_t writes = 0;
+  return writes;
+}
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false) {
+    if (readOnly && !hostNvs().count(name)) return false;
+    ns = &hostNvs()[name];
+    this->readOnly = readOnly;
+    return true;
+  }
+  void end() { ns = nullptr; }
+
+  String getString(const char *key, const String &defaultValue = String()) {
+    const std::string *v = find(key);
+    return v ? String(*v) : defaultValue;
+  }
+  size_t getBytes(const char *key, void *buf, size_t len) {
+    const std::string *v = find(key);
+    if (!v || v->size() > len) return 0;
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) {
+    const std::string *v = find(key);
+    return v && v->size() == 1 ? (uint8_t)(*v)[0] : defaultValue;
+  }
+
+  size_t putString(const char *key, const char *value) { return put(key, std::string(value)); }
+  size_t putBytes(const char *key, const void *value, size_t len) {
+    return put(key, std::string((const char *)value, len));
+  }
+  size_t putUChar(const char *key, uint8_t value) { return put(key, std::string(1, (char)value)); }
+
+private:
+  std::map<std::string, std::string> *ns = nullptr;
+  bool readOnly = false;
+
+  const std::string *find(const char *key) const {
+    if (!ns) return nullptr;
+    std::map<std::string, std::string>::const_iterator it = ns->find(key);
+    return it == ns->end() ? nullptr : &it->second;
+  }
+
+  size_t put(const char *key, const std::string &value) {
+    if (!ns || readOnly) return 0;
+    (*ns)[key] = value;
+    hostNvsWrites()++;
+    return value.size();
+  }
+};
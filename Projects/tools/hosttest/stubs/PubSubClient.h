@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// PubSubClient without a broker. Publishes are recorded and handed to
+// hostBroker, which plays the server and can answer with hostDeliver();
+// delivered messages reach the callback on the next loop(), as they do on
+// the ESP32. The client under test is the last one constructed.
+
+class PubSubClient {
+public:
+  typedef std::function<void(char *, uint8_t *, unsigned int)> Callback;
+
+  struct Message {
+    std::string topic, payload;
+    bool retained;
+  };
+
+  explicit PubSubClient(WiFiClient &) { hostClient() = this; }
+
+  PubSubClient &setServer(const char *, uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) {
+    bufferSize = size;
+    return true;
+  }
+  PubSubClient &setKeepAlive(uint16_t) { return *this; }
+  PubSubClient &setCallback(Callback cb) {
+    callback = cb;
+    return *this;
+  }
+
+  bool connect(const char *, const char *, const char *, const char *, uint8_t, bool, const char *, bool) {
+    session = hostAccept;
+    return session;
+  }
+  bool connected() { return session; }
+  int state() { return session ? 0 : -2; }
+  void disconnect() { session = false; }
+
+  bool publish(const char *topic, const char *payload, bool retained = false) {
+    // Fixed header, topic length and topic, as PubSubClient checks it
+    if (!session || 5 + 2 + strlen(topic) + strlen(payload) > bufferSize) return false;
+    published.push_back(Message{ topic, payload, retained });
+    if (hostBroker) hostBroker(published.back());
+    return true;
+  }
+  bool subscribe(const char *topic, uint8_t) {
+    subscriptions.push_back(topic);
+    return session;
+  }
+
+  bool loop() {
+    std::vector<Message> in;
+    in.swap(inbox);
+    for (Message &m : in) {
+      if (callback) callback(&m.topic[0], (uint8_t *)&m.payload[0], m.payload.size());
+    }
+    return session;
+  }
+
+  void hostDeliver(const std::string &topic, const std::string &payload) {
+    inbox.push_back(Message{ topic, payload, false });
+  }
+
+  static PubSubClient *&hostClient() {
+    static PubSubClient *client = nullptr;
+    return client;
+  }
+
+  std::function<void(const Message &)> hostBroker;
+  bool hostAccept = true;
+  std::vector<Message> published;
+  std::vector<std::string> subscriptions;
+
+private:
+  Callback callback;
+  uint16_t bufferSize = 256;
+  bool session = false;
+  std::vector<Message> inbox;
+};
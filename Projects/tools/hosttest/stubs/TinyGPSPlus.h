@@ -0,0 +1,184 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The part of TinyGPSPlus the firmware reads: RMC and GGA sentences (any
+// talker), checksums and the counters. Values commit when a sentence with
+// a valid checksum ends, and only if it reported a fix, as in the library.
+
+class TinyGPSLocation {
+public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  double lat() {
+    updated = false;
+    return latDeg;
+  }
+  double lng() {
+    updated = false;
+    return lngDeg;
+  }
+
+private:
+  friend class TinyGPSPlus;
+  bool valid = false, updated = false;
+  double latDeg = 0, lngDeg = 0;
+};
+
+class TinyGPSDate {
+public:
+  bool isValid() const { return valid; }
+  uint16_t year() const { return 2000 + value % 100; }
+  uint8_t month() const { return value / 100 % 100; }
+  uint8_t day() const { return value / 10000; }
+
+private:
+  friend class TinyGPSPlus;
+  bool valid = false;
+  uint32_t value = 0;  // ddmmyy
+};
+
+class TinyGPSTime {
+public:
+  bool isValid() const { return valid; }
+  uint8_t hour() const { return value / 10000; }
+  uint8_t minute() const { return value / 100 % 100; }
+  uint8_t second() const { return value % 100; }
+
+private:
+  friend class TinyGPSPlus;
+  bool valid = false;
+  uint32_t value = 0;  // hhmmss
+};
+
+class TinyGPSDecimal {
+public:
+  bool isValid() const { return valid; }
+  double value() const { return v; }
+  double kmph() const { return v * 1.852; }  // speed is in knots
+  double meters() const { return v; }        // altitude is in meters
+
+private:
+  friend class TinyGPSPlus;
+  bool valid = false;
+  double v = 0;
+};
+
+class TinyGPSInteger {
+public:
+  bool isValid() const { return valid; }
+  uint32_t value() const { return v; }
+
+private:
+  friend class TinyGPSPlus;
+  bool valid = false;
+  uint32_t v = 0;
+};
+
+class TinyGPSPlus {
+public:
+  TinyGPSLocation location;
+  TinyGPSDate date;
+  TinyGPSTime time;
+  TinyGPSDecimal speed;
+  TinyGPSDecimal altitude;
+  TinyGPSInteger satellites;
+
+  // True when a valid RMC or GGA sentence has just ended
+  bool encode(char c) {
+    chars++;
+    if (c == '$') {
+      len = 0;
+      inSentence = true;
+      return false;
+    }
+    if (!inSentence) return false;
+    if (c != '\r' && c != '\n') {
+      if (len < sizeof(sentence) - 1) sentence[len++] = c;
+      else inSentence = false;
+      return false;
+    }
+    inSentence = false;
+    sentence[len] = '\0';
+    return finish();
+  }
+
+  uint32_t charsProcessed() const { return chars; }
+  uint32_t sentencesWithFix() const { return withFix; }
+  uint32_t failedChecksum() const { return failed; }
+  uint32_t passedChecksum() const { return passed; }
+
+private:
+  char sentence[100];
+  size_t len = 0;
+  bool inSentence = false;
+  uint32_t chars = 0, withFix = 0, failed = 0, passed = 0;
+
+  static double degrees(const char *value, const char *hemisphere) {
+    double v = atof(value);
+    int deg = (int)(v / 100);
+    double out = deg + (v - deg * 100) / 60;
+    return *hemisphere == 'S' || *hemisphere == 'W' ? -out : out;
+  }
+
+  bool finish() {
+    char *star = strchr(sentence, '*');
+    if (!star) return false;
+    uint8_t sum = 0;
+    for (char *p = sentence; p < star; p++) sum ^= (uint8_t)*p;
+    if (strtoul(star + 1, nullptr, 16) != sum) {
+      failed++;
+      return false;
+    }
+    passed++;
+    *star = '\0';
+
+    const char *f[16];
+    int n = 0;
+    f[n++] = sentence;
+    for (char *p = sentence; *p && n < 16; p++) {
+      if (*p == ',') {
+        *p = '\0';
+        f[n++] = p + 1;
+      }
+    }
+    if (strlen(f[0]) != 5) return false;
+    const char *type = f[0] + 2;
+
+    if (!strcmp(type, "RMC") && n >= 10) {
+      setTime(f[1]);
+      if (*f[2] != 'A') return true;
+      withFix++;
+      setLocation(degrees(f[3], f[4]), degrees(f[5], f[6]));
+      speed.v = atof(f[7]);
+      speed.valid = true;
+      date.value = strtoul(f[9], nullptr, 10);
+      date.valid = *f[9] != '\0';
+      return true;
+    }
+    if (!strcmp(type, "GGA") && n >= 10) {
+      setTime(f[1]);
+      satellites.v = strtoul(f[7], nullptr, 10);
+      satellites.valid = true;
+      if (atoi(f[6]) == 0) return true;
+      withFix++;
+      setLocation(degrees(f[2], f[3]), degrees(f[4], f[5]));
+      altitude.v = atof(f[9]);
+      altitude.valid = true;
+      return true;
+    }
+    return false;
+  }
+
+  void setTime(const char *hhmmss) {
+    if (!*hhmmss) return;
+    time.value = strtoul(hhmmss, nullptr, 10);
+    time.valid = true;
+  }
+
+  void setLocation(double lat, double lng) {
+    location.latDeg = lat;
+    location.lngDeg = lng;
+    location.valid = location.updated = true;
+  }
+};
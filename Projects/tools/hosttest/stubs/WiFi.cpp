@@ -0,0 +1,188 @@
+#include "WiFi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid) {
+  (void)password;
+  uint32_t now = millis();
+  hostBegins.push_back({ now, bssid != nullptr, (uint8_t)channel });
+  pending.clear();
+  associated = false;
+  attempting = true;
+  if (hostAp.silent) return WL_DISCONNECTED;
+
+  bool found = hostAp.up && hostAp.ssid == ssid &&
+               (!bssid || (memcmp(bssid, hostAp.bssid, sizeof(hostAp.bssid)) == 0 && channel == hostAp.channel));
+  uint32_t heard = now + (bssid ? 0 : hostAp.scanMs);
+  if (found) {
+    queue(heard + hostAp.joinMs / 2, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    queue(heard + hostAp.joinMs, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  } else {
+    queue(heard + (bssid ? hostAp.failMs : 0), ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+  }
+  return WL_DISCONNECTED;
+}
+
+// Leaving (or abandoning an attempt) is reported like any other disconnect
+bool WiFiClass::disconnect() {
+  hostDisconnects++;
+  pending.clear();
+  if (associated || attempting) queue(millis(), ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+  associated = attempting = false;
+  return true;
+}
+
+void WiFiClass::hostApDown() {
+  hostAp.up = false;
+  if (!associated) return;
+  pending.clear();
+  queue(millis(), ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+}
+
+void WiFiClass::queue(uint32_t at, arduino_event_id_t id, uint8_t reason) {
+  Pending p = { at, id, {} };
+  if (id == ARDUINO_EVENT_WIFI_STA_CONNECTED) {
+    memcpy(p.info.wifi_sta_connected.bssid, hostAp.bssid, sizeof(hostAp.bssid));
+    p.info.wifi_sta_connected.channel = hostAp.channel;
+  } else if (id == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    p.info.wifi_sta_disconnected.reason = reason;
+  }
+  pending.push_back(p);
+}
+
+void WiFiClass::hostDeliverEvents() {
+  uint32_t now = millis();
+  while (!pending.empty() && (int32_t)(now - pending.front().at) >= 0) {
+    Pending p = pending.front();
+    pending.erase(pending.begin());
+    if (p.id == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+      associated = true;
+      attempting = false;
+      hostStatus = WL_CONNECTED;
+    } else if (p.id == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+      associated = attempting = false;
+      hostStatus = WL_DISCONNECTED;
+    }
+    for (WiFiEventFuncCb &cb : handlers) cb(p.id, p.info);
+  }
+}
+
+void WiFiClass::hostReset() {
+  handlers.clear();
+  pending.clear();
+  hostBegins.clear();
+  hostAp = HostAp();
+  hostDisconnects = 0;
+  associated = attempting = false;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t connectTimeoutMs) {
+  stop();
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *res = nullptr;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(host, service, &hints, &res) != 0 || !res) return 0;
+
+  int s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (s < 0) {
+    freeaddrinfo(res);
+    return 0;
+  }
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+  int rc = ::connect(s, res->ai_addr, res->ai_addrlen);
+  freeaddrinfo(res);
+  if (rc < 0 && errno == EINPROGRESS) {
+    pollfd p = { s, POLLOUT, 0 };
+    int err = 0;
+    socklen_t len = sizeof(err);
+    rc = (poll(&p, 1, connectTimeoutMs) == 1 && getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && !err)
+             ? 0
+             : -1;
+  }
+  if (rc < 0) {
+    close(s);
+    return 0;
+  }
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL) & ~O_NONBLOCK);
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+  setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  fd = s;
+  return 1;
+}
+
+// Like the ESP32 client: a socket is connected until a peek says the peer
+// closed it
+uint8_t WiFiClient::connected() {
+  if (fd < 0) return 0;
+  char c;
+  ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) return 1;
+  stop();
+  return 0;
+}
+
+void WiFiClient::stop() {
+  if (fd < 0) return;
+  close(fd);
+  fd = -1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t len) {
+  if (fd < 0) return 0;
+  size_t sent = 0;
+  while (sent < len) {
+    ssize_t n = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      break;
+    }
+    sent += n;
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  if (fd < 0) return 0;
+  int n = 0;
+  return ioctl(fd, FIONREAD, &n) == 0 ? n : 0;
+}
+
+bool WiFiClient::waitReadable() {
+  pollfd p = { fd, POLLIN, 0 };
+  return poll(&p, 1, timeoutMs) == 1;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t len) {
+  if (fd < 0 || !waitReadable()) return -1;
+  ssize_t n = recv(fd, buf, len, 0);
+  if (n <= 0) {
+    stop();
+    return -1;
+  }
+  return (int)n;
+}
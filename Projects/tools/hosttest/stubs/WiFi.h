@@ -0,0 +1,174 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Station status is whatever the test sets, unless the station is driven
+// through begin(): then a modelled access point (WiFi.hostAp) answers and
+// the WiFi events that would come from the WiFi task are queued with the
+// time they are due. hostDeliverEvents() runs the handlers for the ones
+// whose time has come, so a test decides where they land relative to
+// loop(). WiFiClient is a real TCP socket.
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+} wifi_mode_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+} arduino_event_id_t;
+
+// wifi_err_reason_t, the ones the model sends
+enum {
+  WIFI_REASON_ASSOC_LEAVE = 8,
+  WIFI_REASON_BEACON_TIMEOUT = 200,
+  WIFI_REASON_NO_AP_FOUND = 201,
+};
+
+typedef union {
+  struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+  } wifi_sta_connected;
+  struct {
+    uint8_t bssid[6];
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef std::function<void(arduino_event_id_t, arduino_event_info_t)> WiFiEventFuncCb;
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{ a, b, c, d } {}
+  String toString() const {
+    char s[16];
+    snprintf(s, sizeof(s), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(s);
+  }
+
+private:
+  uint8_t bytes[4];
+};
+
+class WiFiClass {
+public:
+  // The network the station can see. A begin() with a BSSID and channel
+  // skips the scan, and fails after failMs unless they match the AP's.
+  struct HostAp {
+    bool up = true;
+    bool silent = false;  // begin() never hears back
+    std::string ssid = "home";
+    uint8_t bssid[6] = { 0x24, 0x0A, 0xC4, 0x01, 0x02, 0x03 };
+    uint8_t channel = 6;
+    uint32_t scanMs = 2200;  // full channel scan
+    uint32_t joinMs = 400;   // association, WPA handshake and DHCP
+    uint32_t failMs = 1500;  // how long a cached BSSID is looked for
+  };
+
+  struct HostBegin {
+    uint32_t at;
+    bool cached;  // BSSID and channel given
+    uint8_t channel;
+  };
+
+  wl_status_t status() const { return hostStatus; }
+
+  void persistent(bool on) { hostPersistent = on; }
+  bool mode(wifi_mode_t m) {
+    hostMode = m;
+    return true;
+  }
+  bool setAutoReconnect(bool on) {
+    hostAutoReconnect = on;
+    return true;
+  }
+  int onEvent(WiFiEventFuncCb cb) {
+    handlers.push_back(cb);
+    return (int)handlers.size();
+  }
+
+  wl_status_t begin(const char *ssid, const char *password, int32_t channel = 0, const uint8_t *bssid = nullptr);
+  bool disconnect();
+  IPAddress localIP() const { return associated ? IPAddress(192, 168, 1, 50) : IPAddress(); }
+  int8_t RSSI() const { return associated ? -61 : 0; }
+
+  // The AP goes away (the station sees a beacon timeout) or comes back
+  void hostApDown();
+  void hostApUp() { hostAp.up = true; }
+  // DHCP lease lost while staying associated
+  void hostLoseIp() { queue(millis(), ARDUINO_EVENT_WIFI_STA_LOST_IP); }
+  // Run the handlers of events due by now
+  void hostDeliverEvents();
+  // Back to a fresh driver: no handlers, nothing queued
+  void hostReset();
+
+  volatile wl_status_t hostStatus = WL_CONNECTED;
+  HostAp hostAp;
+  std::vector<HostBegin> hostBegins;
+  uint32_t hostDisconnects = 0;
+  bool hostPersistent = true;
+  bool hostAutoReconnect = true;
+  wifi_mode_t hostMode = WIFI_OFF;
+
+private:
+  struct Pending {
+    uint32_t at;
+    arduino_event_id_t id;
+    arduino_event_info_t info;
+  };
+
+  std::vector<WiFiEventFuncCb> handlers;
+  std::vector<Pending> pending;
+  bool associated = false;
+  bool attempting = false;
+
+  void queue(uint32_t at, arduino_event_id_t id, uint8_t reason = 0);
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Stream {
+public:
+  WiFiClient() {}
+  ~WiFiClient() { stop(); }
+
+  int connect(const char *host, uint16_t port, int32_t timeoutMs = 3000);
+  uint8_t connected();
+  void stop();
+
+  // Reads wait up to this long for data, like the ESP32 client
+  void setTimeout(uint32_t ms) { timeoutMs = ms; }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t len) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t len);
+  using Print::write;
+
+private:
+  int fd = -1;
+  uint32_t timeoutMs = 5000;
+
+  WiFiClient(const WiFiClient &);
+  WiFiClient &operator=(const WiFiClient &);
+
+  bool waitReadable();
+};
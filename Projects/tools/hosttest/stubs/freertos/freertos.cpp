@@ -0,0 +1,132 @@
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+
+struct HostTask {
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notified = 0;
+};
+
+struct HostQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t> > items;
+};
+
+struct HostSemaphore {
+  std::mutex m;
+  std::condition_variable cv;
+  UBaseType_t count;
+  UBaseType_t maxCount;
+};
+
+static thread_local HostTask *currentTask = nullptr;
+
+// Waits on cv until ready() or the ticks run out; portMAX_DELAY waits forever
+template <typename Ready>
+static bool waitFor(std::unique_lock<std::mutex> &lock, std::condition_variable &cv, TickType_t ticks,
+                    Ready ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t,
+                                   TaskHandle_t *handle, BaseType_t) {
+  HostTask *task = new HostTask();
+  if (handle) *handle = task;
+  std::thread([fn, arg, task]() {
+    currentTask = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+void vTaskDelete(TaskHandle_t) {
+  // A task deleting itself just parks; the process exits around it
+  for (;;) std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->m);
+  task->notified++;
+  task->cv.notify_one();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  HostTask *task = currentTask;
+  if (!task) return 0;
+  std::unique_lock<std::mutex> lock(task->m);
+  waitFor(lock, task->cv, ticks, [task]() { return task->notified > 0; });
+  uint32_t value = task->notified;
+  if (value) task->notified = clear ? 0 : value - 1;
+  return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue *q = new HostQueue();
+  q->length = length;
+  q->itemSize = itemSize;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitFor(lock, q->cv, ticks, [q]() { return q->items.size() < q->length; })) return pdFALSE;
+  const uint8_t *p = static_cast<const uint8_t *>(item);
+  q->items.push_back(std::vector<uint8_t>(p, p + q->itemSize));
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->m);
+  if (!waitFor(lock, q->cv, ticks, [q]() { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->m);
+  return q->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  HostSemaphore *s = new HostSemaphore();
+  s->count = initialCount;
+  s->maxCount = maxCount;
+  return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(s->m);
+  if (!waitFor(lock, s->cv, ticks, [s]() { return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lock(s->m);
+  if (s->count == s->maxCount) return pdFALSE;
+  s->count++;
+  s->cv.notify_one();
+  return pdTRUE;
+}
@@ -0,0 +1,237 @@
+// TrackLog on the host LittleFS: points come back in order and intact
+// across batches and reboots, a full log drops whole old pages without
+// rewriting the file on every seal, a compaction that runs out of flash
+// keeps the old file, and a page whose CRC passes but whose records don't
+// decode is counted as dropped instead of vanishing.
+
+#include <TrackLog.h>
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "hosttest.h"
+
+static const time_t START = 1710484200;  // 2024-03-15 06:30:00 UTC
+static const char DEVICE_ID[] = "esp32_001";
+
+// The i-th fix of a slow drive, one every 5 s
+static GpsFix fixAt(uint32_t i) {
+  time_t t = START + (time_t)i * 5;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  GpsFix f = {};
+  f.seq = i + 1;
+  f.lat = -15.4167 + i * 1e-5;
+  f.lon = 28.2833 + (i % 7) * 1e-5;
+  f.speedKmph = 36.0f + i % 5;
+  f.altitudeM = 1279.0f;
+  f.year = tm.tm_year + 1900;
+  f.month = tm.tm_mon + 1;
+  f.day = tm.tm_mday;
+  f.hour = tm.tm_hour;
+  f.minute = tm.tm_min;
+  f.second = tm.tm_sec;
+  return f;
+}
+
+// Index of each point in the batch, from its timestamp; -1 if it doesn't
+// match any fixAt() exactly
+static void parseBatch(const char *json, std::vector<long> &out) {
+  const char *p = json;
+  while ((p = strstr(p, "\"timestamp\":\"")) != nullptr) {
+    struct tm tm = {};
+    double lat, lon;
+    long index = -1;
+    if (sscanf(p, "\"timestamp\":\"%d-%d-%d %d:%d:%d\",\"latitude\":%lf,\"longitude\":%lf", &tm.tm_year,
+               &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &lat, &lon) == 8) {
+      tm.tm_year -= 1900;
+      tm.tm_mon -= 1;
+      long i = (long)(timegm(&tm) - START) / 5;
+      GpsFix f = fixAt(i);
+      if (fabs(lat - f.lat) < 1e-6 && fabs(lon - f.lon) < 1e-6) index = i;
+    }
+    out.push_back(index);
+    p++;
+  }
+}
+
+// Upload everything, batch by batch
+static std::vector<long> drain(TrackLog &log) {
+  static char json[4096];
+  std::vector<long> got;
+  while (log.pending()) {
+    uint16_t n = log.buildBatch(json, sizeof(json), DEVICE_ID);
+    size_t before = got.size();
+    parseBatch(json, got);
+    CHECK_EQ(got.size() - before, n);
+    log.commit();
+    if (!n && log.pending()) break;
+  }
+  return got;
+}
+
+static void reset() { hostFiles().clear(); }
+
+static void testRoundTrip() {
+  reset();
+  TrackLog log;
+  log.begin();
+  for (uint32_t i = 0; i < 100; i++) CHECK(log.append(fixAt(i)));
+  CHECK_EQ(log.pending(), 100);
+  CHECK(log.bytesPerFix() < 8);
+
+  std::vector<long> got = drain(log);
+  CHECK_EQ(got.size(), 100);
+  for (size_t i = 0; i < got.size(); i++) CHECK_EQ(got[i], (long)i);
+  CHECK_EQ(log.pending(), 0);
+  CHECK_EQ(log.dropped(), 0);
+  CHECK(hostFiles().empty());
+}
+
+static void testReboot() {
+  reset();
+  static char json[4096];
+  uint16_t first;
+  {
+    TrackLog log;
+    log.begin();
+    for (uint32_t i = 0; i < 100; i++) log.append(fixAt(i));
+    first = log.buildBatch(json, sizeof(json), DEVICE_ID);
+    CHECK(first > 0 && first < 100);
+    log.commit();
+    // Sent but not acknowledged when the power goes
+    log.buildBatch(json, sizeof(json), DEVICE_ID);
+  }
+  TrackLog log;
+  log.begin();
+  CHECK_EQ(log.pending(), 100 - first);
+  std::vector<long> got = drain(log);
+  CHECK_EQ(got.size(), 100 - first);
+  if (!got.empty()) CHECK_EQ(got[0], first);
+}
+
+// Weeks offline: the log stays at MAX_PAGES unsent pages, the oldest go
+// first, and only every COMPACT_AFTER drops cost a copy of the file
+static void testFullLog() {
+  reset();
+  TrackLog log;
+  log.begin();
+  const uint32_t N = 70000, STEADY = 20000;
+  uint64_t writtenBefore = 0;
+  size_t largestLog = 0;
+  for (uint32_t i = 0; i < N; i++) {
+    if (i == N - STEADY) writtenBefore = hostFsBytesWritten;
+    CHECK(log.append(fixAt(i)));
+    std::map<std::string, std::string>::const_iterator f = hostFiles().find("/track.log");
+    if (f != hostFiles().end()) largestLog = max(largestLog, f->second.size());
+  }
+  double perAppend = (double)(hostFsBytesWritten - writtenBefore) / STEADY;
+  printf("full log: %lu dropped, %lu kept, largest file %zu bytes, %.0f bytes written per append\n",
+         (unsigned long)log.dropped(), (unsigned long)log.pending(), largestLog, perAppend);
+
+  CHECK(log.dropped() > 0);
+  CHECK_EQ(log.pending() + log.dropped(), N);
+  CHECK(largestLog <= (size_t)(TrackLog::MAX_PAGES + TrackLog::COMPACT_AFTER) * TrackLog::PAGE_SIZE);
+  // Compacting on every seal wrote the whole log (~256 KB) per ~45 appends
+  CHECK(perAppend < 4 * TrackLog::PAGE_SIZE);
+
+  // Survives a reboot with dead pages still in front of the head
+  TrackLog again;
+  again.begin();
+  CHECK_EQ(again.pending(), log.pending());
+  std::vector<long> got = drain(again);
+  CHECK_EQ(got.size(), log.pending());
+  bool ordered = !got.empty() && got[0] == (long)log.dropped();
+  for (size_t i = 1; i < got.size(); i++) ordered &= got[i] == got[i - 1] + 1;
+  CHECK(ordered);
+}
+
+// The flash fills up while the unsent pages are being copied: the old log
+// stays, nothing is lost, and the next compaction with room goes through
+static void testCompactionFails() {
+  reset();
+  TrackLog log;
+  log.begin();
+  const uint32_t N = 4000;
+  for (uint32_t i = 0; i < N; i++) log.append(fixAt(i));
+  size_t logSize = hostFiles()["/track.log"].size();
+
+  static char json[4096];
+  std::vector<long> got;
+  bool failed = false, compacted = false;
+  while (log.pending()) {
+    uint16_t n = log.buildBatch(json, sizeof(json), DEVICE_ID);
+    parseBatch(json, got);
+    // Room for a few pages only, on the first attempt
+    hostFsSpace = failed ? SIZE_MAX : 3 * TrackLog::PAGE_SIZE + 100;
+    uint64_t before = hostFsBytesWritten;
+    log.commit();
+    if (!failed && hostFsBytesWritten - before > TrackLog::PAGE_SIZE) {
+      failed = true;
+      CHECK(!hostFiles().count("/track.tmp"));
+      CHECK_EQ(hostFiles()["/track.log"].size(), logSize);
+    } else if (failed && hostFiles().count("/track.log") && hostFiles()["/track.log"].size() < logSize) {
+      compacted = true;
+    }
+    if (!n && log.pending()) break;
+  }
+  hostFsSpace = SIZE_MAX;
+  CHECK(failed);
+  CHECK(compacted);
+  CHECK_EQ(got.size(), N);
+  CHECK_EQ(log.dropped(), 0);
+  bool ordered = got.size() == N;
+  for (size_t i = 0; i < got.size() && ordered; i++) ordered = got[i] == (long)i;
+  CHECK(ordered);
+}
+
+static uint16_t crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// Page header: magic, used, count, reserved, crc
+static void testUndecodablePage() {
+  reset();
+  TrackLog log;
+  log.begin();
+  for (uint32_t i = 0; i < 100; i++) log.append(fixAt(i));
+
+  std::string &file = hostFiles()["/track.log"];
+  CHECK(file.size() >= TrackLog::PAGE_SIZE);
+  if (file.size() < TrackLog::PAGE_SIZE) return;
+  uint8_t *page = (uint8_t *)&file[0];
+  uint16_t used = page[2] | page[3] << 8;
+  uint8_t count = page[4];
+  // The last varint now runs off the end of the payload
+  page[8 + used - 1] |= 0x80;
+  uint16_t crc = crc16(page + 8, used);
+  page[6] = (uint8_t)crc;
+  page[7] = crc >> 8;
+
+  std::vector<long> got = drain(log);
+  CHECK_EQ(got.size(), 99);
+  CHECK_EQ(log.dropped(), 1);
+  CHECK_EQ(log.pending(), 0);
+  bool skippedOnlyThatOne = got.size() == 99;
+  for (size_t i = 0; i < got.size() && skippedOnlyThatOne; i++) {
+    skippedOnlyThatOne = got[i] == (long)(i < (size_t)count - 1 ? i : i + 1);
+  }
+  CHECK(skippedOnlyThatOne);
+}
+
+int main() {
+  hostSerialQuiet = true;
+  testRoundTrip();
+  testReboot();
+  testUndecodablePage();
+  testFullLog();
+  testCompactionFails();
+  return hostTestDone("tracklog_test");
+}
@@ -0,0 +1,241 @@
+// WifiLink against the modelled access point in stubs/WiFi.h, on the manual
+// clock with a loop() pass every 10 ms: the first boot scans and caches the
+// AP in NVS, later boots go straight to it, an outage is retried at once
+// and then with backoff and jitter, alternating cache and scan once the
+// cache has failed twice, a silent attempt is given up after
+// ATTEMPT_TIMEOUT_MS, and loop() judges an attempt by the events of that
+// attempt only.
+
+#include <Preferences.h>
+#include <WifiLink.h>
+
+#include <set>
+#include <vector>
+
+#include "hosttest.h"
+
+static const uint32_t PASS_MS = 10;
+
+static std::vector<bool> changes;
+static void onChange(bool up) { changes.push_back(up); }
+
+// Fresh driver and clock; NVS is kept unless asked, like a reboot
+static void boot(bool eraseNvs) {
+  WiFi.hostReset();
+  if (eraseNvs) hostNvs().clear();
+  changes.clear();
+  hostSetMillis(1000);
+}
+
+static void pass(WifiLink &link) {
+  WiFi.hostDeliverEvents();
+  link.loop();
+  hostAdvanceMillis(PASS_MS);
+}
+
+// Loop until connected or ms have passed; true if connected
+static bool runUntilUp(WifiLink &link, uint32_t ms) {
+  for (uint32_t start = millis(); millis() - start < ms;) {
+    pass(link);
+    if (link.connected()) return true;
+  }
+  return false;
+}
+
+static void run(WifiLink &link, uint32_t ms) {
+  for (uint32_t start = millis(); millis() - start < ms;) pass(link);
+}
+
+static void testFirstBoot() {
+  boot(true);
+  WifiLink link("home", "secret");
+  uint32_t start = millis();
+  link.begin(onChange);
+  CHECK_EQ(millis(), start);  // doesn't wait for anything
+  CHECK(!WiFi.hostAutoReconnect);
+  CHECK(!WiFi.hostPersistent);
+  CHECK_EQ(WiFi.hostMode, WIFI_STA);
+  CHECK_EQ(link.state(), WIFI_LINK_CONNECTING);
+  CHECK_EQ(WiFi.hostBegins.size(), 1);
+  if (!WiFi.hostBegins.empty()) CHECK(!WiFi.hostBegins[0].cached);
+
+  CHECK(runUntilUp(link, 5000));
+  uint32_t expected = WiFi.hostAp.scanMs + WiFi.hostAp.joinMs;
+  CHECK(link.stats().bootConnectMs >= expected && link.stats().bootConnectMs < expected + PASS_MS);
+  CHECK_EQ(link.stats().fastConnects, 0);
+  CHECK_EQ(link.offlineFor(), 0);
+  CHECK(changes == std::vector<bool>{ true });
+
+  std::map<std::string, std::string> &nvs = hostNvs()[WIFILINK_NVS_NAMESPACE];
+  CHECK(nvs[WIFILINK_NVS_SSID] == "home");
+  CHECK(nvs[WIFILINK_NVS_BSSID] == std::string((const char *)WiFi.hostAp.bssid, 6));
+  CHECK(nvs[WIFILINK_NVS_CHANNEL] == std::string(1, (char)WiFi.hostAp.channel));
+}
+
+// After testFirstBoot: the cached AP is joined without a scan and NVS
+// isn't written again; another SSID doesn't use it
+static void testCachedBoot() {
+  boot(false);
+  uint32_t writes = hostNvsWrites();
+  WifiLink link("home", "secret");
+  link.begin(onChange);
+  CHECK_EQ(WiFi.hostBegins.size(), 1);
+  if (!WiFi.hostBegins.empty()) {
+    CHECK(WiFi.hostBegins[0].cached);
+    CHECK_EQ(WiFi.hostBegins[0].channel, WiFi.hostAp.channel);
+  }
+  CHECK(runUntilUp(link, 5000));
+  CHECK(link.stats().bootConnectMs < WiFi.hostAp.joinMs + PASS_MS);
+  CHECK_EQ(link.stats().fastConnects, 1);
+  CHECK_EQ(hostNvsWrites(), writes);
+
+  boot(false);
+  WiFi.hostAp.ssid = "office";
+  WifiLink other("office", "secret");
+  other.begin(onChange);
+  CHECK_EQ(WiFi.hostBegins.size(), 1);
+  if (!WiFi.hostBegins.empty()) CHECK(!WiFi.hostBegins[0].cached);
+  CHECK(runUntilUp(other, 5000));
+  CHECK_EQ(other.stats().fastConnects, 0);
+}
+
+// Two minutes without the AP, then it comes back
+static void testOutage() {
+  boot(true);
+  WifiLink link("home", "secret");
+  link.begin(onChange);
+  CHECK(runUntilUp(link, 5000));
+  run(link, 1000);
+
+  WiFi.hostBegins.clear();
+  WiFi.hostApDown();
+  pass(link);
+  uint32_t lost = millis() - PASS_MS;
+  CHECK(changes == (std::vector<bool>{ true, false }));
+  CHECK_EQ(link.stats().lastReason, WIFI_REASON_BEACON_TIMEOUT);
+  // The first retry goes out in the same pass
+  CHECK_EQ(WiFi.hostBegins.size(), 1);
+  if (!WiFi.hostBegins.empty()) CHECK_EQ(WiFi.hostBegins[0].at, lost);
+
+  // Each wait is half the backoff fixed and half random, the backoff
+  // doubling from BACKOFF_MIN_MS up to BACKOFF_MAX_MS
+  std::vector<uint32_t> failedAt;
+  uint32_t failures = link.stats().failures;
+  while (millis() - lost < 120000) {
+    pass(link);
+    if (link.stats().failures != failures) {
+      failures = link.stats().failures;
+      failedAt.push_back(millis() - PASS_MS);
+    }
+  }
+  CHECK(failedAt.size() >= 10);
+  CHECK_EQ(WiFi.hostBegins.size(), failedAt.size() + (link.state() == WIFI_LINK_CONNECTING));
+  uint32_t backoff = WifiLink::BACKOFF_MIN_MS;
+  bool inRange = true;
+  std::set<uint32_t> cappedWaits;
+  for (size_t i = 0; i + 1 < WiFi.hostBegins.size() && i < failedAt.size(); i++) {
+    uint32_t wait = WiFi.hostBegins[i + 1].at - failedAt[i];
+    // The loop notices the wait is over on the next pass
+    inRange &= wait >= backoff / 2 && wait <= backoff + PASS_MS;
+    if (backoff == WifiLink::BACKOFF_MAX_MS) cappedWaits.insert(wait);
+    backoff = min(backoff * 2, WifiLink::BACKOFF_MAX_MS);
+  }
+  CHECK(inRange);
+  CHECK(cappedWaits.size() > 3);  // jittered, not lockstep
+
+  // Cache for the first FAST_FAILS_MAX attempts, then cache and scan in turn
+  std::string pattern;
+  for (size_t i = 0; i < 8 && i < WiFi.hostBegins.size(); i++) pattern += WiFi.hostBegins[i].cached ? 'C' : 'S';
+  CHECK(pattern == "CCCSCSCS");
+  CHECK_EQ(link.stats().lastReason, WIFI_REASON_NO_AP_FOUND);
+  CHECK(link.offlineFor() >= 120000);
+
+  WiFi.hostApUp();
+  CHECK(runUntilUp(link, WifiLink::BACKOFF_MAX_MS + WiFi.hostAp.scanMs + WiFi.hostAp.joinMs + 2 * PASS_MS));
+  uint32_t up = millis() - PASS_MS;
+  CHECK_EQ(link.stats().lastOfflineMs, up - lost);
+  CHECK_EQ(link.stats().offlineMs, link.stats().bootConnectMs + (up - lost));  // boot counts as offline too
+  CHECK(changes == (std::vector<bool>{ true, false, true }));
+
+  // The backoff starts over: a blip is one immediate, cached attempt
+  failures = link.stats().failures;
+  WiFi.hostApDown();
+  WiFi.hostApUp();
+  uint32_t blip = millis();
+  CHECK(runUntilUp(link, 5000));
+  CHECK(millis() - blip <= WiFi.hostAp.joinMs + 2 * PASS_MS);
+  CHECK_EQ(link.stats().failures, failures);
+}
+
+// An attempt nobody answers is dropped after ATTEMPT_TIMEOUT_MS. Dropping
+// it raises a disconnect event of its own, which arrives while waiting and
+// must not count against the next attempt.
+static void testAttemptTimeout() {
+  boot(true);
+  WiFi.hostAp.silent = true;
+  WifiLink link("home", "secret");
+  link.begin(onChange);
+  uint32_t start = millis();
+  while (link.state() == WIFI_LINK_CONNECTING && millis() - start < 20000) pass(link);
+  uint32_t gaveUp = millis() - PASS_MS - start;
+  CHECK(gaveUp >= WifiLink::ATTEMPT_TIMEOUT_MS && gaveUp < WifiLink::ATTEMPT_TIMEOUT_MS + PASS_MS);
+  CHECK_EQ(link.stats().failures, 1);
+  CHECK_EQ(WiFi.hostDisconnects, 1);
+  CHECK_EQ(link.state(), WIFI_LINK_WAITING);
+
+  WiFi.hostAp.silent = false;
+  CHECK(runUntilUp(link, 10000));
+  CHECK_EQ(link.stats().failures, 1);
+  CHECK_EQ(link.stats().lastReason, WIFI_REASON_ASSOC_LEAVE);
+  CHECK(changes == std::vector<bool>{ true });
+}
+
+// loop() takes one snapshot of what the event task recorded since the last
+// pass; whatever happened in between, it acts on where things ended up
+static void testEventSnapshot() {
+  boot(true);
+  WifiLink link("home", "secret");
+  link.begin(onChange);
+
+  // Got an IP and lost the AP again before loop() ran: a failed attempt
+  hostAdvanceMillis(WiFi.hostAp.scanMs + WiFi.hostAp.joinMs);
+  WiFi.hostDeliverEvents();
+  WiFi.hostApDown();
+  WiFi.hostApUp();
+  pass(link);
+  CHECK_EQ(link.stats().connects, 0);
+  CHECK_EQ(link.stats().failures, 1);
+  CHECK(changes.empty());
+
+  // Connected, then the lease goes: down, and straight back up
+  CHECK(runUntilUp(link, 10000));
+  WiFi.hostLoseIp();
+  pass(link);
+  CHECK(changes == (std::vector<bool>{ true, false }));
+  CHECK_EQ(link.state(), WIFI_LINK_CONNECTING);
+  CHECK(runUntilUp(link, 5000));
+  CHECK_EQ(link.stats().connects, 2);
+
+  // Down on purpose: no attempts until reconnect(), which goes at once
+  size_t begins = WiFi.hostBegins.size();
+  link.disconnect();
+  CHECK_EQ(link.state(), WIFI_LINK_IDLE);
+  CHECK(changes == (std::vector<bool>{ true, false, true, false }));
+  run(link, 60000);
+  CHECK_EQ(WiFi.hostBegins.size(), begins);
+  CHECK(link.offlineFor() >= 60000);
+  link.reconnect();
+  CHECK_EQ(WiFi.hostBegins.size(), begins + 1);
+  CHECK(runUntilUp(link, 5000));
+  CHECK(link.stats().lastOfflineMs >= 60000);
+}
+
+int main() {
+  hostSerialQuiet = true;
+  testFirstBoot();
+  testCachedBoot();
+  testOutage();
+  testAttemptTimeout();
+  testEventSnapshot();
+  return hostTestDone("wifilink_test");
+}
@@ -0,0 +1,1023 @@
+// Host-side load generator for the Django API, with a local stand-in server.
+//
+// Emulates many controllers posting exactly what the firmware posts:
+//   smarthome  sensor batches to /api/sensor-data/ (SensorBuffer + SensorAggregator
+//              records, device_id = MAC) and RFID/keypad checks to /api/check-auth/
+//   web        sensor batches without device_id
+//   tracker    GPS batches to /api/gps-data/ (formatTrackPoint in esp32/include/TrackReporter.h)
+// Each emulated device owns one keep-alive connection and sends its requests
+// one at a time, like the DjangoLink on the board, so a slow server shows up
+// as requests starting late ("lag") as well as in latency.
+//
+// Build (Linux or macOS):
+//   g++ -std=c++11 -O2 -pthread -o loadgen loadgen.cpp
+//
+// Usage:
+//   loadgen serve [--port 8000] [server options]
+//   loadgen run   --target HOST:PORT [load options]
+//   loadgen bench [load options] [server options]   stand-in on a free local port
+//
+// Load options:
+//   --smarthome N      smarthome controllers (default 10)
+//   --web N            web sensor nodes (default 0)
+//   --trackers N       GPS trackers (default 0)
+//   --duration S       seconds to run (default 30)
+//   --speedup X        divide every firmware interval by X (default 1)
+//   --sensor-every S   mean seconds between sensor records (default 150, the aggregator window)
+//   --tap-every S      mean seconds between card/PIN checks per smarthome (default 120)
+//   --gps-every S      mean seconds between GPS batches (default 60, maxBatchAgeMs)
+// Server options:
+//   --latency-ms MS    fixed service time (default 5)
+//   --jitter-ms MS     plus an exponential delay with this mean (default 5)
+//   --error-rate P     fraction answered 500 (default 0)
+//   --drop-rate P      fraction where the connection is closed without a reply
+//   --stall-rate P     fraction answered only after --stall-ms (default 10000)
+//
+// Transport (load and server):
+//   --transport T      http (default) or mqtt. With mqtt each device keeps one
+//                      broker session like MqttLink: every request is
+//                      published on home/<id>/req/<name>/<n> and waits for
+//                      reply/<n>/<status>, republished every second until
+//                      it comes. The stand-in is then a minimal MQTT 3.1.1
+//                      broker with the backend built in; replies get the
+//                      service time. QoS 0 publishes on up/<name> are
+//                      consumed without a reply.
+//
+// Intervals are exponential around their mean, so N devices form a Poisson
+// load. Latency is measured from the first byte sent to the last byte of the
+// response; timeouts match the firmware (auth 4 s, sensor 8 s, GPS 5 s).
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char SENSOR_PATH[] = "/api/sensor-data/";
+static const char AUTH_PATH[] = "/api/check-auth/";
+static const char GPS_PATH[] = "/api/gps-data/";
+
+enum Endpoint { EP_SENSOR, EP_AUTH, EP_GPS, EP_COUNT };
+static const char *const ENDPOINT_NAMES[EP_COUNT] = { "sensor-data", "check-auth", "gps-data" };
+static const char *const ENDPOINT_PATHS[EP_COUNT] = { SENSOR_PATH, AUTH_PATH, GPS_PATH };
+static const int ENDPOINT_TIMEOUT_MS[EP_COUNT] = { 8000, 4000, 5000 };
+
+struct Options {
+  // load
+  std::string host = "127.0.0.1";
+  int port = 8000;
+  int smarthome = 10;
+  int web = 0;
+  int trackers = 0;
+  double duration = 30;
+  double speedup = 1;
+  double sensorEvery = 150;
+  double tapEvery = 120;
+  double gpsEvery = 60;
+  // server
+  double latencyMs = 5;
+  double jitterMs = 5;
+  double errorRate = 0;
+  double dropRate = 0;
+  double stallRate = 0;
+  double stallMs = 10000;
+  bool mqtt = false;
+};
+
+// ---------------------------------------------------------------------------
+// Statistics
+
+struct EndpointStats {
+  std::mutex lock;
+  uint64_t sent = 0, ok = 0, httpErrors = 0, netErrors = 0, bytes = 0;
+  std::vector<uint32_t> latencyUs;
+  std::vector<uint32_t> lagUs;  // how late the request started vs its schedule
+
+  void record(int code, uint32_t latency, uint32_t lag, size_t len) {
+    std::lock_guard<std::mutex> g(lock);
+    sent++;
+    bytes += len;
+    if (code >= 200 && code < 300) ok++;
+    else if (code > 0) httpErrors++;
+    else netErrors++;
+    if (code > 0) latencyUs.push_back(latency);
+    lagUs.push_back(lag);
+  }
+};
+
+static EndpointStats stats[EP_COUNT];
+
+static double percentileMs(std::vector<uint32_t> &v, double p) {
+  if (v.empty()) return 0;
+  size_t rank = (size_t)std::ceil(p * v.size());
+  if (rank) rank--;
+  std::nth_element(v.begin(), v.begin() + rank, v.end());
+  return v[rank] / 1000.0;
+}
+
+// ---------------------------------------------------------------------------
+// HTTP client, one keep-alive socket like DjangoLink
+
+static int connectTo(const std::string &host, int port, int timeoutMs) {
+  char portStr[8];
+  snprintf(portStr, sizeof(portStr), "%d", port);
+  addrinfo hints = {}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), portStr, &hints, &res) != 0) return -1;
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd >= 0) {
+    timeval tv = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+static bool sendAll(int fd, const std::string &data) {
+  size_t off = 0;
+  while (off < data.size()) {
+    ssize_t n = send(fd, data.data() + off, data.size() - off, 0);  // SIGPIPE is ignored
+    if (n <= 0) return false;
+    off += n;
+  }
+  return true;
+}
+
+// What a device talks to the backend through, like Transport in the firmware
+class ApiConnection {
+public:
+  // Negative results, like HTTPClient's error codes
+  static const int ERR_CONNECT = -1;
+  static const int ERR_SEND = -2;
+  static const int ERR_READ = -3;     // connection lost
+  static const int ERR_TIMEOUT = -4;
+
+  virtual ~ApiConnection() {}
+  virtual int post(const char *path, const std::string &body, int timeoutMs, std::string &response) = 0;
+};
+
+class HttpConnection : public ApiConnection {
+public:
+  HttpConnection(const std::string &host, int port) : host(host), port(port) {}
+  ~HttpConnection() { drop(); }
+
+  // POST body, return the status code or an error. Resends once on a fresh
+  // socket when a reused one turns out to be closed before any reply, but
+  // never after a timeout, like DjangoLink::post().
+  int post(const char *path, const std::string &body, int timeoutMs, std::string &response) override {
+    bool reusing = fd >= 0;
+    bool replied = false;
+    int code = attempt(path, body, timeoutMs, response, replied);
+    if ((code == ERR_SEND || code == ERR_READ) && reusing && !replied) {
+      code = attempt(path, body, timeoutMs, response, replied);
+    }
+    return code;
+  }
+
+private:
+  std::string host;
+  int port;
+  int fd = -1;
+  std::string pending;  // bytes read past the previous response
+  bool timedOut = false;
+
+  void drop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    pending.clear();
+  }
+
+  int attempt(const char *path, const std::string &body, int timeoutMs, std::string &response, bool &replied) {
+    if (fd < 0) {
+      fd = connectTo(host, port, timeoutMs);
+      if (fd < 0) return ERR_CONNECT;
+    }
+    char head[512];
+    snprintf(head, sizeof(head),
+             "POST %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: ESP32HTTPClient\r\nConnection: keep-alive\r\n"
+             "Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\nContent-Type: application/json\r\n"
+             "Content-Length: %zu\r\n\r\n",
+             path, host.c_str(), port, body.size());
+    if (!sendAll(fd, std::string(head) + body)) {
+      drop();
+      return ERR_SEND;
+    }
+
+    std::string &buf = pending;
+    size_t headerEnd;
+    while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+      if (!readMore(buf)) {
+        replied = !buf.empty();
+        drop();
+        return timedOut ? ERR_TIMEOUT : ERR_READ;
+      }
+    }
+    replied = true;
+    int code = 0;
+    if (sscanf(buf.c_str(), "HTTP/1.%*d %d", &code) != 1) {
+      drop();
+      return ERR_READ;
+    }
+    std::string headers = buf.substr(0, headerEnd);
+    for (char &c : headers) c = tolower(c);
+    size_t contentLength = 0;
+    size_t cl = headers.find("content-length:");
+    if (cl != std::string::npos) contentLength = strtoul(headers.c_str() + cl + 15, nullptr, 10);
+    bool closeAfter = headers.find("connection: close") != std::string::npos;
+
+    while (buf.size() < headerEnd + 4 + contentLength) {
+      if (!readMore(buf)) {
+        drop();
+        return timedOut ? ERR_TIMEOUT : ERR_READ;
+      }
+    }
+    response = buf.substr(headerEnd + 4, contentLength);
+    buf.erase(0, headerEnd + 4 + contentLength);
+    if (closeAfter) drop();
+    return code;
+  }
+
+  bool readMore(std::string &buf) {
+    char chunk[4096];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    timedOut = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    if (n <= 0) return false;
+    buf.append(chunk, n);
+    return true;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// MQTT 3.1.1 framing, shared by the client and the stand-in broker
+
+enum MqttType { MQTT_CONNECT = 1, MQTT_CONNACK = 2, MQTT_PUBLISH = 3, MQTT_PUBACK = 4, MQTT_SUBSCRIBE = 8,
+                MQTT_SUBACK = 9, MQTT_PINGREQ = 12, MQTT_PINGRESP = 13, MQTT_DISCONNECT = 14 };
+
+static void putString(std::string &out, const std::string &s) {
+  out += (char)(s.size() >> 8);
+  out += (char)(s.size() & 0xFF);
+  out += s;
+}
+
+static std::string mqttPacket(uint8_t header, const std::string &body) {
+  std::string p(1, (char)header);
+  size_t n = body.size();
+  do {
+    uint8_t b = n % 128;
+    n /= 128;
+    if (n) b |= 0x80;
+    p += (char)b;
+  } while (n);
+  return p + body;
+}
+
+static std::string mqttPublish(const std::string &topic, const std::string &payload, int qos = 0,
+                               uint16_t packetId = 0, bool retain = false) {
+  std::string body;
+  putString(body, topic);
+  if (qos) {
+    body += (char)(packetId >> 8);
+    body += (char)(packetId & 0xFF);
+  }
+  return mqttPacket((MQTT_PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0), body + payload);
+}
+
+static std::string mqttAck(uint8_t type, const std::string &packetId) {
+  return mqttPacket(type << 4, packetId);
+}
+
+struct MqttMessage {
+  std::string topic;
+  std::string packetId;  // two bytes, empty at QoS 0
+  std::string payload;
+};
+
+static bool parsePublish(uint8_t header, const std::string &body, MqttMessage &msg) {
+  if (body.size() < 2) return false;
+  size_t len = (uint8_t)body[0] << 8 | (uint8_t)body[1];
+  size_t pos = 2 + len;
+  if (((header >> 1) & 3) != 0) pos += 2;
+  if (pos > body.size()) return false;
+  msg.topic = body.substr(2, len);
+  msg.packetId = body.substr(2 + len, pos - 2 - len);
+  msg.payload = body.substr(pos);
+  return true;
+}
+
+// One packet from fd; buf keeps whatever was read past it. Returns 1, 0 when
+// the connection is gone or the stream is garbage, -1 on a receive timeout.
+static int readPacket(int fd, std::string &buf, uint8_t &header, std::string &body) {
+  for (;;) {
+    size_t len = 0, i = 1;
+    bool complete = false;
+    for (int shift = 0; i < buf.size() && i <= 4; shift += 7) {
+      uint8_t b = buf[i++];
+      len |= (size_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (complete && buf.size() >= i + len) {
+      header = buf[0];
+      body = buf.substr(i, len);
+      buf.erase(0, i + len);
+      return 1;
+    }
+    if (!complete && i > 4) return 0;
+
+    char chunk[4096];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return -1;
+    if (n <= 0) return 0;
+    buf.append(chunk, n);
+  }
+}
+
+static void setRecvTimeout(int fd, int ms) {
+  timeval tv = { ms / 1000, (ms % 1000) * 1000 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// "/api/check-auth/" -> "check-auth", as in MqttLink::topicName()
+static std::string topicName(const char *path) {
+  std::string name = path;
+  if (name.compare(0, 5, "/api/") == 0) name.erase(0, 5);
+  if (!name.empty() && name.back() == '/') name.pop_back();
+  return name;
+}
+
+// ---------------------------------------------------------------------------
+// MQTT client, one persistent session like MqttLink
+
+class MqttConnection : public ApiConnection {
+public:
+  static const int RETRY_MS = 1000;  // MqttLink::RETRY_MS
+
+  MqttConnection(const std::string &host, int port, const std::string &clientId)
+      : host(host), port(port), clientId(clientId), prefix("home/" + clientId) {}
+  ~MqttConnection() { drop(); }
+
+  int post(const char *path, const std::string &body, int timeoutMs, std::string &response) override {
+    if (fd < 0 && !open(timeoutMs)) return ERR_CONNECT;
+    std::string name = topicName(path);
+    response.clear();
+
+    if (name.compare(0, 9, "cmd-reply") == 0) {
+      if (!sendAll(fd, mqttPublish(prefix + "/up/" + name, body))) {
+        drop();
+        return ERR_SEND;
+      }
+      return 202;
+    }
+
+    unsigned id = nextId++;
+    std::string packet = mqttPublish(prefix + "/req/" + name + "/" + std::to_string(id), body);
+    std::string replyTopic = prefix + "/reply/" + std::to_string(id) + "/";
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    Clock::time_point resendAt = Clock::now();
+    for (;;) {
+      Clock::time_point now = Clock::now();
+      if (now >= deadline) return ERR_TIMEOUT;
+      if (now >= resendAt) {
+        if (!sendAll(fd, packet)) {
+          drop();
+          return ERR_SEND;
+        }
+        resendAt = now + std::chrono::milliseconds(RETRY_MS);
+      }
+      Clock::time_point wake = std::min(deadline, resendAt);
+      int waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count();
+      setRecvTimeout(fd, waitMs > 0 ? waitMs : 1);
+
+      uint8_t header;
+      std::string in;
+      int r = readPacket(fd, pending, header, in);
+      if (r < 0) continue;
+      if (r == 0) {
+        drop();
+        return ERR_READ;
+      }
+      MqttMessage msg;
+      if ((header >> 4) != MQTT_PUBLISH || !parsePublish(header, in, msg)) continue;
+      if (!msg.packetId.empty()) sendAll(fd, mqttAck(MQTT_PUBACK, msg.packetId));
+      if (msg.topic.compare(0, replyTopic.size(), replyTopic) != 0) continue;  // late reply or a command
+      response = msg.payload;
+      return atoi(msg.topic.c_str() + replyTopic.size());
+    }
+  }
+
+private:
+  std::string host;
+  int port;
+  std::string clientId, prefix;
+  int fd = -1;
+  std::string pending;
+  unsigned nextId = 1;
+
+  void drop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    pending.clear();
+  }
+
+  // CONNECT with a persistent session and a retained "offline" will, then
+  // the same subscriptions and "online" status as MqttLink::ensureConnected()
+  bool open(int timeoutMs) {
+    fd = connectTo(host, port, timeoutMs);
+    if (fd < 0) return false;
+    std::string body;
+    putString(body, "MQTT");
+    body += (char)4;     // protocol level 3.1.1
+    body += (char)0x2C;  // will retain, will QoS 1, will flag; clean session off
+    body += (char)0;
+    body += (char)30;    // keep-alive seconds
+    putString(body, clientId);
+    putString(body, prefix + "/status");
+    putString(body, "offline");
+
+    std::string sub("\x00\x01", 2);
+    putString(sub, prefix + "/cmd/+");
+    sub += (char)1;
+    putString(sub, prefix + "/reply/#");
+    sub += (char)1;
+
+    uint8_t header;
+    std::string in;
+    if (!sendAll(fd, mqttPacket(MQTT_CONNECT << 4, body)) || readPacket(fd, pending, header, in) != 1 ||
+        (header >> 4) != MQTT_CONNACK || in.size() < 2 || in[1] != 0 ||
+        !sendAll(fd, mqttPacket(MQTT_SUBSCRIBE << 4 | 2, sub)) || readPacket(fd, pending, header, in) != 1 ||
+        (header >> 4) != MQTT_SUBACK || !sendAll(fd, mqttPublish(prefix + "/status", "online", 0, 0, true))) {
+      drop();
+      return false;
+    }
+    return true;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Payloads, formatted like the firmware
+
+static void formatTimestamp(char *out, size_t len, time_t t) {
+  tm parts;
+  gmtime_r(&t, &parts);
+  strftime(out, len, "%Y-%m-%d %H:%M:%S", &parts);
+}
+
+// One SensorAggregator record as SensorBuffer::formatSample() writes it
+static std::string sensorRecord(float temp, float hum, const char *deviceId, std::mt19937 &rng) {
+  std::uniform_int_distribution<int> count(1, 75);
+  int n = count(rng);
+  char ts[32], buf[320];
+  formatTimestamp(ts, sizeof(ts), time(nullptr));
+  int len = snprintf(buf, sizeof(buf), "{\"temperature\":%.1f,\"humidity\":%.1f", temp, hum);
+  if (deviceId) len += snprintf(buf + len, sizeof(buf) - len, ",\"device_id\":\"%s\"", deviceId);
+  len += snprintf(buf + len, sizeof(buf) - len,
+                  ",\"timestamp\":\"%s\",\"window\":{\"n\":%d,\"t_min\":%.1f,\"t_max\":%.1f,\"t_mean\":%.1f,"
+                  "\"h_min\":%.1f,\"h_max\":%.1f,\"h_mean\":%.1f}}",
+                  ts, n, temp - 1, temp + 1, temp, hum - 2, hum + 2, hum);
+  return std::string(buf, len);
+}
+
+// ArduinoJson keeps insertion order and adds no whitespace
+static std::string authBody(const char *type, const std::string &value, const char *mac) {
+  return std::string("{\"type\":\"") + type + "\",\"value\":\"" + value + "\",\"device_id\":\"" + mac + "\"}";
+}
+
+static std::string gpsPoint(const char *deviceId, double lat, double lon, float speed, float alt, time_t t) {
+  tm p;
+  gmtime_r(&t, &p);
+  char buf[200];
+  int n = snprintf(buf, sizeof(buf),
+                   "{\"device_id\":\"%s\",\"timestamp\":\"%04u-%02u-%02u %02u:%02u:%02u\","
+                   "\"latitude\":%.6f,\"longitude\":%.6f,\"speed\":%.2f,\"altitude\":%.2f}",
+                   deviceId, p.tm_year + 1900, p.tm_mon + 1, p.tm_mday, p.tm_hour, p.tm_min, p.tm_sec, lat, lon,
+                   speed, alt);
+  return std::string(buf, n);
+}
+
+// ---------------------------------------------------------------------------
+// Emulated devices
+
+enum DeviceKind { DEV_SMARTHOME, DEV_WEB, DEV_TRACKER };
+
+static std::atomic<bool> stopping(false);
+
+struct Stream {
+  Endpoint endpoint;
+  double meanS;
+  Clock::time_point due;
+};
+
+static void runDevice(const Options &opt, DeviceKind kind, int index, Clock::time_point end) {
+  std::mt19937 rng(1000 + index * 7 + kind);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  char mac[18], trackerId[24], clientId[24];
+  snprintf(mac, sizeof(mac), "24:0A:C4:%02X:%02X:%02X", kind, (index >> 8) & 0xFF, index & 0xFF);
+  snprintf(trackerId, sizeof(trackerId), "esp32_%03d", index + 1);
+  static const char *const KIND_NAMES[] = { "smarthome", "web" };
+  if (kind == DEV_TRACKER) snprintf(clientId, sizeof(clientId), "%s", trackerId);
+  else snprintf(clientId, sizeof(clientId), "%s_%03d", KIND_NAMES[kind], index + 1);
+
+  std::unique_ptr<ApiConnection> conn;
+  if (opt.mqtt) conn.reset(new MqttConnection(opt.host, opt.port, clientId));
+  else conn.reset(new HttpConnection(opt.host, opt.port));
+
+  std::vector<Stream> streams;
+  if (kind == DEV_SMARTHOME || kind == DEV_WEB) streams.push_back({ EP_SENSOR, opt.sensorEvery, Clock::now() });
+  if (kind == DEV_SMARTHOME) streams.push_back({ EP_AUTH, opt.tapEvery, Clock::now() });
+  if (kind == DEV_TRACKER) streams.push_back({ EP_GPS, opt.gpsEvery, Clock::now() });
+
+  auto nextDelay = [&](double meanS) {
+    double s = -std::log(1 - unit(rng)) * meanS / opt.speedup;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(s));
+  };
+  // Spread the first requests so devices don't start in lockstep
+  for (Stream &s : streams) s.due += nextDelay(s.meanS);
+
+  float temp = 20 + unit(rng) * 5, hum = 45 + unit(rng) * 10;
+  double lat = -6.8 + unit(rng) * 0.1, lon = 39.2 + unit(rng) * 0.1;
+  std::string response;
+
+  while (!stopping) {
+    Stream *next = &streams[0];
+    for (Stream &s : streams) {
+      if (s.due < next->due) next = &s;
+    }
+    if (next->due >= end) break;
+    std::this_thread::sleep_until(next->due);
+    if (stopping) break;
+
+    std::string body;
+    switch (next->endpoint) {
+      case EP_SENSOR:
+        temp += (unit(rng) - 0.5f);
+        hum += (unit(rng) - 0.5f) * 3;
+        body = "[" + sensorRecord(temp, hum, kind == DEV_SMARTHOME ? mac : nullptr, rng) + "]";
+        break;
+      case EP_AUTH:
+        if (unit(rng) < 0.7) {
+          char uid[9];
+          snprintf(uid, sizeof(uid), "%08x", (unsigned)rng());
+          body = authBody("rfid", uid, mac);
+        } else {
+          char pin[5];
+          snprintf(pin, sizeof(pin), "%04u", (unsigned)(rng() % 10000));
+          body = authBody("keypad", pin, mac);
+        }
+        break;
+      case EP_GPS: {
+        int points = 1 + rng() % 12;
+        time_t now = time(nullptr);
+        body = "[";
+        for (int i = 0; i < points; i++) {
+          lat += (unit(rng) - 0.5) * 0.0005;
+          lon += (unit(rng) - 0.5) * 0.0005;
+          if (i) body += ",";
+          body += gpsPoint(trackerId, lat, lon, unit(rng) * 60, 20 + unit(rng) * 5, now - (points - i) * 5);
+        }
+        body += "]";
+        break;
+      }
+      default:
+        break;
+    }
+
+    Clock::time_point start = Clock::now();
+    uint32_t lag = std::chrono::duration_cast<std::chrono::microseconds>(start - next->due).count();
+    int code = conn->post(ENDPOINT_PATHS[next->endpoint], body, ENDPOINT_TIMEOUT_MS[next->endpoint], response);
+    uint32_t latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    stats[next->endpoint].record(code, latency, lag, body.size());
+
+    // Like the firmware, the next request is scheduled from its due time,
+    // so a slow server builds a backlog rather than lowering the rate
+    next->due += nextDelay(next->meanS);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in server
+
+struct ServerStats {
+  std::atomic<uint64_t> requests[EP_COUNT];
+  std::atomic<uint64_t> records[EP_COUNT];
+  std::atomic<uint64_t> errors, drops, stalls, badRequests;
+  std::atomic<uint64_t> resent;  // MQTT requests published again before their reply
+};
+
+static ServerStats serverStats;
+
+// Objects at the top level of a JSON array, or 1 for a single object
+static int countRecords(const std::string &body) {
+  if (body.empty() || body[0] != '[') return body.empty() ? 0 : 1;
+  int depth = 0, n = 0;
+  bool inString = false;
+  for (size_t i = 0; i < body.size(); i++) {
+    char c = body[i];
+    if (inString) {
+      if (c == '\\') i++;
+      else if (c == '"') inString = false;
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      if (depth++ == 1 && c == '{') n++;
+    } else if (c == '}' || c == ']') {
+      depth--;
+    }
+  }
+  return n;
+}
+
+// Sleeps for the service time plus any injected stall; false means the
+// connection should be dropped without a reply
+static bool serviceDelay(const Options &opt, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::exponential_distribution<double> jitter(opt.jitterMs > 0 ? 1.0 / opt.jitterMs : 1.0);
+  double delayMs = opt.latencyMs + (opt.jitterMs > 0 ? jitter(rng) : 0);
+  double roll = unit(rng);
+  if (roll < opt.dropRate) {
+    serverStats.drops++;
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delayMs));
+    return false;
+  }
+  roll -= opt.dropRate;
+  if (roll < opt.stallRate) {
+    serverStats.stalls++;
+    delayMs += opt.stallMs;
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delayMs));
+  return true;
+}
+
+// Status and body Django would answer for endpoint ep (-1: no such path)
+static int answer(int ep, const std::string &body, const Options &opt, std::mt19937 &rng, std::string &reply) {
+  std::uniform_real_distribution<double> unit(0, 1);
+  if (ep < 0) {
+    serverStats.badRequests++;
+    reply = "{\"detail\":\"Not found.\"}";
+    return 404;
+  }
+  if (unit(rng) < opt.errorRate) {
+    serverStats.errors++;
+    reply = "{\"detail\":\"Injected error\"}";
+    return 500;
+  }
+  serverStats.requests[ep]++;
+  serverStats.records[ep] += countRecords(body);
+  if (ep == EP_AUTH) {
+    reply = body.find("\"value\":\"1234\"") != std::string::npos || unit(rng) < 0.8 ? "{\"status\":\"GRANTED\"}"
+                                                                                   : "{\"status\":\"DENIED\"}";
+    return 200;
+  }
+  reply = "{\"status\":\"success\"}";
+  return 201;
+}
+
+static int endpointByName(const std::string &name) {
+  for (int i = 0; i < EP_COUNT; i++) {
+    if (name == ENDPOINT_NAMES[i]) return i;
+  }
+  return -1;
+}
+
+static void serveConnection(int fd, Options opt, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string buf;
+  char chunk[4096];
+
+  while (!stopping) {
+    size_t headerEnd;
+    while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      buf.append(chunk, n);
+    }
+    std::string headers = buf.substr(0, headerEnd);
+    char method[8] = "", path[128] = "";
+    sscanf(headers.c_str(), "%7s %127s", method, path);
+    for (char &c : headers) c = tolower(c);
+    size_t contentLength = 0;
+    size_t cl = headers.find("content-length:");
+    if (cl != std::string::npos) contentLength = strtoul(headers.c_str() + cl + 15, nullptr, 10);
+    while (buf.size() < headerEnd + 4 + contentLength) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      buf.append(chunk, n);
+    }
+    std::string body = buf.substr(headerEnd + 4, contentLength);
+    buf.erase(0, headerEnd + 4 + contentLength);
+
+    int ep = -1;
+    for (int i = 0; i < EP_COUNT; i++) {
+      if (strcmp(path, ENDPOINT_PATHS[i]) == 0) ep = i;
+    }
+    if (strcmp(method, "POST") != 0) ep = -1;
+
+    if (!serviceDelay(opt, rng)) {
+      close(fd);
+      return;
+    }
+    std::string reply;
+    int code = answer(ep, body, opt, rng, reply);
+
+    char head[160];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+             "Connection: keep-alive\r\n\r\n",
+             code, code < 300 ? "OK" : code == 404 ? "Not Found" : "Internal Server Error", reply.size());
+    if (!sendAll(fd, std::string(head) + reply)) {
+      close(fd);
+      return;
+    }
+  }
+  close(fd);
+}
+
+// One device session on the stand-in broker. Only what MqttLink uses is
+// implemented: a single client per connection, its own topics, QoS 0/1.
+static void serveMqttConnection(int fd, Options opt, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string buf, prefix, body;
+  struct Answer {
+    unsigned id;
+    int code;
+    std::string reply;
+  };
+  std::deque<Answer> answered;  // recent replies, for requests published again
+  uint16_t nextPacketId = 1;
+  uint8_t header;
+
+  while (!stopping && readPacket(fd, buf, header, body) == 1) {
+    std::string out;
+    switch (header >> 4) {
+      case MQTT_CONNECT: {
+        // protocol name (6), level, flags, keep-alive, then the client id
+        if (body.size() < 12) break;
+        size_t len = (uint8_t)body[10] << 8 | (uint8_t)body[11];
+        prefix = "home/" + body.substr(12, len) + "/";
+        out = mqttPacket(MQTT_CONNACK << 4, std::string("\x00\x00", 2));
+        break;
+      }
+      case MQTT_SUBSCRIBE: {
+        // Grant QoS 1 to every filter
+        std::string ack = body.substr(0, 2);
+        for (size_t pos = 2; pos + 2 <= body.size();) {
+          pos += 2 + ((uint8_t)body[pos] << 8 | (uint8_t)body[pos + 1]) + 1;
+          ack += (char)1;
+        }
+        out = mqttPacket(MQTT_SUBACK << 4, ack);
+        break;
+      }
+      case MQTT_PINGREQ:
+        out = mqttPacket(MQTT_PINGRESP << 4, "");
+        break;
+      case MQTT_DISCONNECT:
+        close(fd);
+        return;
+      case MQTT_PUBLISH: {
+        MqttMessage msg;
+        if (!parsePublish(header, body, msg)) break;
+        if (!msg.packetId.empty()) out = mqttAck(MQTT_PUBACK, msg.packetId);
+        if (msg.topic.compare(0, prefix.size(), prefix) != 0) break;
+        std::string rest = msg.topic.substr(prefix.size());
+
+        // up/<name>: goes to the backend's consumer, nobody waits
+        if (rest.compare(0, 3, "up/") == 0) {
+          std::string reply;
+          answer(endpointByName(rest.substr(3)), msg.payload, opt, rng, reply);
+          break;
+        }
+        // req/<name>/<id>: answered on reply/<id>/<status>
+        size_t slash = rest.rfind('/');
+        if (rest.compare(0, 4, "req/") != 0 || slash < 4) break;
+        unsigned id = strtoul(rest.c_str() + slash + 1, nullptr, 10);
+        auto seen = std::find_if(answered.begin(), answered.end(), [id](const Answer &a) { return a.id == id; });
+        Answer a;
+        if (seen != answered.end()) {
+          // Same id again: the reply was lost or slow, send it again as is
+          serverStats.resent++;
+          a = *seen;
+        } else {
+          if (!sendAll(fd, out) || !serviceDelay(opt, rng)) {
+            close(fd);
+            return;
+          }
+          out.clear();
+          a.id = id;
+          a.code = answer(endpointByName(rest.substr(4, slash - 4)), msg.payload, opt, rng, a.reply);
+          answered.push_back(a);
+          if (answered.size() > 16) answered.pop_front();
+        }
+        out += mqttPublish(prefix + "reply/" + std::to_string(id) + "/" + std::to_string(a.code), a.reply, 1,
+                           nextPacketId++);
+        if (!nextPacketId) nextPacketId = 1;
+        break;
+      }
+      default:
+        break;  // PUBACKs for our replies
+    }
+    if (!out.empty() && !sendAll(fd, out)) break;
+  }
+  close(fd);
+}
+
+// Listens on port (0 picks a free one); returns the bound port or -1
+static int startServer(const Options &opt, int port, std::thread &acceptor) {
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if (lfd < 0) return -1;
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(lfd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 1024) != 0) {
+    close(lfd);
+    return -1;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(lfd, (sockaddr *)&addr, &len);
+
+  acceptor = std::thread([lfd, opt]() {
+    unsigned seed = 1;
+    while (!stopping) {
+      int fd = accept(lfd, nullptr, nullptr);
+      if (fd < 0) continue;
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      std::thread(opt.mqtt ? serveMqttConnection : serveConnection, fd, opt, seed++).detach();
+    }
+    close(lfd);
+  });
+  return ntohs(addr.sin_port);
+}
+
+// ---------------------------------------------------------------------------
+
+static void report(double seconds) {
+  printf("\n%-12s %8s %8s %8s %8s %8s %8s %8s %8s %8s %9s\n", "endpoint", "sent", "ok", "http_err", "net_err",
+         "req/s", "p50_ms", "p99_ms", "p999_ms", "max_ms", "lag99_ms");
+  uint64_t sent = 0, ok = 0;
+  std::vector<uint32_t> all;
+  for (int i = 0; i < EP_COUNT; i++) {
+    EndpointStats &s = stats[i];
+    if (!s.sent) continue;
+    double maxMs = s.latencyUs.empty() ? 0 : *std::max_element(s.latencyUs.begin(), s.latencyUs.end()) / 1000.0;
+    printf("%-12s %8llu %8llu %8llu %8llu %8.1f %8.2f %8.2f %8.2f %8.2f %9.2f\n", ENDPOINT_NAMES[i],
+           (unsigned long long)s.sent, (unsigned long long)s.ok, (unsigned long long)s.httpErrors,
+           (unsigned long long)s.netErrors, s.ok / seconds, percentileMs(s.latencyUs, 0.5),
+           percentileMs(s.latencyUs, 0.99), percentileMs(s.latencyUs, 0.999), maxMs, percentileMs(s.lagUs, 0.99));
+    sent += s.sent;
+    ok += s.ok;
+    all.insert(all.end(), s.latencyUs.begin(), s.latencyUs.end());
+  }
+  double maxMs = all.empty() ? 0 : *std::max_element(all.begin(), all.end()) / 1000.0;
+  printf("%-12s %8llu %8llu %8s %8s %8.1f %8.2f %8.2f %8.2f %8.2f\n", "total", (unsigned long long)sent,
+         (unsigned long long)ok, "", "", ok / seconds, percentileMs(all, 0.5), percentileMs(all, 0.99),
+         percentileMs(all, 0.999), maxMs);
+}
+
+static void reportServer() {
+  printf("\nserver:");
+  for (int i = 0; i < EP_COUNT; i++) {
+    printf(" %s=%llu req/%llu records", ENDPOINT_NAMES[i], (unsigned long long)serverStats.requests[i].load(),
+           (unsigned long long)serverStats.records[i].load());
+  }
+  printf("\n        injected errors=%llu drops=%llu stalls=%llu, bad requests=%llu, resent=%llu\n",
+         (unsigned long long)serverStats.errors.load(), (unsigned long long)serverStats.drops.load(),
+         (unsigned long long)serverStats.stalls.load(), (unsigned long long)serverStats.badRequests.load(),
+         (unsigned long long)serverStats.resent.load());
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: loadgen serve [--port N] [server options]\n"
+          "       loadgen run --target HOST:PORT [load options]\n"
+          "       loadgen bench [load options] [server options]\n"
+          "see the comment at the top of loadgen.cpp for the options\n");
+  exit(2);
+}
+
+static bool parseOptions(int argc, char **argv, Options &opt) {
+  for (int i = 2; i < argc; i++) {
+    std::string a = argv[i];
+    if (i + 1 >= argc) return false;
+    const char *v = argv[++i];
+    if (a == "--target") {
+      std::string t = v;
+      size_t colon = t.rfind(':');
+      if (colon == std::string::npos) return false;
+      opt.host = t.substr(0, colon);
+      opt.port = atoi(t.c_str() + colon + 1);
+    } else if (a == "--port") opt.port = atoi(v);
+    else if (a == "--smarthome") opt.smarthome = atoi(v);
+    else if (a == "--web") opt.web = atoi(v);
+    else if (a == "--trackers") opt.trackers = atoi(v);
+    else if (a == "--duration") opt.duration = atof(v);
+    else if (a == "--speedup") opt.speedup = atof(v);
+    else if (a == "--sensor-every") opt.sensorEvery = atof(v);
+    else if (a == "--tap-every") opt.tapEvery = atof(v);
+    else if (a == "--gps-every") opt.gpsEvery = atof(v);
+    else if (a == "--latency-ms") opt.latencyMs = atof(v);
+    else if (a == "--jitter-ms") opt.jitterMs = atof(v);
+    else if (a == "--error-rate") opt.errorRate = atof(v);
+    else if (a == "--drop-rate") opt.dropRate = atof(v);
+    else if (a == "--stall-rate") opt.stallRate = atof(v);
+    else if (a == "--stall-ms") opt.stallMs = atof(v);
+    else if (a == "--transport") {
+      if (strcmp(v, "mqtt") == 0) opt.mqtt = true;
+      else if (strcmp(v, "http") != 0) return false;
+    } else return false;
+  }
+  return opt.speedup > 0;
+}
+
+static void runLoad(const Options &opt) {
+  printf("%d smarthome, %d web, %d trackers against %s:%d over %s for %.0f s (speedup %.1f)\n", opt.smarthome,
+         opt.web, opt.trackers, opt.host.c_str(), opt.port, opt.mqtt ? "MQTT" : "HTTP", opt.duration, opt.speedup);
+  Clock::time_point start = Clock::now();
+  Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+  std::vector<std::thread> devices;
+  for (int i = 0; i < opt.smarthome; i++) devices.emplace_back(runDevice, std::cref(opt), DEV_SMARTHOME, i, end);
+  for (int i = 0; i < opt.web; i++) devices.emplace_back(runDevice, std::cref(opt), DEV_WEB, i, end);
+  for (int i = 0; i < opt.trackers; i++) devices.emplace_back(runDevice, std::cref(opt), DEV_TRACKER, i, end);
+  for (std::thread &t : devices) t.join();
+  report(std::chrono::duration<double>(Clock::now() - start).count());
+}
+
+int main(int argc, char **argv) {
+  signal(SIGPIPE, SIG_IGN);
+  if (argc < 2) usage();
+  std::string mode = argv[1];
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) usage();
+
+  if (mode == "serve") {
+    std::thread acceptor;
+    int port = startServer(opt, opt.port, acceptor);
+    if (port < 0) {
+      perror("listen");
+      return 1;
+    }
+    printf("stand-in %s on port %d: latency %.1f ms + exp(%.1f ms), errors %.3f, drops %.3f, stalls %.3f\n",
+           opt.mqtt ? "broker" : "server", port, opt.latencyMs, opt.jitterMs, opt.errorRate, opt.dropRate,
+           opt.stallRate);
+    acceptor.join();
+  } else if (mode == "run") {
+    runLoad(opt);
+  } else if (mode == "bench") {
+    std::thread acceptor;
+    int port = startServer(opt, 0, acceptor);
+    if (port < 0) {
+      perror("listen");
+      return 1;
+    }
+    opt.host = "127.0.0.1";
+    opt.port = port;
+    printf("stand-in %s: latency %.1f ms + exp(%.1f ms), errors %.3f, drops %.3f, stalls %.3f\n",
+           opt.mqtt ? "broker" : "server", opt.latencyMs, opt.jitterMs, opt.errorRate, opt.dropRate, opt.stallRate);
+    runLoad(opt);
+    reportServer();
+    stopping = true;
+    acceptor.detach();
+  } else {
+    usage();
+  }
+  return 0;
+}
@@ -4,6 +4,11 @@
 #include <RTClib.h>
 #include <LiquidCrystal.h>
 #include <HTTPClient.h>
+#include <DjangoLink.h>
+#include <SensorBuffer.h>
+#include <SensorAggregator.h>
+#include <LcdShadow.h>
+#include <WifiLink.h>
 
 // -------- DHT11 Settings --------
 #define DHTPIN 4
@@ -12,6 +17,7 @@ DHT dht(DHTPIN, DHTTYPE);
 
 // -------- LCD Settings --------
 LiquidCrystal lcd(27, 26, 14, 12, 13, 15);
+LcdShadow screen(lcd);  // only changed cells reach the LCD
 
 // -------- RTC Settings --------
 RTC_DS3231 rtc;
@@ -19,54 +25,58 @@ RTC_DS3231 rtc;
 // -------- WiFi Credentials --------
 const char* WIFI_SSID = "A20s";
 const char* WIFI_PASSWORD = "amue9397";
+WifiLink wifi(WIFI_SSID, WIFI_PASSWORD);  // connects in the background, readings are buffered meanwhile
 
 // -------- Django Server Configuration --------
-const char* DJANGO_SERVER_URL = "http://172.16.50.189:8000/api/sensor-data/";
+const char* DJANGO_HOST = "172.16.50.189";
+const uint16_t DJANGO_PORT = 8000;
+const char* DJANGO_SENSOR_PATH = "/api/sensor-data/";
+DjangoLink django(DJANGO_HOST, DJANGO_PORT);  // keep-alive, reused every post
 
 unsigned long lastSendTime = 0;
 const unsigned long sendInterval = 15000; // 15 seconds
 
+// Readings are aggregated into summary records, which are kept (RAM, then
+// LittleFS) until the server accepts them
+SensorAggregator sensorAggregator;
+SensorBuffer sensorBuffer;
+const unsigned long uploadMaxAge = 60000;  // oldest sample waits at most 60 s
+const size_t uploadByteBudget = 900;       // bytes of JSON per batch
+
+// When the link drops, the readings since the last record become one, so
+// the server's data runs right up to the gap
+void onWifiChange(bool connected) {
+  if (connected) return;
+  SensorSample record;
+  if (sensorAggregator.flush(rtc.now().unixtime(), record)) sensorBuffer.push(record);
+}
+
 void setup() {
   Serial.begin(115200);
 
   lcd.begin(16, 2);
-  lcd.clear();
-  lcd.print("Initializing...");
+  screen.begin();
+  screen.print("Initializing...");
+  screen.render();
 
   dht.begin();
+  sensorBuffer.begin();
 
   Wire.begin(21, 22); // SDA, SCL
   if (!rtc.begin()) {
     Serial.println("RTC not found!");
-    lcd.setCursor(0, 1);
-    lcd.print("RTC not found!");
+    screen.setCursor(0, 1);
+    screen.print("RTC not found!");
+    screen.render();
     while (true);
   }
 
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Connecting WiFi");
-
-  int retry = 0;
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-    retry++;
-    if (retry > 30) {
-      lcd.setCursor(0, 1);
-      lcd.print("WiFi Failed!");
-      while (true);
-    }
-  }
-
-  lcd.clear();
-  lcd.print("WiFi Connected!");
-  Serial.println("WiFi connected. IP: " + WiFi.localIP().toString());
-  delay(2000);
+  wifi.begin(onWifiChange);
 }
 
 void loop() {
+  wifi.loop();
+
   if (millis() - lastSendTime >= sendInterval || lastSendTime == 0) {
     lastSendTime = millis();
 
@@ -75,58 +85,59 @@ void loop() {
 
     if (isnan(temperature) || isnan(humidity)) {
       Serial.println("Failed to read from DHT sensor!");
-      lcd.clear();
-      lcd.setCursor(0, 0);
-      lcd.print("DHT Error");
+      screen.clear();
+      screen.setCursor(0, 0);
+      screen.print("DHT Error");
+      screen.render();
       delay(3000);
       return;
     }
 
     DateTime now = rtc.now();
-    char timestampStr[20];
-    sprintf(timestampStr, "%04d-%02d-%02d %02d:%02d:%02d",
-            now.year(), now.month(), now.day(),
-            now.hour(), now.minute(), now.second());
-
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Temp: ");
-    lcd.print(temperature, 1);
-    lcd.print("C");
-
-    lcd.setCursor(0, 1);
-    lcd.print("Hum: ");
-    lcd.print(humidity, 1);
-    lcd.print("%");
-
-    if (WiFi.status() == WL_CONNECTED) {
-      HTTPClient http;
-      http.begin(DJANGO_SERVER_URL);
-      http.addHeader("Content-Type", "application/json");
-
-      String payload = "{";
-      payload += "\"temperature\": " + String(temperature, 1) + ",";
-      payload += "\"humidity\": " + String(humidity, 1) + ",";
-      payload += "\"timestamp\": \"" + String(timestampStr) + "\"";
-      payload += "}";
-
-      Serial.println("Sending payload: " + payload);
+    SensorSample record;
+    if (sensorAggregator.add(temperature, humidity, now.unixtime(), millis(), record)) {
+      sensorBuffer.push(record);
+    }
 
-      int httpCode = http.POST(payload);
+    screen.clear();
+    screen.setCursor(0, 0);
+    screen.print("Temp: ");
+    screen.print(temperature, 1);
+    screen.print("C");
+
+    screen.setCursor(0, 1);
+    screen.print("Hum: ");
+    screen.print(humidity, 1);
+    screen.print("%");
+    screen.render();
+
+    if (!wifi.connected()) {
+      Serial.print("WiFi not connected, samples buffered: ");
+      Serial.println(sensorBuffer.pending());
+    } else if (sensorBuffer.due(uploadMaxAge, uploadByteBudget)) {
+      static char payload[1024];
+      uint16_t samples = sensorBuffer.buildBatch(payload, sizeof(payload), uploadByteBudget);
+
+      Serial.print("Sending batch of ");
+      Serial.print(samples);
+      Serial.print(": ");
+      Serial.println(payload);
+
+      char response[128];
+      int httpCode = django.post(DJANGO_SENSOR_PATH, payload, response, sizeof(response));
+      if (httpCode >= 200 && httpCode < 300) sensorBuffer.commit();
 
       if (httpCode > 0) {
         Serial.print("HTTP Code: ");
         Serial.println(httpCode);
-        String response = http.getString();
-        Serial.println("Server Response: " + response);
+        Serial.print("Server Response: ");
+        Serial.println(response);
       } else {
         Serial.print("Failed to send data: ");
-        Serial.println(http.errorToString(httpCode));
+        Serial.println(HTTPClient::errorToString(httpCode));
       }
-
-      http.end();
-    } else {
-      Serial.println("WiFi not connected");
+      django.printStats(Serial);
+      wifi.printStats(Serial);
     }
   }
 